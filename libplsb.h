@@ -0,0 +1,68 @@
+/* libplsb.h -- public header for the PL/SQL beautifier as a library
+   (see "USING PLSB AS A LIBRARY" in plsb.txt).
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef LIBPLSB_H
+#define LIBPLSB_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "ofile.h"
+
+/* Return codes, the same as in util.h */
+
+#ifndef OKAY
+#define OKAY        (0)
+#define ERROR_FOUND (1)
+#endif
+
+/* Options for plsb_format().  A NULL string means the default. */
+
+typedef struct
+{
+	const char * indent_string;	/* one level of indentation */
+	int spool;		/* boolean: spool oversized tokens to a tmpfile */
+} Plsb_options;
+
+/* A range of input lines for plsb_format_lines(), counting from 1 */
+
+typedef struct
+{
+	int first;
+	int last;
+} Plsb_range;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+void plsb_default_options( Plsb_options * pOpt );
+int plsb_format( const char * in, size_t len, const Plsb_options * pOpt,
+	Ofile out );
+int plsb_format_units( const char * in, size_t len,
+	const Plsb_options * pOpt, int jobs, Ofile out );
+int plsb_format_lines( const char * in, size_t len,
+	const Plsb_options * pOpt, const Plsb_range * ranges, int count,
+	Ofile out );
+
+#ifdef __cplusplus
+	};
+#endif
+
+#endif
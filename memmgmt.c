@@ -40,8 +40,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <signal.h>
 #include "util.h"
 
+/* util.h redirects the following to the versions that record the call
+   site.  Here we want the plain versions: for the definitions, and so
+   that our own internal allocations don't show up in the profile.
+*/
+
+#undef allocMemory
+#undef allocNulMemory
+#undef resizeMemory
+#undef strDup
+#undef allocSlab
+
 /*
   For the debugging version:
 
@@ -55,21 +67,229 @@
 */
 
 #define NEWGARBAGE   ('\xFB')
-#define POOLMAX      (32)		/* number of pools we can register */
+
+/*
+  Small objects of fixed size (tokens, Chunks, Toknodes and so forth)
+  come from slabs: blocks of SLAB_BYTES, each carved into objects of a
+  single size class.  Each object is preceded by a header pointing to
+  its slab, so that freeSlab() doesn't need to be told the size.  Free
+  objects are linked through their first word.
+
+  A slab that becomes entirely free goes back to the free store, except
+  that each class keeps one such slab in reserve, so that a program
+  hovering at a slab boundary doesn't allocate and free the same slab
+  over and over.  purgeMemoryPools() releases the reserves too.
+
+  With PLS_THREADS, each thread keeps a small magazine of free objects
+  for each class, so that most allocations and deallocations need no
+  lock.  A thread moves objects between its magazines and the slabs in
+  batches, and empties its magazines when it exits.
+
+  No thread may touch another's magazines, so to reclaim the objects
+  hoarded in them, a registered scavenger bumps a global flush count.
+  Each thread compares the count with its own copy whenever it takes
+  or gives an object, and empties its magazines if it has fallen
+  behind.
+*/
+
+#define SLAB_BYTES   (16384)
+#define SLAB_CLASSES (16)
+#define MAG_HIGH     (64)		/* most objects a magazine may hold */
+#define MAG_BATCH    (32)		/* how many objects to move at once */
+
+struct slab_class;
+
+typedef struct slab
+{
+	struct slab_class * pClass;
+	struct slab * pNext;		/* links among the partial slabs */
+	struct slab * pPrev;
+	void * freeList;			/* freed objects, ready for reuse */
+	char * fresh;				/* next object never yet used */
+	unsigned untouched;			/* how many objects never yet used */
+	unsigned inUse;				/* how many objects allocated */
+	int listed;					/* TRUE if on the partial list */
+} Slab;
+
+/* An object header; the union makes the object suitably aligned */
+
+typedef union
+{
+	Slab * pSlab;				/* NULL if not from a slab */
+	long l;
+	double d;
+	void * p;
+} SlotHeader;
+
+typedef struct slab_class
+{
+	size_t size;				/* largest object in the class */
+	size_t stride;				/* distance between objects */
+	Slab * partial;				/* slabs with objects to spare */
+	Slab * reserve;				/* an entirely free slab */
+	Mutex lock;					/* guards all of the above */
+	SlabStats stats;
+} SlabClass;
+
+#define SLAB_CLASS( n ) \
+	{ n, 0, NULL, NULL, MUTEX_INITIALIZER, { n, 0, 0, 0, 0, 0, 0 } }
+
+static SlabClass slabClasses[ SLAB_CLASSES ] =
+{
+	SLAB_CLASS( 16 ),   SLAB_CLASS( 32 ),   SLAB_CLASS( 48 ),
+	SLAB_CLASS( 64 ),   SLAB_CLASS( 96 ),   SLAB_CLASS( 128 ),
+	SLAB_CLASS( 192 ),  SLAB_CLASS( 256 ),  SLAB_CLASS( 384 ),
+	SLAB_CLASS( 512 ),  SLAB_CLASS( 768 ),  SLAB_CLASS( 1024 ),
+	SLAB_CLASS( 1536 ), SLAB_CLASS( 2048 ), SLAB_CLASS( 3072 ),
+	SLAB_CLASS( 4096 )
+};
+
+static SlabClass * findClass( size_t size );
+static void * takeObject( SlabClass * pSC );
+static Slab * addSlab( SlabClass * pSC );
+static Slab * giveObject( SlabClass * pSC, void * p );
+static void listSlab( SlabClass * pSC, Slab * pSlab );
+static void unlistSlab( SlabClass * pSC, Slab * pSlab );
+
+#ifdef PLS_THREADS
 
 typedef struct
+{
+	void * top;					/* free objects, linked as above */
+	unsigned count;
+} Magazine;
+
+static THREAD_LOCAL Magazine magazines[ SLAB_CLASSES ];
+static THREAD_LOCAL int magazinesKeyed = FALSE;
+static THREAD_LOCAL unsigned magazinesFlushed = 0;	/* flushes seen */
+static volatile unsigned magazineFlushes = 0;		/* flushes requested */
+static pthread_once_t magKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t magKey;
+
+static void refillMagazine( SlabClass * pSC, Magazine * pMag );
+static void spillMagazine( SlabClass * pSC, Magazine * pMag, unsigned keep );
+static void keyMagazines( void );
+static void makeMagKey( void );
+static void emptyMagazines( void * p );
+static void flushMagazines( void * p );
+
+#endif
+
+/*
+  The registered memory pools form a linked list, to which we add at
+  the front with a compare-and-swap, so that registering a pool takes
+  no lock and there is no limit on how many pools we can register.
+  We never remove a node from the list; unRegisterMemoryPool() merely
+  marks it free, and a later registration may reuse it.  Each node
+  passes through three states:
+
+  POOL_FREE:   available for reuse;
+  POOL_BUSY:   claimed by a registration that is filling it in;
+  POOL_ACTIVE: registered, and eligible to be called.
+*/
+
+#define POOL_FREE    (0)
+#define POOL_BUSY    (1)
+#define POOL_ACTIVE  (2)
+
+typedef struct memory_pool
 {
     void ( * freeFunc ) ( void * ); /* ptr to memory-freeing function */
     void * genericPtr;              /* ptr to be passed to the above */
+    int priority;                   /* lower values are called first */
+    volatile int state;             /* POOL_FREE, POOL_BUSY, POOL_ACTIVE */
+    struct memory_pool * pNext;
 } MemoryPool;
 
-/* Note: all pointers in the following array are implicitly
-  initialized to NULL.
+#ifdef PLS_THREADS
+#define compareAndSwap(p,old,new) __sync_bool_compare_and_swap( p, old, new )
+#define atomicIncrement(p)        ( (void) __sync_fetch_and_add( p, 1 ) )
+#else
+#define compareAndSwap(p,old,new) \
+	( *(p) == (old) ? ( *(p) = (new), TRUE ) : FALSE )
+#define atomicIncrement(p)        ( (void) ++*(p) )
+#endif
+
+static MemoryPool * volatile poolList = NULL;
+
+static unsigned slotCount   = 0;	/* nodes in the list */
+static unsigned excessPools = 0;	/* pools we had no memory for */
+
+/*
+  Every block from allocMemory() is preceded by a header recording its
+  size, so that we can keep track of how many bytes are outstanding.
+  If a watermark is set, then when the outstanding bytes rise above it
+  we call the scavengers, in order of priority, until the outstanding
+  bytes fall below the low-water mark (three quarters of the
+  watermark), or until we run out of scavengers.  We don't try again
+  until the outstanding bytes have fallen below the low-water mark,
+  lest we thrash when the scavengers can't free enough.
+*/
+
+typedef union
+{
+	size_t size;
+	long l;
+	double d;
+	void * p;
+} BlockHeader;
+
+static size_t outstandingBytes = 0;
+static size_t peakBytes = 0;
+static size_t watermark = 0;			/* zero if none */
+static int watermarkArmed = TRUE;
+static int watermarkChecked = FALSE;	/* looked at PLS_WATERMARK? */
+static int scavenging = FALSE;			/* in runScavengers()? */
+static int steadyState = FALSE;			/* past the warm-up point? */
+static int steadyStrict = FALSE;		/* abort on a heap allocation? */
+static unsigned long steadyCount = 0;	/* heap allocations since then */
+static Mutex bytesLock = MUTEX_INITIALIZER;	/* guards the above */
+
+static void noteBytes( size_t added, size_t removed );
+static void checkWatermark( void );
+static void runScavengers( int all );
+static void * blockFailed( const char * func, size_t size );
+static void reportSteadyState( void );
+
+/*
+  For profiling, we count the allocation requests from each call site
+  (a file name and line number) in a fixed-size hash table, so that
+  recording a request never allocates memory.  If the table fills up,
+  we lump the excess under a single anonymous site.  We also keep a
+  histogram of the requested sizes, in buckets by powers of two.
+
+  A signal handler can't safely write a file, so SIGUSR1 merely sets a
+  flag, and the next allocation request writes the profile.
 */
-static MemoryPool memoryPoolList [ POOLMAX ];
 
-static unsigned slotCount   = 0;
-static unsigned excessPools = 0;
+#define SITE_MAX     (1024)		/* must be a power of two */
+#define HIST_BUCKETS (33)		/* up to 2**31 bytes, and beyond */
+
+typedef struct
+{
+	const char * file;			/* NULL if the slot is empty */
+	int line;
+	unsigned long count;
+	unsigned long bytes;
+} CallSite;
+
+static CallSite sites[ SITE_MAX ];
+static CallSite otherSite = { "(other)", 0, 0, 0 };
+static unsigned siteCount = 0;
+static unsigned long histogram[ HIST_BUCKETS ];
+static unsigned long requestCount = 0;
+static unsigned long requestBytes = 0;
+static int profiling = FALSE;
+static int profileChecked = FALSE;
+static char profilePath[ FILENAME_MAX ];
+static volatile sig_atomic_t dumpRequested = 0;
+static Mutex profileLock = MUTEX_INITIALIZER;	/* guards the above */
+
+static void noteRequest( const char * file, int line, size_t size );
+static void writeProfile( void );
+static void requestDump( int sig );
+static int compareSites( const void * p1, const void * p2 );
+static void putJsonString( FILE * pF, const char * s );
 
 #ifndef NDEBUG
 
@@ -77,7 +297,18 @@ static int firstTime = TRUE;
 static unsigned long allocationCount = 0;
 static unsigned long outstandingCount = 0;
 static unsigned long maxCount = 0;
+static Mutex countLock = MUTEX_INITIALIZER;	/* guards the above */
+
+/*
+  In fast-exit mode we skip the purge and the report at exit.  The
+  mode is on if fastExit() says so; or, if fastExit() has not been
+  called, if the environment variable PLS_FAST_EXIT is set, or if we
+  were compiled with PLS_FAST_EXIT #defined.  -1 means "not called".
+*/
 
+static int fastExiting = -1;	/* guarded by countLock */
+
+static void exitMemory( void );
 static void reportMemory( void );
 
 #endif
@@ -97,61 +328,60 @@ static void reportMemory( void );
 
  In the debugging version: at the end of the job we will free all
  memory pools, then run a memory usage report so that we can
- detect memory leaks.
+ detect memory leaks -- unless we're in fast-exit mode.  See
+ exitMemory().
 *******************************************************************/
 void * allocMemory( size_t size )
 {
-	void * p;
+	BlockHeader * pH;
 
 #ifndef NDEBUG
 
-	/* Note that functions installed by atexit() are installed
-       in one order but called in the reverse order.  We install
-       reportMemory() first so that it will be called last.
-	*/
-
+    lockMutex( &countLock );
     if( TRUE == firstTime )
     {
-       atexit( reportMemory );
-	   atexit( purgeMemoryPools );
+       atexit( exitMemory );
        firstTime = FALSE;
     }
     allocationCount++;
+    unlockMutex( &countLock );
 
 #endif
 
     ASSERT( size != 0 );
 
-    p = malloc( size );
+	if( size > (size_t) -1 - sizeof( BlockHeader ) )
+		return blockFailed( "allocMemory", size );
+
+    pH = malloc( sizeof( BlockHeader ) + size );
 
     /* In case of failure we release all memory pools and try again. */
 
-    if( NULL == p && slotCount > 0 )
+    if( NULL == pH )
     {
 		purgeMemoryPools();
-        p = malloc( size );
+        pH = malloc( sizeof( BlockHeader ) + size );
 	}
 
-	if( NULL == p )
-	{
-		fprintf( stderr,
-				 "\nallocMemory: unable to allocate %lu bytes\n",
-				 (unsigned long) size );
-		return NULL;
-	}
+	if( NULL == pH )
+		return blockFailed( "allocMemory", size );
 	else
 	{
+		pH->size = size;
 
 #ifndef NDEBUG
 
-		memset( p, NEWGARBAGE, size );
+		memset( pH + 1, NEWGARBAGE, size );
+		lockMutex( &countLock );
 		outstandingCount++;
 		if( outstandingCount > maxCount )
 			maxCount = outstandingCount;
+		unlockMutex( &countLock );
 
 #endif
 
-		return p;
+		noteBytes( size, 0 );
+		return pH + 1;
 	}
 }
 
@@ -164,57 +394,60 @@ void * allocMemory( size_t size )
 *******************************************************************/
 void * allocNulMemory( size_t nitems, size_t size )
 {
-	void * p;
+	BlockHeader * pH;
+	size_t total;
 
 #ifndef NDEBUG
 
-	/* Note that functions installed by atexit() are installed
-	   in one order but called in the reverse order.  We install
-	   reportMemory() first so that it will be called last.
-	*/
-
+	lockMutex( &countLock );
 	if( TRUE == firstTime )
 	{
-	   atexit( reportMemory );
-	   atexit( purgeMemoryPools );
+	   atexit( exitMemory );
 	   firstTime = FALSE;
 	}
 	allocationCount++;
+	unlockMutex( &countLock );
 
 #endif
 
 	ASSERT( nitems != 0 );
 	ASSERT( size != 0 );
 
-	p = calloc( nitems, size );
+	/* Guard against overflow in computing the total size */
+
+	if( 0 == nitems || 0 == size
+		|| nitems > ( (size_t) -1 - sizeof( BlockHeader ) ) / size )
+		return blockFailed( "allocNulMemory", nitems * size );
+
+	total = nitems * size;
+	pH = calloc( 1, sizeof( BlockHeader ) + total );
 
 	/* In case of failure we release all memory pools and try again. */
 
-	if( NULL == p && slotCount > 0 )
+	if( NULL == pH )
 	{
 		purgeMemoryPools();
-		p = calloc( nitems, size );
+		pH = calloc( 1, sizeof( BlockHeader ) + total );
 	}
 
-	if( NULL == p )
-	{
-		fprintf( stderr,
-				 "\nallocNulMemory: unable to allocate %lu bytes\n",
-				 (unsigned long) ( nitems * size ) );
-		return NULL;
-	}
+	if( NULL == pH )
+		return blockFailed( "allocNulMemory", total );
 	else
 	{
+		pH->size = total;
 
 #ifndef NDEBUG
 
+		lockMutex( &countLock );
 		outstandingCount++;
 		if( outstandingCount > maxCount )
 			maxCount = outstandingCount;
+		unlockMutex( &countLock );
 
 #endif
 
-		return p;
+		noteBytes( total, 0 );
+		return pH + 1;
 	}
 }
 
@@ -223,7 +456,7 @@ void * allocNulMemory( size_t nitems, size_t size )
 
  First we call realloc().  If this call fails, we invoke any
  available memory scavengers and try again.  Return the result from
- realloc().
+ realloc(), adjusted to skip over the header.
 
  Since the number of outstanding allocations doesn't change, we
  don't update the counter.
@@ -233,47 +466,58 @@ void * allocNulMemory( size_t nitems, size_t size )
 *******************************************************************/
 void * resizeMemory( void * pOld, size_t size )
 {
-	void * p;
+	BlockHeader * pH;
+	size_t oldSize;
 
 	ASSERT( pOld != NULL );
 	ASSERT( size != 0 );
 	if( NULL == pOld || 0 == size )
 		return NULL;
 
-	p = realloc( pOld, size );
+	if( size > (size_t) -1 - sizeof( BlockHeader ) )
+		return blockFailed( "resizeMemory", size );
+
+	pH = (BlockHeader *) pOld - 1;
+	oldSize = pH->size;
+	pH = realloc( pH, sizeof( BlockHeader ) + size );
 
 	/* In case of failure we release all memory pools and try again. */
 
-	if( NULL == p && slotCount > 0 )
+	if( NULL == pH )
 	{
 		purgeMemoryPools();
-		p = realloc( pOld, size );
+		pH = realloc( (BlockHeader *) pOld - 1, sizeof( BlockHeader ) + size );
 	}
 
-	if( NULL == p )
-		fprintf( stderr,
-			 "\nresizeMemory: unable to allocate %lu bytes\n",
-			 (unsigned long) size );
+	if( NULL == pH )
+		return blockFailed( "resizeMemory", size );
 
-	return p;
+	pH->size = size;
+	noteBytes( size, oldSize );
+	return pH + 1;
 }
 
 /********************************************************************
- freeMemory -- a wrapper for free().  So far nothing special.  We
- don't try to fill the memory with garbage because, in the absence
- of additional machinery, we don't know how big the block is.
+ freeMemory -- a wrapper for free().  We deduct the size of the
+ block, as recorded in its header, from the outstanding bytes.
 
  For the debug version we decrement the allocation count.
 *********************************************************************/
 void freeMemory( void * pMem )
 {
+	BlockHeader * pH;
+
     ASSERT( NULL != pMem );
 
-    free( pMem );
+	pH = (BlockHeader *) pMem - 1;
+	noteBytes( 0, pH->size );
+    free( pH );
 #ifndef NDEBUG
 
+	lockMutex( &countLock );
 	ASSERT( outstandingCount > 0 );
     outstandingCount--;
+	unlockMutex( &countLock );
 
 #endif
 }
@@ -302,174 +546,1345 @@ char * strDup( const char * s )
 }
 
 /*******************************************************************
- registerMemoryPool -- stores for later use: a ptr to a memory-
-					   freeing function and a void ptr to be
-					   passed to it.  If we don't have room to store
-					   them, we discard them.
+ allocMemoryAt, allocNulMemoryAt, resizeMemoryAt, strDupAt, and
+ allocSlabAt -- the same as the functions without "At", except that
+ they record the request for the profile, attributing it to the
+ specified file and line.  Through macros in util.h, client code
+ calls these versions without knowing it.
+*******************************************************************/
+void * allocMemoryAt( size_t size, const char * file, int line )
+{
+	noteRequest( file, line, size );
+	return allocMemory( size );
+}
 
- So what is the purpose of the void pointer?
+void * allocNulMemoryAt( size_t nitems, size_t size, const char * file,
+	int line )
+{
+	noteRequest( file, line, nitems * size );
+	return allocNulMemory( nitems, size );
+}
 
- Suppose you have multiple instances of struct FOOBAR, and each
- FOOBAR has a memory pool associated with it.  When you construct
- each FOOBAR, you can register the memory-freeing function, together
- with a pointer to that particular FOOBAR.  When you destruct that
- FOOBAR, you should call that function and pass it the appropriate
- pointer so that it will free the memory associated just with that
- particular FOOBAR.  Then un-register the function for that FOOBAR.
+void * resizeMemoryAt( void * pOld, size_t size, const char * file,
+	int line )
+{
+	noteRequest( file, line, size );
+	return resizeMemory( pOld, size );
+}
 
- If we ever need to free memory from within allocMemory(), we will
- free memory for all the registered FOOBARs.
+char * strDupAt( const char * s, const char * file, int line )
+{
+	noteRequest( file, line, NULL == s ? 1 : strlen( s ) + 1 );
+	return strDup( s );
+}
 
- Most typically, however, the void pointer will be NULL.
+void * allocSlabAt( size_t size, const char * file, int line )
+{
+	noteRequest( file, line, size );
+	return allocSlab( size );
+}
+
+/*******************************************************************
+ allocSlab -- allocate a small object from the slab of the smallest
+ size class that will hold it.  An object too big for any class
+ comes from allocMemory() instead, with the same kind of header, so
+ that freeSlab() can tell the difference.
 
- The current implementation stores the pairs of function and void pointers 
- in a simple array of fixed size.  If that turns out to be too confining, 
- we can use some other approach, such as a linked list or tree.
+ Like allocMemory(), in the debugging version we fill the object
+ with garbage.
 *******************************************************************/
-void registerMemoryPool( void (* pFunction) (void *), void * p )
+void * allocSlab( size_t size )
 {
-    MemoryPool * pMP;
-	MemoryPool * pOpenSlot = NULL;
-	int i;
+	SlabClass * pSC;
+	SlotHeader * pH;
+	void * p;
 
-    ASSERT( pFunction != NULL );
+	ASSERT( size != 0 );
 
-    /* Scan all the pools.  Maybe this pool is already registered.  If
-       so, the debug version aborts, but the production version just 
-	   returns without complaint.
+	pSC = findClass( size );
+	if( NULL == pSC )
+	{
+		pH = allocMemory( sizeof( SlotHeader ) + size );
+		if( NULL == pH )
+			return NULL;
 
-       If the pool is not already registered, look for an open slot for it.
-    */
+		pH->pSlab = NULL;
+		return pH + 1;
+	}
 
-    for( pMP = memoryPoolList, i = slotCount; 
-		 i > 0;
-		 pMP++, i-- )
-    {
-        if( NULL == pMP->freeFunc )
-        {
-            ASSERT( NULL == pMP->genericPtr );
-			pOpenSlot = pMP;
-			break;
-        }
-        else 
+#ifdef PLS_THREADS
+	{
+		Magazine * pMag;
+
+		if( ! magazinesKeyed )
+			keyMagazines();
+		else if( magazinesFlushed != magazineFlushes )
 		{
-			ASSERT( pMP->freeFunc != pFunction || pMP->genericPtr != p );
-			if(     pMP->freeFunc == pFunction && pMP->genericPtr == p )
-            	return;
+			magazinesFlushed = magazineFlushes;
+			emptyMagazines( NULL );
 		}
-    }
 
-    /* if we haven't found an open slot yet, bump the counter
-       (and check for overflow)
-    */
+		pMag = magazines + ( pSC - slabClasses );
+		if( 0 == pMag->count )
+			refillMagazine( pSC, pMag );
 
-    if( NULL == pOpenSlot )
-    {
-        if( slotCount >= POOLMAX )
+		if( 0 == pMag->count )
+			p = NULL;
+		else
 		{
-			/* no available slot -- forget it */
+			p = pMag->top;
+			pMag->top = *(void **) p;
+			--pMag->count;
+		}
+	}
+#else
+	lockMutex( &pSC->lock );
+	p = takeObject( pSC );
+	unlockMutex( &pSC->lock );
+#endif
+
+#ifndef NDEBUG
+
+	if( p != NULL )
+		memset( p, NEWGARBAGE, pSC->size );
+
+#endif
+
+	return p;
+}
+
+/*******************************************************************
+ freeSlab -- deallocate an object allocated by allocSlab().
+*******************************************************************/
+void freeSlab( void * p )
+{
+	SlotHeader * pH;
+	SlabClass * pSC;
+
+	ASSERT( p != NULL );
+	if( NULL == p )
+		return;
 
-            excessPools++;
-            return;
-        }
-        else
+	pH = (SlotHeader *) p - 1;
+	if( NULL == pH->pSlab )
+	{
+		freeMemory( pH );		/* too big for a slab */
+		return;
+	}
+
+	pSC = pH->pSlab->pClass;
+
+#ifdef PLS_THREADS
+	{
+		Magazine * pMag;
+
+		if( ! magazinesKeyed )
+			keyMagazines();
+		else if( magazinesFlushed != magazineFlushes )
 		{
-			pOpenSlot = memoryPoolList + slotCount;
-            slotCount++;
+			magazinesFlushed = magazineFlushes;
+			emptyMagazines( NULL );
 		}
-    }
 
-    /* Having picked a slot, store the pointers in it */
+		pMag = magazines + ( pSC - slabClasses );
+		*(void **) p = pMag->top;
+		pMag->top = p;
+		if( ++pMag->count > MAG_HIGH )
+			spillMagazine( pSC, pMag, MAG_HIGH - MAG_BATCH );
+	}
+#else
+	{
+		Slab * pEmpty;
+
+		lockMutex( &pSC->lock );
+		pEmpty = giveObject( pSC, p );
+		unlockMutex( &pSC->lock );
+
+		if( pEmpty != NULL )
+			freeMemory( pEmpty );
+	}
+#endif
+}
+
+/*******************************************************************
+ reserveSlab -- make sure that the size class for objects of a
+ specified size has a slab on hand, so that the first such object
+ needn't come from the heap.  A program calls this during warm-up
+ for objects it may not need until later.  Return ERROR_FOUND if
+ unable to allocate the slab, otherwise OKAY (including when the
+ objects are too big for any class).
+*******************************************************************/
+int reserveSlab( size_t size )
+{
+	SlabClass * pSC;
+	Slab * pSlab = NULL;
+	int rc = OKAY;
+
+	ASSERT( size != 0 );
+
+	pSC = findClass( size );
+	if( NULL == pSC )
+		return OKAY;
+
+	lockMutex( &pSC->lock );
+	if( NULL == pSC->partial && NULL == pSC->reserve )
+	{
+		/* Keep the new slab in reserve, unless another thread got */
+		/* there first while we weren't holding the lock            */
+
+		pSlab = addSlab( pSC );
+		if( NULL == pSlab )
+			rc = ERROR_FOUND;
+		else if( NULL == pSC->reserve )
+		{
+			pSC->reserve = pSlab;
+			pSlab = NULL;
+		}
+		else
+		{
+			--pSC->stats.slabs;
+			++pSC->stats.released;
+		}
+	}
+	unlockMutex( &pSC->lock );
 
-    pOpenSlot->freeFunc   = pFunction;
-    pOpenSlot->genericPtr = p;
+	if( pSlab != NULL )
+		freeMemory( pSlab );
 
-    return;
+	return rc;
 }
 
 /*******************************************************************
- UnRegisterMemoryPool -- removes a memory pool from the list.
+ getSlabStats -- copy the statistics for the size class with a
+ specified index.  Return ERROR_FOUND if there is no such class,
+ so that the caller can loop from zero until it gets an error.
 *******************************************************************/
-void unRegisterMemoryPool( void (* pFunction) (void *), const void * p )
+int getSlabStats( unsigned i, SlabStats * pStats )
 {
-    MemoryPool *pMP;
-    int i;
+	SlabClass * pSC;
 
-    ASSERT( pFunction != NULL );
+	ASSERT( pStats != NULL );
+	if( i >= SLAB_CLASSES || NULL == pStats )
+		return ERROR_FOUND;
 
-    /* scan the pools, looking for the one we're supposed to remove. */ 
+	pSC = slabClasses + i;
+	lockMutex( &pSC->lock );
+	*pStats = pSC->stats;
+	unlockMutex( &pSC->lock );
+	return OKAY;
+}
 
-    pMP = memoryPoolList;
-    for( i = slotCount; i > 0; i-- )
-    {
-		if( pMP->freeFunc   == pFunction &&
-            pMP->genericPtr == p )
-        {
-            pMP->freeFunc   = NULL;
-            pMP->genericPtr = NULL;
-            return;
-        }
-        else
-            pMP++;
-    }
+/*******************************************************************
+ releaseSlabs -- give the reserve slab of every size class back to
+ the free store, after returning the calling thread's magazines to
+ the slabs (thereby perhaps freeing more slabs).  Other threads
+ empty their magazines when the scavenger tells them to; see
+ flushMagazines().
+*******************************************************************/
+void releaseSlabs( void )
+{
+	SlabClass * pSC;
+	Slab * pSlab;
 
-    /* if we haven't found the specified pool, we must have run out
-	   of slots at some point -- or else we're being asked to
-       unregister a pool that was never registered in the first place.
-    */
+#ifdef PLS_THREADS
+	emptyMagazines( NULL );
+#endif
 
-    ASSERT( slotCount == POOLMAX );
+	for( pSC = slabClasses; pSC < slabClasses + SLAB_CLASSES; ++pSC )
+	{
+		lockMutex( &pSC->lock );
+		pSlab = pSC->reserve;
+		pSC->reserve = NULL;
+		if( pSlab != NULL )
+		{
+			--pSC->stats.slabs;
+			++pSC->stats.released;
+		}
+		unlockMutex( &pSC->lock );
 
-    return;
+		if( pSlab != NULL )
+			freeMemory( pSlab );
+	}
 }
 
 /*******************************************************************
- purgeMemoryPools -- calls all registered routines for freeing memory
+ findClass -- return the smallest size class that will hold an
+ object of a specified size, or NULL if none will.
 *******************************************************************/
-void purgeMemoryPools( void )
+static SlabClass * findClass( size_t size )
 {
-    MemoryPool *pMP;
-    int i;
+	SlabClass * pSC;
 
-    pMP = memoryPoolList;
-    for( i = slotCount; i > 0; i-- )
-    {
-        if( NULL != pMP->freeFunc )
-        {
-            pMP->freeFunc ( pMP->genericPtr );
-        }
-		pMP++;
-    }
+	for( pSC = slabClasses; pSC < slabClasses + SLAB_CLASSES; ++pSC )
+	{
+		if( size <= pSC->size )
+			return pSC;
+	}
+	return NULL;
+}
+
+/*******************************************************************
+ takeObject -- take a free object from a slab, allocating a new slab
+ if necessary.  The caller must hold the lock for the class.  We let
+ go of the lock while allocating, so that a memory scavenger can
+ release slabs without deadlocking.
+*******************************************************************/
+static void * takeObject( SlabClass * pSC )
+{
+	Slab * pSlab;
+	void * p;
+
+	if( NULL == pSC->partial && pSC->reserve != NULL )
+	{
+		listSlab( pSC, pSC->reserve );
+		pSC->reserve = NULL;
+	}
+
+	if( NULL == pSC->partial )
+	{
+		pSlab = addSlab( pSC );
+		if( NULL == pSlab )
+			return NULL;
+		listSlab( pSC, pSlab );
+	}
+
+	pSlab = pSC->partial;
+	if( pSlab->freeList != NULL )
+	{
+		p = pSlab->freeList;
+		pSlab->freeList = *(void **) p;
+	}
+	else
+	{
+		SlotHeader * pH;
+
+		ASSERT( pSlab->untouched > 0 );
+		pH = (SlotHeader *) pSlab->fresh;
+		pH->pSlab = pSlab;
+		p = pH + 1;
+		pSlab->fresh += pSC->stride;
+		--pSlab->untouched;
+	}
+
+	++pSlab->inUse;
+	if( NULL == pSlab->freeList && 0 == pSlab->untouched )
+		unlistSlab( pSC, pSlab );
+
+	++pSC->stats.allocs;
+	++pSC->stats.inUse;
+	if( pSC->stats.inUse > pSC->stats.peakInUse )
+		pSC->stats.peakInUse = pSC->stats.inUse;
+
+	return p;
+}
+
+/*******************************************************************
+ addSlab -- allocate and initialize a new slab for a class, without
+ putting it on any list.  The caller must hold the lock for the
+ class.  We let go of the lock while allocating, so that a memory
+ scavenger can release slabs without deadlocking.
+*******************************************************************/
+static Slab * addSlab( SlabClass * pSC )
+{
+	Slab * pSlab;
+
+	if( 0 == pSC->stride )
+	{
+		/* first use of this class: leave room for the header */
 
-    return;
+		pSC->stride = sizeof( SlotHeader ) + ( pSC->size +
+			sizeof( SlotHeader ) - 1 ) / sizeof( SlotHeader ) *
+			sizeof( SlotHeader );
+	}
+
+	unlockMutex( &pSC->lock );
+	pSlab = allocMemory( SLAB_BYTES );
+	lockMutex( &pSC->lock );
+	if( NULL == pSlab )
+		return NULL;
+
+	/* The objects begin after the Slab, suitably aligned */
+
+	pSlab->pClass    = pSC;
+	pSlab->pNext     = NULL;
+	pSlab->pPrev     = NULL;
+	pSlab->freeList  = NULL;
+	pSlab->fresh     = (char *) pSlab + ( sizeof( Slab ) +
+		sizeof( SlotHeader ) - 1 ) / sizeof( SlotHeader ) *
+		sizeof( SlotHeader );
+	pSlab->untouched = ( (char *) pSlab + SLAB_BYTES - pSlab->fresh )
+		/ pSC->stride;
+	pSlab->inUse     = 0;
+	pSlab->listed    = FALSE;
+
+	++pSC->stats.slabs;
+	if( pSC->stats.slabs > pSC->stats.peakSlabs )
+		pSC->stats.peakSlabs = pSC->stats.slabs;
+
+	return pSlab;
 }
 
-#ifndef NDEBUG
+/*******************************************************************
+ giveObject -- return an object to its slab.  If the slab becomes
+ entirely free, keep it in reserve; or, if the class already has a
+ reserve slab, take the slab out of the class and return it, for the
+ caller to give back to the free store once it has let go of the
+ lock.  (Freeing memory with the lock held could call a scavenger
+ which needs the same lock.)  Otherwise return NULL.  The caller
+ must hold the lock for the class.
+*******************************************************************/
+static Slab * giveObject( SlabClass * pSC, void * p )
+{
+	Slab * pSlab;
 
-/********************************************************************
- reportMemory -- reports memory usage.
-********************************************************************/
-static void reportMemory( void )
+	pSlab = ( (SlotHeader *) p - 1 )->pSlab;
+	ASSERT( pSlab != NULL && pSlab->pClass == pSC );
+	ASSERT( pSlab->inUse > 0 );
+
+	*(void **) p = pSlab->freeList;
+	pSlab->freeList = p;
+	--pSlab->inUse;
+	--pSC->stats.inUse;
+
+	if( pSlab->inUse > 0 )
+	{
+		if( ! pSlab->listed )
+			listSlab( pSC, pSlab );
+	}
+	else
+	{
+		if( pSlab->listed )
+			unlistSlab( pSC, pSlab );
+
+		if( NULL == pSC->reserve )
+			pSC->reserve = pSlab;
+		else
+		{
+			--pSC->stats.slabs;
+			++pSC->stats.released;
+			return pSlab;
+		}
+	}
+
+	return NULL;
+}
+
+/*******************************************************************
+ listSlab -- add a slab to the list of those with objects to spare.
+*******************************************************************/
+static void listSlab( SlabClass * pSC, Slab * pSlab )
 {
-    fprintf( stderr,
-             "\nMaximum memory pools registered: %u\n", slotCount );
+	pSlab->pPrev = NULL;
+	pSlab->pNext = pSC->partial;
+	if( pSC->partial != NULL )
+		pSC->partial->pPrev = pSlab;
+	pSC->partial = pSlab;
+	pSlab->listed = TRUE;
+}
 
-    if( excessPools != 0 )
-        fprintf( stderr,
-                 "Memory pools which could not be registered: %u\n",
-                 excessPools );
+/*******************************************************************
+ unlistSlab -- remove a slab from the list of those with objects to
+ spare.
+*******************************************************************/
+static void unlistSlab( SlabClass * pSC, Slab * pSlab )
+{
+	if( pSlab->pPrev != NULL )
+		pSlab->pPrev->pNext = pSlab->pNext;
+	else
+		pSC->partial = pSlab->pNext;
 
-    fprintf( stderr,
-             "Total memory allocations: %lu\n", allocationCount );
+	if( pSlab->pNext != NULL )
+		pSlab->pNext->pPrev = pSlab->pPrev;
 
-	fprintf( stderr,
-             "Maximum outstanding memory allocations: %lu\n",
-             maxCount );
+	pSlab->pNext  = NULL;
+	pSlab->pPrev  = NULL;
+	pSlab->listed = FALSE;
+}
 
-    if( outstandingCount != 0 )
-        fprintf( stderr,
-                 "\nMEMORY LEAK!  %lu un-freed allocations remain\n",
-                 outstandingCount );
+#ifdef PLS_THREADS
+
+/*******************************************************************
+ refillMagazine -- move up to a batch of objects from the slabs to
+ an empty magazine.
+*******************************************************************/
+static void refillMagazine( SlabClass * pSC, Magazine * pMag )
+{
+	void * p;
+
+	lockMutex( &pSC->lock );
+	while( pMag->count < MAG_BATCH )
+	{
+		p = takeObject( pSC );
+		if( NULL == p )
+			break;
+
+		*(void **) p = pMag->top;
+		pMag->top = p;
+		++pMag->count;
+	}
+	unlockMutex( &pSC->lock );
+}
+
+/*******************************************************************
+ spillMagazine -- move objects from a magazine back to their slabs
+ until no more than a specified number remain.
+*******************************************************************/
+static void spillMagazine( SlabClass * pSC, Magazine * pMag, unsigned keep )
+{
+	void * p;
+	Slab * pEmpty;
+	Slab * pDoomed = NULL;	/* empty slabs to give back, linked */
+
+	lockMutex( &pSC->lock );
+	while( pMag->count > keep )
+	{
+		p = pMag->top;
+		pMag->top = *(void **) p;
+		--pMag->count;
+		pEmpty = giveObject( pSC, p );
+		if( pEmpty != NULL )
+		{
+			pEmpty->pNext = pDoomed;
+			pDoomed = pEmpty;
+		}
+	}
+	unlockMutex( &pSC->lock );
+
+	while( pDoomed != NULL )
+	{
+		pEmpty = pDoomed;
+		pDoomed = pDoomed->pNext;
+		freeMemory( pEmpty );
+	}
+}
+
+/*******************************************************************
+ keyMagazines -- the first time a thread uses its magazines, arrange
+ for them to be emptied when it exits.
+*******************************************************************/
+static void keyMagazines( void )
+{
+	(void) pthread_once( &magKeyOnce, makeMagKey );
+	(void) pthread_setspecific( magKey, magazines );
+	magazinesFlushed = magazineFlushes;
+	magazinesKeyed = TRUE;
+}
+
+/*******************************************************************
+ makeMagKey -- create the key whose destructor empties a thread's
+ magazines when it exits, and register the scavenger which empties
+ the magazines of every thread.  Called once, via pthread_once().
+*******************************************************************/
+static void makeMagKey( void )
+{
+	(void) pthread_key_create( &magKey, emptyMagazines );
+	registerMemoryPool( flushMagazines, NULL );
+}
+
+/*******************************************************************
+ emptyMagazines -- return every object in the calling thread's
+ magazines to the slabs.  The parameter is ignored; it's there so
+ that we can serve as the destructor for magKey.
+*******************************************************************/
+static void emptyMagazines( void * p )
+{
+	unsigned i;
+
+	(void) p;
+	for( i = 0; i < SLAB_CLASSES; ++i )
+	{
+		if( magazines[ i ].count > 0 )
+			spillMagazine( slabClasses + i, magazines + i, 0 );
+	}
+}
+
+/*******************************************************************
+ flushMagazines -- memory scavenger: empty the calling thread's
+ magazines, and tell every other thread to empty its own the next
+ time it takes or gives an object.  The parameter is ignored.  An
+ idle thread keeps its objects until it wakes up, but no thread
+ holds more than a magazine's worth per class in any case.
+*******************************************************************/
+static void flushMagazines( void * p )
+{
+	(void) p;
+	atomicIncrement( &magazineFlushes );
+	magazinesFlushed = magazineFlushes;
+	emptyMagazines( NULL );
+}
+
+#endif
+
+/*******************************************************************
+ registerMemoryPool -- stores for later use: a ptr to a memory-
+					   freeing function and a void ptr to be
+					   passed to it, with the default priority.
+
+ So what is the purpose of the void pointer?
+
+ Suppose you have multiple instances of struct FOOBAR, and each
+ FOOBAR has a memory pool associated with it.  When you construct
+ each FOOBAR, you can register the memory-freeing function, together
+ with a pointer to that particular FOOBAR.  When you destruct that
+ FOOBAR, you should call that function and pass it the appropriate
+ pointer so that it will free the memory associated just with that
+ particular FOOBAR.  Then un-register the function for that FOOBAR.
+
+ If we ever need to free memory from within allocMemory(), we will
+ free memory for all the registered FOOBARs.
+
+ Most typically, however, the void pointer will be NULL.
+*******************************************************************/
+void registerMemoryPool( void (* pFunction) (void *), void * p )
+{
+	registerMemoryPoolPriority( pFunction, p, POOL_PRIORITY_DEFAULT );
+}
+
+/*******************************************************************
+ registerMemoryPoolPriority -- like registerMemoryPool(), but with a
+ specified priority.  Scavengers with lower priorities are called
+ first; give a low priority to memory that is cheap to do without,
+ such as a free list, and a high priority to memory that is costly
+ to rebuild, such as a cache loaded from disk.
+
+ We reuse a free node if we can find one; otherwise we allocate a
+ new one and push it onto the front of the list.  If we can't
+ allocate a node, we count the failure and forget the pool.  The
+ nodes come from malloc() rather than from allocMemory(), since
+ they live as long as the program and aren't really outstanding.
+*******************************************************************/
+void registerMemoryPoolPriority( void (* pFunction) (void *), void * p,
+	int priority )
+{
+    MemoryPool * pMP;
+
+    ASSERT( pFunction != NULL );
+	if( NULL == pFunction )
+		return;
+
+    /* Maybe this pool is already registered.  If so, the debug version
+       aborts, but the production version just returns without complaint.
+    */
+
+	for( pMP = poolList; pMP != NULL; pMP = pMP->pNext )
+	{
+		if( POOL_ACTIVE == pMP->state &&
+			pMP->freeFunc == pFunction && pMP->genericPtr == p )
+		{
+			ASSERT( pMP->freeFunc != pFunction || pMP->genericPtr != p );
+			return;
+		}
+	}
+
+	/* Look for a free node to claim */
+
+	for( pMP = poolList; pMP != NULL; pMP = pMP->pNext )
+	{
+		if( POOL_FREE == pMP->state &&
+			compareAndSwap( &pMP->state, POOL_FREE, POOL_BUSY ) )
+			break;
+	}
+
+	if( NULL == pMP )
+	{
+		/* No free node -- make a new one */
+
+		pMP = malloc( sizeof( MemoryPool ) );
+		if( NULL == pMP )
+		{
+			atomicIncrement( &excessPools );
+			return;
+		}
+
+		pMP->state = POOL_BUSY;
+		do
+			pMP->pNext = poolList;
+		while( ! compareAndSwap( &poolList, pMP->pNext, pMP ) );
+
+		atomicIncrement( &slotCount );
+	}
+
+    /* Having claimed a node, fill it in and make it active */
+
+    pMP->freeFunc   = pFunction;
+    pMP->genericPtr = p;
+    pMP->priority   = priority;
+    (void) compareAndSwap( &pMP->state, POOL_BUSY, POOL_ACTIVE );
+}
+
+/*******************************************************************
+ UnRegisterMemoryPool -- removes a memory pool from the list.
+*******************************************************************/
+void unRegisterMemoryPool( void (* pFunction) (void *), const void * p )
+{
+    MemoryPool *pMP;
+
+    ASSERT( pFunction != NULL );
+
+    /* scan the pools, looking for the one we're supposed to remove. */
+
+	for( pMP = poolList; pMP != NULL; pMP = pMP->pNext )
+	{
+		if( POOL_ACTIVE == pMP->state &&
+			pMP->freeFunc   == pFunction &&
+            pMP->genericPtr == p &&
+			compareAndSwap( &pMP->state, POOL_ACTIVE, POOL_FREE ) )
+			return;
+	}
+
+    /* if we haven't found the specified pool, we must have failed to
+	   register it -- or else we're being asked to unregister a pool
+	   that was never registered in the first place.
+    */
+
+    ASSERT( excessPools > 0 );
+}
+
+/*******************************************************************
+ purgeMemoryPools -- calls all registered routines for freeing memory,
+ in order of priority, and then releases the reserve slabs of the
+ slab allocator.
+*******************************************************************/
+void purgeMemoryPools( void )
+{
+	runScavengers( TRUE );
+}
+
+/*******************************************************************
+ setMemoryWatermark -- set the number of outstanding bytes above
+ which we call the scavengers, or turn the watermark off with zero.
+ Return the prior setting.  A call overrides PLS_WATERMARK.
+*******************************************************************/
+size_t setMemoryWatermark( size_t bytes )
+{
+	size_t prior;
+
+	lockMutex( &bytesLock );
+	checkWatermark();
+	prior = watermark;
+	watermark = bytes;
+	watermarkArmed = TRUE;
+	unlockMutex( &bytesLock );
+	return prior;
+}
+
+/*******************************************************************
+ outstandingMemory -- return the number of bytes currently
+ allocated through allocMemory() and its kin, not counting headers.
+*******************************************************************/
+size_t outstandingMemory( void )
+{
+	size_t bytes;
+
+	lockMutex( &bytesLock );
+	bytes = outstandingBytes;
+	unlockMutex( &bytesLock );
+	return bytes;
+}
+
+/*******************************************************************
+ markSteadyState -- declare that the program has warmed up: from now
+ on it should be able to recycle the memory it already has, without
+ going to the heap.  Start counting the calls to malloc(), calloc(),
+ and realloc() from zero (whether we have warmed up before or not).
+ Objects recycled through allocSlab() don't count, but a fresh page
+ for a slab does.
+
+ If the environment variable PLS_STEADY_STATE is set, write the count
+ to stderr when the program exits.  If it is set to "strict", abort
+ the program at the first heap allocation instead, so that a debugger
+ can show where it came from.
+*******************************************************************/
+void markSteadyState( void )
+{
+	static int checked = FALSE;
+	const char * env;
+	int report = FALSE;
+
+	if( ! checked )
+	{
+		checked = TRUE;
+		env = getenv( "PLS_STEADY_STATE" );
+		if( env != NULL )
+		{
+			report = TRUE;
+			if( 0 == strcmp( env, "strict" ) )
+				(void) strictSteadyState( TRUE );
+		}
+	}
+
+	lockMutex( &bytesLock );
+	steadyState = TRUE;
+	steadyCount = 0;
+	unlockMutex( &bytesLock );
+
+	if( report )
+		atexit( reportSteadyState );
+}
+
+/*******************************************************************
+ steadyAllocations -- return the number of heap allocations since the
+ last call to markSteadyState(), or zero if there hasn't been one.
+*******************************************************************/
+unsigned long steadyAllocations( void )
+{
+	unsigned long count;
+
+	lockMutex( &bytesLock );
+	count = steadyCount;
+	unlockMutex( &bytesLock );
+	return count;
+}
+
+/*******************************************************************
+ strictSteadyState -- if on is TRUE, make any heap allocation after
+ the warm-up point abort the program; otherwise just count it.
+ Return the prior setting.
+*******************************************************************/
+int strictSteadyState( int on )
+{
+	int prior;
+
+	lockMutex( &bytesLock );
+	prior = steadyStrict;
+	steadyStrict = on ? TRUE : FALSE;
+	unlockMutex( &bytesLock );
+	return prior;
+}
+
+/*******************************************************************
+ reportSteadyState -- at exit: report the heap allocations since the
+ warm-up point.
+*******************************************************************/
+static void reportSteadyState( void )
+{
+	fprintf( stderr, "\nHeap allocations after warm-up: %lu\n",
+			 steadyAllocations() );
+}
+
+/*******************************************************************
+ noteBytes -- adjust the count of outstanding bytes.  If we have
+ just risen above the watermark, call the scavengers.
+*******************************************************************/
+static void noteBytes( size_t added, size_t removed )
+{
+	int trigger = FALSE;
+
+	lockMutex( &bytesLock );
+	checkWatermark();
+	outstandingBytes += added;
+	outstandingBytes -= removed;
+	if( outstandingBytes > peakBytes )
+		peakBytes = outstandingBytes;
+
+	if( steadyState && added > 0 )
+	{
+		++steadyCount;
+		if( steadyStrict )
+		{
+			fprintf( stderr, "\nHeap allocation of %lu bytes after warm-up\n",
+					 (unsigned long) added );
+			abort();
+		}
+	}
+
+	/* Only an allocation can take us above the watermark.  A free  */
+	/* may come from deep within the slab allocator, which mustn't  */
+	/* call the scavengers.                                         */
+
+	if( watermark > 0 )
+	{
+		if( outstandingBytes < watermark - watermark / 4 )
+			watermarkArmed = TRUE;
+		else if( watermarkArmed && added > 0
+				 && outstandingBytes > watermark && ! scavenging )
+		{
+			watermarkArmed = FALSE;
+			scavenging = TRUE;
+			trigger = TRUE;
+		}
+	}
+	unlockMutex( &bytesLock );
+
+	if( trigger )
+		runScavengers( FALSE );
+}
+
+/*******************************************************************
+ checkWatermark -- the first time through, take the watermark from
+ the environment variable PLS_WATERMARK, if it is set to a number of
+ bytes.  The caller must hold bytesLock.
+*******************************************************************/
+static void checkWatermark( void )
+{
+	const char * env;
+	char * pEnd;
+	unsigned long bytes;
+
+	if( watermarkChecked )
+		return;
+
+	watermarkChecked = TRUE;
+	env = getenv( "PLS_WATERMARK" );
+	if( NULL == env || '\0' == *env )
+		return;
+
+	bytes = strtoul( env, &pEnd, 10 );
+	if( '\0' == *pEnd )
+		watermark = (size_t) bytes;
+}
+
+/*******************************************************************
+ runScavengers -- call the registered scavengers, lowest priority
+ first, releasing the reserve slabs after each level of priority.
+ Unless all is TRUE, stop once the outstanding bytes fall below the
+ low-water mark.
+
+ Rather than sort the list, which would mean allocating memory just
+ when we're short of it, we make a pass to find the lowest priority
+ we haven't yet served, and another to call the scavengers with that
+ priority.  There are seldom more than a few distinct priorities.
+*******************************************************************/
+static void runScavengers( int all )
+{
+	MemoryPool * pMP;
+	int served = FALSE;		/* have we served any priority yet? */
+	int last = 0;			/* the last priority served */
+	int next;
+	int found;
+	size_t low;
+
+	lockMutex( &bytesLock );
+	scavenging = TRUE;
+	low = watermark - watermark / 4;
+	unlockMutex( &bytesLock );
+
+	releaseSlabs();
+
+	for( ;; )
+	{
+		if( ! all && outstandingMemory() < low )
+			break;
+
+		/* Find the next priority to serve */
+
+		found = FALSE;
+		next = 0;
+		for( pMP = poolList; pMP != NULL; pMP = pMP->pNext )
+		{
+			if( POOL_ACTIVE == pMP->state
+				&& ( ! served || pMP->priority > last )
+				&& ( ! found || pMP->priority < next ) )
+			{
+				next = pMP->priority;
+				found = TRUE;
+			}
+		}
+
+		if( ! found )
+			break;
+
+		/* Call every scavenger with that priority */
+
+		for( pMP = poolList; pMP != NULL; pMP = pMP->pNext )
+		{
+			if( POOL_ACTIVE == pMP->state && pMP->priority == next )
+				pMP->freeFunc( pMP->genericPtr );
+		}
+
+		/* The scavengers may have freed objects into the slabs */
+
+		releaseSlabs();
+
+		last = next;
+		served = TRUE;
+	}
+
+	lockMutex( &bytesLock );
+	scavenging = FALSE;
+	unlockMutex( &bytesLock );
+}
+
+/*******************************************************************
+ blockFailed -- report a failure to allocate memory, and return NULL.
+*******************************************************************/
+static void * blockFailed( const char * func, size_t size )
+{
+	fprintf( stderr, "\n%s: unable to allocate %lu bytes\n",
+			 func, (unsigned long) size );
+	return NULL;
+}
+
+/*******************************************************************
+ profileMemory -- start profiling the allocation requests, and
+ arrange to write the profile, in JSON, to the specified file when
+ the program exits or receives SIGUSR1.  A NULL or empty filename,
+ or "-", means standard error.  Once started, profiling continues
+ to the end of the program; a second call only changes the file.
+
+ Setting the environment variable PLS_MEMPROFILE to a file name has
+ the same effect, starting with the first allocation request.
+*******************************************************************/
+void profileMemory( const char * filename )
+{
+	int starting;
+
+	lockMutex( &profileLock );
+
+	if( NULL == filename || 0 == strcmp( filename, "-" ) )
+		filename = "";
+	strncpy( profilePath, filename, FILENAME_MAX - 1 );
+	profilePath[ FILENAME_MAX - 1 ] = '\0';
+
+	starting = ! profiling;
+	profiling = TRUE;
+	profileChecked = TRUE;
+
+	unlockMutex( &profileLock );
+
+	if( starting )
+	{
+		atexit( writeProfile );
+#ifdef SIGUSR1
+		signal( SIGUSR1, requestDump );
+#endif
+	}
+}
+
+/*******************************************************************
+ dumpMemoryProfile -- write the profile so far, in JSON, to a
+ specified file.  The call sites come in descending order of the
+ bytes requested.
+*******************************************************************/
+void dumpMemoryProfile( FILE * pF )
+{
+	static unsigned short order[ SITE_MAX ];
+	unsigned n;
+	unsigned i;
+	int first;
+	size_t peak;
+	size_t live;
+
+	ASSERT( pF != NULL );
+	if( NULL == pF )
+		return;
+
+	lockMutex( &bytesLock );
+	peak = peakBytes;
+	live = outstandingBytes;
+	unlockMutex( &bytesLock );
+
+	lockMutex( &profileLock );
+
+	fprintf( pF, "{\n  \"requests\": %lu,\n  \"requested_bytes\": %lu,\n",
+			 requestCount, requestBytes );
+	fprintf( pF, "  \"live_bytes\": %lu,\n  \"peak_live_bytes\": %lu,\n",
+			 (unsigned long) live, (unsigned long) peak );
+
+	/* The histogram: each bucket holds sizes up to a power of two, */
+	/* and greater than the power of two below it                   */
+
+	fprintf( pF, "  \"histogram\": [" );
+	first = TRUE;
+	for( i = 0; i < HIST_BUCKETS; ++i )
+	{
+		if( 0 == histogram[ i ] )
+			continue;
+
+		fprintf( pF, "%s\n    { \"max_size\": ", first ? "" : "," );
+		if( i < HIST_BUCKETS - 1 )
+			fprintf( pF, "%lu", 1UL << i );
+		else
+			fprintf( pF, "null" );
+		fprintf( pF, ", \"count\": %lu }", histogram[ i ] );
+		first = FALSE;
+	}
+	fprintf( pF, "%s],\n", first ? "" : "\n  " );
+
+	/* The call sites, busiest first */
+
+	for( i = 0, n = 0; i < SITE_MAX; ++i )
+	{
+		if( sites[ i ].file != NULL )
+			order[ n++ ] = (unsigned short) i;
+	}
+	qsort( order, n, sizeof( order[ 0 ] ), compareSites );
+
+	fprintf( pF, "  \"sites\": [" );
+	for( i = 0; i <= n; ++i )
+	{
+		const CallSite * pCS;
+
+		if( i < n )
+			pCS = sites + order[ i ];
+		else if( otherSite.count > 0 )
+			pCS = &otherSite;
+		else
+			break;
+
+		fprintf( pF, "%s\n    { \"file\": ", 0 == i ? "" : "," );
+		putJsonString( pF, pCS->file );
+		fprintf( pF, ", \"line\": %d, \"count\": %lu, \"bytes\": %lu }",
+				 pCS->line, pCS->count, pCS->bytes );
+	}
+	fprintf( pF, "%s]\n}\n", i > 0 ? "\n  " : "" );
+
+	unlockMutex( &profileLock );
+}
+
+/*******************************************************************
+ noteRequest -- record an allocation request in the profile, if we
+ are profiling.  Also write the profile, if a signal has asked us
+ to.
+*******************************************************************/
+static void noteRequest( const char * file, int line, size_t size )
+{
+	CallSite * pCS;
+	unsigned h;
+	unsigned i;
+	size_t bound;
+
+	if( ! profileChecked )
+	{
+		const char * path;
+
+		profileChecked = TRUE;
+		path = getenv( "PLS_MEMPROFILE" );
+		if( path != NULL )
+			profileMemory( path );
+	}
+
+	if( ! profiling )
+		return;
+
+	if( NULL == file )
+		file = "(unknown)";
+
+	lockMutex( &profileLock );
+
+	++requestCount;
+	requestBytes += size;
+
+	for( i = 0, bound = 1; i < HIST_BUCKETS - 1 && size > bound; ++i )
+		bound <<= 1;
+	++histogram[ i ];
+
+	/* Find the call site.  We hash the address of the file name, */
+	/* since __FILE__ yields the same address at each use within  */
+	/* a source file; but we compare the names, in case it doesn't. */
+
+	h = (unsigned) ( ( (unsigned long) file >> 3 ) * 31 + line );
+	pCS = NULL;
+	for( i = 0; i < SITE_MAX; ++i )
+	{
+		CallSite * pProbe = sites + ( ( h + i ) & ( SITE_MAX - 1 ) );
+
+		if( NULL == pProbe->file )
+		{
+			if( siteCount < SITE_MAX - SITE_MAX / 4 )
+			{
+				pProbe->file = file;
+				pProbe->line = line;
+				++siteCount;
+				pCS = pProbe;
+			}
+			break;
+		}
+		else if( pProbe->line == line &&
+				 ( pProbe->file == file || 0 == strcmp( pProbe->file, file ) ) )
+		{
+			pCS = pProbe;
+			break;
+		}
+	}
+
+	if( NULL == pCS )
+		pCS = &otherSite;		/* the table is too full */
+
+	++pCS->count;
+	pCS->bytes += size;
+
+	unlockMutex( &profileLock );
+
+	if( dumpRequested )
+	{
+		dumpRequested = 0;
+		writeProfile();
+	}
+}
+
+/*******************************************************************
+ writeProfile -- write the profile to the file specified through
+ profileMemory(), replacing any earlier contents.
+*******************************************************************/
+static void writeProfile( void )
+{
+	FILE * pF;
+
+	if( '\0' == profilePath[ 0 ] )
+		dumpMemoryProfile( stderr );
+	else
+	{
+		pF = fopen( profilePath, "w" );
+		if( NULL == pF )
+			fprintf( stderr, "\nUnable to open %s for memory profile\n",
+					 profilePath );
+		else
+		{
+			dumpMemoryProfile( pF );
+			fclose( pF );
+		}
+	}
+}
+
+/*******************************************************************
+ requestDump -- signal handler: ask for the profile to be written at
+ the next allocation request.
+*******************************************************************/
+static void requestDump( int sig )
+{
+	dumpRequested = 1;
+#ifdef SIGUSR1
+	signal( sig, requestDump );		/* in case it was reset */
+#endif
+}
+
+/*******************************************************************
+ compareSites -- qsort() callback to order call sites by descending
+ bytes, then by file and line so that the order is reproducible.
+*******************************************************************/
+static int compareSites( const void * p1, const void * p2 )
+{
+	const CallSite * pCS1 = sites + *(const unsigned short *) p1;
+	const CallSite * pCS2 = sites + *(const unsigned short *) p2;
+	int rc;
+
+	if( pCS1->bytes != pCS2->bytes )
+		return pCS1->bytes > pCS2->bytes ? -1 : 1;
+
+	rc = strcmp( pCS1->file, pCS2->file );
+	if( rc != 0 )
+		return rc;
+
+	return pCS1->line - pCS2->line;
+}
+
+/*******************************************************************
+ putJsonString -- write a string in quotes, escaping as JSON needs.
+*******************************************************************/
+static void putJsonString( FILE * pF, const char * s )
+{
+	putc( '"', pF );
+	for( ; *s != '\0'; ++s )
+	{
+		if( '"' == *s || '\\' == *s )
+			fprintf( pF, "\\%c", *s );
+		else if( (unsigned char) *s < ' ' )
+			fprintf( pF, "\\u%04x", (unsigned) (unsigned char) *s );
+		else
+			putc( *s, pF );
+	}
+	putc( '"', pF );
+}
+
+/*******************************************************************
+ fastExit -- turn fast-exit mode on or off, and return the prior
+ setting.  In fast-exit mode the debugging version doesn't bother to
+ call the memory scavengers, or to report memory usage, when the
+ program exits; the operating system will reclaim the memory anyway.
+ (The production version never does either, so for it the mode is
+ always on.)
+
+ Setting the environment variable PLS_LEAK_REPORT asks for the
+ purge and the report regardless.
+*******************************************************************/
+int fastExit( int on )
+{
+#ifndef NDEBUG
+
+	int prior;
+
+	lockMutex( &countLock );
+	if( -1 == fastExiting )
+	{
+#ifdef PLS_FAST_EXIT
+		prior = TRUE;
+#else
+		prior = getenv( "PLS_FAST_EXIT" ) != NULL ? TRUE : FALSE;
+#endif
+	}
+	else
+		prior = fastExiting;
+
+	fastExiting = on ? TRUE : FALSE;
+	unlockMutex( &countLock );
+
+	return prior;
+
+#else
+
+	(void) on;
+	return TRUE;
+
+#endif
+}
+
+#ifndef NDEBUG
+
+/********************************************************************
+ exitMemory -- at exit: unless we're in fast-exit mode, free all the
+ memory pools and report memory usage, so that any memory still
+ outstanding shows up as a leak.
+********************************************************************/
+static void exitMemory( void )
+{
+	int fast;
+
+	fast = fastExit( FALSE );
+	if( fast && NULL == getenv( "PLS_LEAK_REPORT" ) )
+		return;
+
+	purgeMemoryPools();
+	reportMemory();
+}
+
+/********************************************************************
+ reportMemory -- reports memory usage.
+********************************************************************/
+static void reportMemory( void )
+{
+    unsigned i;
+
+    fprintf( stderr,
+             "\nMaximum memory pools registered: %u\n", slotCount );
+
+    if( excessPools != 0 )
+        fprintf( stderr,
+                 "Memory pools which could not be registered: %u\n",
+                 excessPools );
+
+    fprintf( stderr,
+             "Total memory allocations: %lu\n", allocationCount );
+
+	fprintf( stderr,
+             "Maximum outstanding memory allocations: %lu\n",
+             maxCount );
+
+    if( outstandingCount != 0 )
+        fprintf( stderr,
+                 "\nMEMORY LEAK!  %lu un-freed allocations remain\n",
+                 outstandingCount );
+
+    for( i = 0; i < SLAB_CLASSES; ++i )
+    {
+        SlabStats stats;
+
+        (void) getSlabStats( i, &stats );
+        if( stats.inUse != 0 )
+            fprintf( stderr,
+                     "MEMORY LEAK!  %lu un-freed objects of %lu bytes remain\n",
+                     stats.inUse, (unsigned long) stats.size );
+    }
 }
 
 #endif
@@ -0,0 +1,494 @@
+/* ofile.c -- implementation of Ofile functions: buffered output to a
+   FILE, to a file descriptor, or to memory.
+
+   Writing a formatted file a character or a token at a time through
+   stdio means millions of library calls.  Instead we collect the text
+   in a large contiguous buffer and hand it over a block at a time.  We
+   also keep a ready-made string of indentation, built up front, so
+   that indenting to any depth is a single copy.
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "util.h"
+#include "ofile.h"
+
+#define WRITE_BLOCK   65536
+#define MEMORY_BLOCK  4096
+#define INDENT_LEVELS 16		/* levels of indentation to start with */
+
+/* The public interface Ofile contains only an opaque pointer.  Within
+   this source file we use that pointer to point to the following:
+*/
+typedef struct
+{
+	FILE * pF;			/* FILE backend, or NULL */
+	int fd;				/* file descriptor backend, or -1 */
+	char * buf;			/* pending output, or (in memory) all of it */
+	size_t len;
+	size_t cap;
+	int error;			/* TRUE if a write has failed */
+	char * indent;		/* unit of indentation, repeated */
+	const char * indent_unit;
+	size_t unit_len;
+	int indent_levels;	/* how many units the indent string holds */
+} OF;
+
+static OF * new_of( FILE * pF, int fd, size_t cap );
+static int drain( OF * pO );
+static int grow( OF * pO, size_t need );
+static int build_indent( OF * pO, const char * unit, int depth );
+
+/****************************************************************
+ o_assign: open an Ofile to write to an already-opened file.  We
+ don't close the file; o_close() merely flushes it.
+ ***************************************************************/
+Ofile o_assign( FILE * pF )
+{
+	Ofile o;
+
+	ASSERT( pF != NULL );
+
+	if( NULL == pF )
+		o.p = NULL;
+	else
+		o.p = new_of( pF, -1, WRITE_BLOCK );
+
+	return o;
+}
+
+/****************************************************************
+ o_fd: open an Ofile to write to a file descriptor, bypassing
+ stdio altogether.  We don't close the file descriptor.
+ ***************************************************************/
+Ofile o_fd( int fd )
+{
+	Ofile o;
+
+	ASSERT( fd >= 0 );
+
+	if( fd < 0 )
+		o.p = NULL;
+	else
+		o.p = new_of( NULL, fd, WRITE_BLOCK );
+
+	return o;
+}
+
+/****************************************************************
+ o_memory: open an Ofile to collect the output in memory, where
+ o_contents() can find it.
+ ***************************************************************/
+Ofile o_memory( void )
+{
+	Ofile o;
+
+	o.p = new_of( NULL, -1, MEMORY_BLOCK );
+	return o;
+}
+
+/****************************************************************
+ new_of: allocate and initialize the internal structure.
+ ***************************************************************/
+static OF * new_of( FILE * pF, int fd, size_t cap )
+{
+	OF * pO;
+
+	pO = allocMemory( sizeof( OF ) );
+	if( pO != NULL )
+	{
+		pO->buf = allocMemory( cap );
+		if( NULL == pO->buf )
+		{
+			freeMemory( pO );
+			return NULL;
+		}
+
+		pO->pF = pF;
+		pO->fd = fd;
+		pO->len = 0;
+		pO->cap = cap;
+		pO->error = FALSE;
+		pO->indent = NULL;
+		pO->indent_unit = NULL;
+		pO->unit_len = 0;
+		pO->indent_levels = 0;
+	}
+	return pO;
+}
+
+/****************************************************************
+ o_putc: write a single character.
+ ***************************************************************/
+int o_putc( Ofile o, int c )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	if( NULL == pO )
+		return ERROR_FOUND;
+
+	if( pO->len == pO->cap && grow( pO, 1 ) != OKAY )
+		return ERROR_FOUND;
+
+	pO->buf[ pO->len++ ] = (char) c;
+	return OKAY;
+}
+
+/****************************************************************
+ o_puts: write a nul-terminated string (without the nul).
+ ***************************************************************/
+int o_puts( Ofile o, const char * s )
+{
+	ASSERT( s != NULL );
+	if( NULL == s )
+		return ERROR_FOUND;
+
+	return o_write( o, s, strlen( s ) );
+}
+
+/****************************************************************
+ o_write: write a specified number of bytes.  A block too big to
+ be worth copying goes straight to the backend, after whatever is
+ already in the buffer.
+ ***************************************************************/
+int o_write( Ofile o, const char * buf, size_t len )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	ASSERT( buf != NULL || 0 == len );
+	if( NULL == pO || ( NULL == buf && len > 0 ) )
+		return ERROR_FOUND;
+
+	if( len > pO->cap - pO->len )
+	{
+		if( pO->pF != NULL || pO->fd >= 0 )
+		{
+			if( drain( pO ) != OKAY )
+				return ERROR_FOUND;
+
+			if( len >= pO->cap )
+			{
+				/* Write it directly, by pretending it's the buffer */
+
+				char * save_buf = pO->buf;
+				int rc;
+
+				pO->buf = (char *) buf;
+				pO->len = len;
+				rc = drain( pO );
+				pO->buf = save_buf;
+				return rc;
+			}
+		}
+		else if( grow( pO, len ) != OKAY )
+			return ERROR_FOUND;
+	}
+
+	memcpy( pO->buf + pO->len, buf, len );
+	pO->len += len;
+	return OKAY;
+}
+
+/****************************************************************
+ o_set_indent: declare the unit of indentation that o_indent()
+ will be given, and build the string of indentation for it now,
+ so that indenting later allocates nothing unless it goes deeper
+ than INDENT_LEVELS.  The client code must not change the
+ contents of the unit string while it is in use.
+ ***************************************************************/
+int o_set_indent( Ofile o, const char * unit )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	ASSERT( unit != NULL );
+	if( NULL == pO || NULL == unit )
+		return ERROR_FOUND;
+
+	if( unit == pO->indent_unit )
+		return OKAY;
+
+	return build_indent( pO, unit, INDENT_LEVELS );
+}
+
+/****************************************************************
+ o_indent: write depth units of indentation, where a unit is a
+ string such as "    " or "\t".  We keep the unit repeated in a
+ string long enough for the deepest indentation so far, so that
+ any depth takes a single copy.  If the unit is not the one given
+ to o_set_indent(), we build the string for it first.  The client
+ code must not change the contents of the unit string while it is
+ in use.
+ ***************************************************************/
+int o_indent( Ofile o, const char * unit, int depth )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	ASSERT( unit != NULL );
+	if( NULL == pO || NULL == unit )
+		return ERROR_FOUND;
+
+	if( depth <= 0 )
+		return OKAY;
+
+	if( unit != pO->indent_unit || depth > pO->indent_levels )
+	{
+		if( build_indent( pO, unit, depth ) != OKAY )
+			return ERROR_FOUND;
+	}
+
+	return o_write( o, pO->indent, pO->unit_len * (size_t) depth );
+}
+
+/****************************************************************
+ build_indent: (re)build the indentation string for a given unit,
+ with room for at least the specified depth.
+ ***************************************************************/
+static int build_indent( OF * pO, const char * unit, int depth )
+{
+	int levels;
+	int i;
+	size_t unit_len;
+	char * pNew;
+
+	unit_len = strlen( unit );
+
+	levels = pO->indent_levels > 0 ? pO->indent_levels : INDENT_LEVELS;
+	while( levels < depth )
+		levels *= 2;
+
+	if( NULL == pO->indent )
+		pNew = allocMemory( unit_len * (size_t) levels + 1 );
+	else
+		pNew = resizeMemory( pO->indent, unit_len * (size_t) levels + 1 );
+
+	if( NULL == pNew )
+		return ERROR_FOUND;
+
+	for( i = 0; i < levels; ++i )
+		memcpy( pNew + unit_len * (size_t) i, unit, unit_len );
+	pNew[ unit_len * (size_t) levels ] = '\0';
+
+	pO->indent = pNew;
+	pO->indent_unit = unit;
+	pO->unit_len = unit_len;
+	pO->indent_levels = levels;
+	return OKAY;
+}
+
+/****************************************************************
+ o_flush: write out anything in the buffer, and flush the FILE if
+ there is one.  For an Ofile in memory there's nothing to do.
+ ***************************************************************/
+int o_flush( Ofile o )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	if( NULL == pO )
+		return ERROR_FOUND;
+
+	if( NULL == pO->pF && pO->fd < 0 )
+		return OKAY;
+
+	if( drain( pO ) != OKAY )
+		return ERROR_FOUND;
+
+	if( pO->pF != NULL && fflush( pO->pF ) != 0 )
+	{
+		pO->error = TRUE;
+		return ERROR_FOUND;
+	}
+
+	return OKAY;
+}
+
+/****************************************************************
+ o_contents: return a pointer to the text written so far to an
+ Ofile in memory, and store its length through pLen (if not NULL).
+ The text is nul-terminated for convenience; the nul is not
+ counted.  The pointer remains valid until the next write or the
+ close.  For any other kind of Ofile, return NULL.
+ ***************************************************************/
+const char * o_contents( Ofile o, size_t * pLen )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	if( NULL == pO || pO->pF != NULL || pO->fd >= 0 )
+		return NULL;
+
+	if( pO->len == pO->cap && grow( pO, 1 ) != OKAY )
+		return NULL;
+
+	pO->buf[ pO->len ] = '\0';
+	if( pLen != NULL )
+		*pLen = pO->len;
+	return pO->buf;
+}
+
+/****************************************************************
+ o_truncate: discard all but the first len bytes written to an
+ Ofile in memory, so that it may be reused without reallocating.
+ For any other kind of Ofile, or if len is longer than what has
+ been written, return ERROR_FOUND.
+ ***************************************************************/
+int o_truncate( Ofile o, size_t len )
+{
+	OF * pO;
+
+	pO = o.p;
+	ASSERT( pO != NULL );
+	if( NULL == pO || pO->pF != NULL || pO->fd >= 0 || len > pO->len )
+		return ERROR_FOUND;
+
+	pO->len = len;
+	return OKAY;
+}
+
+/****************************************************************
+ o_error: return TRUE if any write has failed.
+ ***************************************************************/
+int o_error( Ofile o )
+{
+	OF * pO;
+
+	pO = o.p;
+	if( NULL == pO )
+		return TRUE;
+	else
+		return pO->error;
+}
+
+/****************************************************************
+ o_close: flush the Ofile and release its resources.  Return
+ ERROR_FOUND if any write failed, now or earlier.
+ ***************************************************************/
+int o_close( Ofile * pO )
+{
+	int rc = OKAY;
+
+	ASSERT( pO != NULL );
+
+	if( pO->p != NULL )
+	{
+		OF * pOF;
+
+		if( o_flush( *pO ) != OKAY )
+			rc = ERROR_FOUND;
+
+		pOF = pO->p;
+		pO->p = NULL;
+
+		if( pOF->error )
+			rc = ERROR_FOUND;
+
+		if( pOF->indent != NULL )
+			freeMemory( pOF->indent );
+		freeMemory( pOF->buf );
+		freeMemory( pOF );
+	}
+
+	return rc;
+}
+
+/****************************************************************
+ drain: hand the contents of the buffer to the backend, and empty
+ the buffer.  After a failure we discard the output, but remember
+ the error.
+ ***************************************************************/
+static int drain( OF * pO )
+{
+	const char * p = pO->buf;
+	size_t to_go = pO->len;
+
+	pO->len = 0;
+
+	if( pO->error )
+		return ERROR_FOUND;
+
+	if( pO->pF != NULL )
+	{
+		if( to_go > 0 && fwrite( p, 1, to_go, pO->pF ) != to_go )
+			pO->error = TRUE;
+	}
+	else
+	{
+		while( to_go > 0 )
+		{
+			ssize_t n;
+
+			n = write( pO->fd, p, to_go );
+			if( n < 0 )
+			{
+				if( EINTR == errno )
+					continue;
+				pO->error = TRUE;
+				break;
+			}
+			p += n;
+			to_go -= (size_t) n;
+		}
+	}
+
+	return pO->error ? ERROR_FOUND : OKAY;
+}
+
+/****************************************************************
+ grow: make room for need more bytes: by draining the buffer if
+ there is a backend, or by enlarging it if the Ofile is in memory.
+ ***************************************************************/
+static int grow( OF * pO, size_t need )
+{
+	size_t new_cap;
+	char * pNew;
+
+	if( pO->pF != NULL || pO->fd >= 0 )
+		return drain( pO );
+
+	if( need > (size_t) -1 / 2 - pO->len )
+		return ERROR_FOUND;
+
+	new_cap = pO->cap;
+	while( new_cap < pO->len + need )
+		new_cap *= 2;
+
+	pNew = resizeMemory( pO->buf, new_cap );
+	if( NULL == pNew )
+	{
+		pO->error = TRUE;
+		return ERROR_FOUND;
+	}
+
+	pO->buf = pNew;
+	pO->cap = new_cap;
+	return OKAY;
+}
@@ -0,0 +1,51 @@
+/* ofile.h: header for Ofile functions.  An Ofile is a buffered sink for
+   output text, writing to a FILE, to a file descriptor, or to memory.
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef OFILE_H
+#define OFILE_H
+
+typedef struct
+{
+	void * p;	/* opaque pointer to internal structure */
+} Ofile;
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+Ofile o_assign( FILE * pF );
+Ofile o_fd( int fd );
+Ofile o_memory( void );
+int o_putc( Ofile o, int c );
+int o_puts( Ofile o, const char * s );
+int o_write( Ofile o, const char * buf, size_t len );
+int o_set_indent( Ofile o, const char * unit );
+int o_indent( Ofile o, const char * unit, int depth );
+int o_flush( Ofile o );
+const char * o_contents( Ofile o, size_t * pLen );
+int o_truncate( Ofile o, size_t len );
+int o_error( Ofile o );
+int o_close( Ofile * pO );
+
+#ifdef __cplusplus
+	};
+#endif
+
+#endif
@@ -21,18 +21,142 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static int beautify( void );
+static const char * option_value( int argc, char * argv[] );
+static int parse_ranges( const char * arg, Plsb_range ** pRanges,
+	int * pCount );
+static int format_lines( FILE * pIn, const Plsb_range * ranges,
+	int count );
+static int format_resume( FILE * pIn, const char * index_path );
 
 int main( int argc, char * argv[] )
 {
 	int rc;
 	FILE * pIn;
 	Sfile s;
+	Ofile out;
+	Plsb_context ctx;
+	int jobs = 0;
+	const char * out_dir = NULL;
+	Plsb_range * ranges = NULL;
+	int range_count = 0;
+	const char * index_path = NULL;
+	int check = FALSE;
+
+	/* --jobs and --output select batch mode, in which we beautify */
+	/* any number of files and directories, in place or into a    */
+	/* mirrored tree, instead of writing to standard output.      */
+	/* --check selects batch mode without writing anything.       */
+
+	while( argc > 1 && 0 == strncmp( argv[ 1 ], "--", 2 ) )
+	{
+		const char * value;
+
+		if( 0 == strcmp( argv[ 1 ], "--check" ) )
+		{
+			check = TRUE;
+			--argc;
+			++argv;
+			continue;
+		}
+		else if( 0 == strcmp( argv[ 1 ], "--jobs" ) )
+		{
+			char * end;
+			long n;
+
+			if( NULL == ( value = option_value( argc, argv ) ) )
+				return EXIT_FAILURE;
+			n = strtol( value, &end, 10 );
+			jobs = n < 1 || n > INT_MAX ? 0 : (int) n;
+			if( end == value || *end != '\0' || jobs < 1 )
+			{
+				fprintf( stderr, "Invalid number of jobs: %s\n", value );
+				return EXIT_FAILURE;
+			}
+		}
+		else if( 0 == strcmp( argv[ 1 ], "--output" ) )
+		{
+			if( NULL == ( value = option_value( argc, argv ) ) )
+				return EXIT_FAILURE;
+			out_dir = value;
+		}
+		else if( 0 == strcmp( argv[ 1 ], "--cache" ) )
+		{
+			if( NULL == ( value = option_value( argc, argv ) ) )
+				return EXIT_FAILURE;
+			if( plsb_cache_config( value ) != OKAY )
+			{
+				fprintf( stderr, "Invalid cache directory: %s\n", value );
+				return EXIT_FAILURE;
+			}
+		}
+		else if( 0 == strcmp( argv[ 1 ], "--checkpoints" ) )
+		{
+			if( NULL == ( value = option_value( argc, argv ) ) )
+				return EXIT_FAILURE;
+			index_path = value;
+		}
+		else if( 0 == strcmp( argv[ 1 ], "--lines" ) )
+		{
+			if( NULL == ( value = option_value( argc, argv ) ) )
+				return EXIT_FAILURE;
+			if( ranges != NULL )
+				freeMemory( ranges );
+			if( parse_ranges( value, &ranges, &range_count ) != OKAY )
+			{
+				fprintf( stderr, "Invalid line ranges: %s\n", value );
+				return EXIT_FAILURE;
+			}
+		}
+		else
+			break;
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if( ranges != NULL && index_path != NULL )
+	{
+		fprintf( stderr, "--lines and --checkpoints can't be combined\n" );
+		freeMemory( ranges );
+		return EXIT_FAILURE;
+	}
+
+	if( jobs > 0 || out_dir != NULL || check )
+	{
+		if( ranges != NULL || index_path != NULL )
+		{
+			fprintf( stderr, "--lines and --checkpoints apply only "
+				"to a single file\n" );
+			if( ranges != NULL )
+				freeMemory( ranges );
+			return EXIT_FAILURE;
+		}
+
+		if( argc < 2 || ( check && out_dir != NULL ) )
+		{
+			fprintf( stderr, "Usage: plsb [--jobs N] [--output dir] "
+				"file-or-directory...\n"
+				"       plsb --check [--jobs N] file-or-directory...\n" );
+			return EXIT_FAILURE;
+		}
+
+		if( check )
+			rc = plsb_check( jobs, NULL, argc - 1, argv + 1 );
+		else
+			rc = plsb_batch( jobs, out_dir, NULL, argc - 1, argv + 1 );
+
+		if( OKAY == rc )
+			return EXIT_SUCCESS;
+		else
+			return EXIT_FAILURE;
+	}
 
 	if( argc < 2 )
 		pIn = stdin;
@@ -43,11 +167,44 @@ int main( int argc, char * argv[] )
 		{
 			fprintf( stderr, "Unable to open %s for input\n",
 				argv[ 1 ] );
+			if( ranges != NULL )
+				freeMemory( ranges );
 			return EXIT_FAILURE;
 		}
 	}
 
-	s = s_assign( pIn );
+	/* With --lines, we beautify only the selected lines, and */
+	/* pass the rest through as they are                      */
+
+	if( ranges != NULL )
+	{
+		rc = format_lines( pIn, ranges, range_count );
+		freeMemory( ranges );
+		if( pIn != stdin )
+			fclose( pIn );
+
+		if( OKAY == rc )
+			return EXIT_SUCCESS;
+		else
+			return EXIT_FAILURE;
+	}
+
+	/* With --checkpoints, we resume from the checkpoints of the */
+	/* last run, and replace them with new ones                  */
+
+	if( index_path != NULL )
+	{
+		rc = format_resume( pIn, index_path );
+		if( pIn != stdin )
+			fclose( pIn );
+
+		if( OKAY == rc )
+			return EXIT_SUCCESS;
+		else
+			return EXIT_FAILURE;
+	}
+
+	s = pls_cache_open( pIn );
 	if( NULL == s.p )
 	{
 		fprintf( stderr, "Unable to assign an Sfile\n" );
@@ -56,16 +213,44 @@ int main( int argc, char * argv[] )
 		return EXIT_FAILURE;
 	}
 
-	rc = plsb_init();
+	out = o_assign( stdout );
+	if( NULL == out.p )
+	{
+		fprintf( stderr, "Unable to assign an Ofile\n" );
+		s_close( &s );
+		if( pIn != stdin )
+			fclose( pIn );
+		return EXIT_FAILURE;
+	}
+
+	rc = plsb_init( &ctx, out );
 	if( OKAY == rc )
-		rc = plsb_open( s );
+		rc = plsb_open( &ctx, s );
 
 	if( OKAY == rc )
 	{
-		rc = beautify();
+		/* The steady state is a property of this process, not of  */
+		/* the library, so we declare the warm-up point ourselves. */
+
+		(void) pls_reserve();
+		ctx.on_warm = markSteadyState;
+		rc = plsb_spool_open( &ctx );
+		if( OKAY == rc )
+		{
+			rc = plsb_beautify( &ctx );
+			if( rc != OKAY )
+				fprintf( stderr, "Unable to beautify input\n" );
+		}
+		plsb_close( &ctx );
 		s_close( &s );
 	}
 
+	if( o_close( &out ) != OKAY )
+	{
+		fprintf( stderr, "Error writing output\n" );
+		rc = ERROR_FOUND;
+	}
+
 	if( pIn != stdin )
 		fclose( pIn );
 
@@ -76,38 +261,165 @@ int main( int argc, char * argv[] )
 }
 
 /********************************************************************
- parse -- main loop for fetching and displaying successive logical
- lines.
+ option_value -- return the value following the option in argv[ 1 ],
+ or, if there isn't one, complain and return NULL.
+ *******************************************************************/
+static const char * option_value( int argc, char * argv[] )
+{
+	if( argc > 2 )
+		return argv[ 2 ];
+
+	fprintf( stderr, "Missing value for %s\n", argv[ 1 ] );
+	return NULL;
+}
+
+/********************************************************************
+ parse_ranges -- parse a list of line ranges such as "10-20,35,40-41"
+ into a dynamically allocated array of Plsb_ranges.  It is the
+ caller's responsibility to free the array with freeMemory().
  *******************************************************************/
-static int beautify( void )
+static int parse_ranges( const char * arg, Plsb_range ** pRanges,
+	int * pCount )
 {
-	int rc = OKAY;
-	int finished = FALSE;
-	Toklist list;
+	int count = 1;
+	const char * p;
+	Plsb_range * ranges;
+
+	for( p = arg; *p != '\0'; ++p )
+		if( ',' == *p )
+			++count;
+
+	ranges = allocMemory( count * sizeof( Plsb_range ) );
+	if( NULL == ranges )
+		return ERROR_FOUND;
 
-	while( FALSE == finished )
+	p = arg;
+	for( count = 0; ; ++count )
 	{
-		rc = get_logical_line( &list );
+		char * end;
 
-		if( rc != OKAY )
+		ranges[ count ].first = (int) strtol( p, &end, 10 );
+		if( end == p || ranges[ count ].first < 1 )
+			break;
+
+		if( '-' == *end )
 		{
-			fprintf( stderr, "Error getting logical line\n" );
-			finished = TRUE;
+			p = end + 1;
+			ranges[ count ].last = (int) strtol( p, &end, 10 );
+			if( end == p || ranges[ count ].last < ranges[ count ].first )
+				break;
 		}
 		else
+			ranges[ count ].last = ranges[ count ].first;
+
+		if( '\0' == *end )
 		{
-			rc = write_logical_line( &list );
-			if( OKAY != rc )
-			{
-				fprintf( stderr, "Error writing logical line\n" );
-				finished = TRUE;
-			}
-			else if( T_eof == list.pLast->type )
-				finished = TRUE;
+			*pRanges = ranges;
+			*pCount = count + 1;
+			return OKAY;
 		}
+		else if( *end != ',' )
+			break;
+
+		p = end + 1;
+	}
+
+	freeMemory( ranges );
+	return ERROR_FOUND;
+}
+
+/********************************************************************
+ format_lines -- read an entire input file, beautify the selected
+ lines, and write the result to standard output.
+ *******************************************************************/
+static int format_lines( FILE * pIn, const Plsb_range * ranges,
+	int count )
+{
+	int rc;
+	char * buf;
+	size_t len;
+	Ofile out;
+
+	buf = s_read_all( pIn, &len );
+	if( NULL == buf )
+	{
+		fprintf( stderr, "Unable to read input\n" );
+		return ERROR_FOUND;
+	}
+
+	out = o_assign( stdout );
+	if( NULL == out.p )
+	{
+		fprintf( stderr, "Unable to assign an Ofile\n" );
+		freeMemory( buf );
+		return ERROR_FOUND;
+	}
+
+	rc = plsb_format_lines( buf, len, NULL, ranges, count, out );
+	freeMemory( buf );
+	if( rc != OKAY )
+		fprintf( stderr, "Unable to beautify input\n" );
+
+	if( o_close( &out ) != OKAY )
+	{
+		fprintf( stderr, "Error writing output\n" );
+		rc = ERROR_FOUND;
+	}
+
+	return rc;
+}
+
+/********************************************************************
+ format_resume -- read an entire input file, and beautify it to
+ standard output, starting from the checkpoints in an index file (if
+ it exists).  Then replace the index file with the new checkpoints.
+ *******************************************************************/
+static int format_resume( FILE * pIn, const char * index_path )
+{
+	int rc;
+	char * buf;
+	size_t len;
+	Ofile out;
+	Plsb_index index;
+
+	buf = s_read_all( pIn, &len );
+	if( NULL == buf )
+	{
+		fprintf( stderr, "Unable to read input\n" );
+		return ERROR_FOUND;
+	}
+
+	out = o_assign( stdout );
+	if( NULL == out.p )
+	{
+		fprintf( stderr, "Unable to assign an Ofile\n" );
+		freeMemory( buf );
+		return ERROR_FOUND;
+	}
+
+	/* A missing or unusable index just means starting from scratch */
+
+	plsb_index_init( &index );
+	(void) plsb_index_load( &index, index_path );
+
+	rc = plsb_format_resume( buf, len, NULL, &index, out );
+	freeMemory( buf );
+	if( rc != OKAY )
+		fprintf( stderr, "Unable to beautify input\n" );
 
-		empty_toklist( &list );
+	if( o_close( &out ) != OKAY )
+	{
+		fprintf( stderr, "Error writing output\n" );
+		rc = ERROR_FOUND;
+	}
+
+	if( OKAY == rc && plsb_index_save( &index, index_path ) != OKAY )
+	{
+		fprintf( stderr, "Unable to write checkpoints to %s\n",
+			index_path );
+		rc = ERROR_FOUND;
 	}
 
+	plsb_index_free( &index );
 	return rc;
 }
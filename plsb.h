@@ -20,10 +20,15 @@
 #ifndef PLSB_H
 #define PLSB_H
 
+#include "libplsb.h"	/* Plsb_options, plsb_format(), etc. */
+
 struct Toknode_;
 typedef struct Toknode_ Toknode;
 
-/* The following struct is a node in a doubly-linked list of tokens.  */
+/* The following struct is an element in a list of tokens.  The       */
+/* elements of a list are adjacent in an array (see plsb01.c), so     */
+/* the next and previous elements are found by NEXT_NODE and         */
+/* PREV_NODE, which return NULL at either end of the list. */
 
 /* The type member merely repeats the type from the associated token, */
 /* in order to eliminate a layer of indirection when traversing a     */
@@ -34,20 +39,27 @@ typedef struct Toknode_ Toknode;
 
 struct Toknode_
 {
-	Toknode * pNext;
-	Toknode * pPrev;
 	Pls_token_type type;
 	int spacer;
 	int lf;		/* boolean; whether issue a line feed before token */
 	int indent_change; 	/* how much to change indentation, if at all */
 	size_t size;
-	Pls_tok * pT;
+	Pls_tok * pT;	/* NULL only in the sentinels at the ends */
 };
 
+#define NEXT_NODE( pTN ) ( NULL == (pTN)[ 1 ].pT  ? NULL : (pTN) + 1 )
+#define PREV_NODE( pTN ) ( NULL == (pTN)[ -1 ].pT ? NULL : (pTN) - 1 )
+
+/* A Toklist owns its array of Toknodes, which it keeps when emptied. */
+/* Members other than pFirst and pLast are private to plsb01.c. */
+
 typedef struct
 {
-	Toknode * pFirst;
-	Toknode * pLast;
+	Toknode * pFirst;	/* NULL if the list is empty */
+	Toknode * pLast;	/* NULL if the list is empty */
+	Toknode * nodes;	/* the array, with a sentinel at each end */
+	size_t count;		/* how many Toknodes, not counting sentinels */
+	size_t capacity;	/* how many Toknodes allocated */
 } Toklist;
 
 typedef enum
@@ -59,16 +71,6 @@ typedef enum
 	P_always
 } Probability;
 
-/* The following structure is a home for miscellaneous global     */
-/* variables.  There should be only on instance of a Pls_globals. */
-
-typedef struct
-{
-	int indentation;
-	const char * indent_string;
-	const char * soft_indent_string;
-} Pls_globals;
-extern Pls_globals pls_globals;
 
 /* Enum for different kinds of syntax to parse: */
 
@@ -145,28 +147,136 @@ struct Syntax_level
 	Syntax_level * pNext;
 };
 
-extern Syntax_level curr_level;
+/* A literal or comment too big to keep in memory goes to a spool  */
+/* file as it is read (see plsb03.c).  Since tokens are written in  */
+/* the same order as they are read, we need only remember the      */
+/* length of each one. */
+
+typedef struct Spooled_
+{
+	struct Spooled_ * pNext;
+	unsigned long len;
+} Spooled;
+
+/* The following is used to maintain a stack to keep track of  */
+/* which token types are at the beginning of each level of     */
+/* indent.  The main reason is so that we can un-indent twice  */
+/* between the end of a WHEN clause and a following END token. */
+
+#define TYPESTACK_DEPTH 32
+
+/* A Plsb_context holds all the state of the beautifier for one    */
+/* input stream, so that several streams may be formatted at once  */
+/* (in different threads, if need be).  The client code allocates  */
+/* it, initializes it with plsb_init(), and passes it to each of   */
+/* the other functions.  Treat the members as private. */
+
+typedef struct
+{
+	/* options and output */
+
+	int indentation;
+	const char * indent_string;
+	const char * soft_indent_string;
+	Ofile output;
+	void (* on_warm)( void );	/* if not NULL, called by plsb_beautify() */
+								/* after the first logical line           */
+
+	/* input (plsb02.c) */
+
+	int is_open;
+	Sfile s;
+	Pls_lookahead ahead;
+
+	/* indentation (plsb03.c) */
+
+	int deferred_unindents;
+	Pls_token_type typestack[ TYPESTACK_DEPTH ];
+	int type_top;
+
+	/* spooling (plsb03.c) */
+
+	FILE * spool;
+	long spool_read;			/* offset of the next unwritten text */
+	unsigned long spool_len;	/* length of the token being spooled */
+	Spooled * pSpool_head;
+	Spooled * pSpool_tail;
+
+	/* syntax levels (plsb04.c) */
+
+	Syntax_level curr_level;
+	Syntax_level * level_stack;
+} Plsb_context;
+
+/* A Plsb_checkpoint records the state of the beautifier at the start */
+/* of an input line, and a Plsb_index holds the checkpoints of one    */
+/* input, in order (see plsb14.c).  Treat the members as private. */
+
+typedef struct
+{
+	int line;
+	size_t offset;			/* of the start of the line */
+	uint64_t hash;			/* pls_hash() of the text up to the next */
+	int fixed;				/* boolean: that text came out unchanged */
+	int indentation;
+	int deferred_unindents;
+	int type_top;
+	Pls_token_type typestack[ TYPESTACK_DEPTH ];
+	Syntax_level curr_level;
+	int level_count;		/* how many levels on the stack */
+	Syntax_level * levels;	/* the stacked levels, top first, or NULL */
+} Plsb_checkpoint;
+
+typedef struct
+{
+	uint64_t key;			/* identifies the options and version */
+	size_t len;				/* length of the input */
+	Plsb_checkpoint * points;
+	size_t count;
+	size_t capacity;
+} Plsb_index;
 
-int edit_syntax( Toklist * pTL );
+int edit_syntax( Plsb_context * pC, Toklist * pTL );
 
-int plsb_init( void );
-int plsb_open( Sfile sfile );
-int get_logical_line( Toklist * pTL );
-int write_logical_line( Toklist * pTL );
-void exit_all_levels( void );
-int push_level( void );
-void pop_level( void );
-void defer_unindent( int how_many );
-void add_indent( Toknode * pTN, S_state state );
-void reduce_indent( Toknode * pTN, S_state state );
+int plsb_init( Plsb_context * pC, Ofile output );
+int plsb_at_rest( const Plsb_context * pC );
+int plsb_open( Plsb_context * pC, Sfile sfile );
+int get_logical_line( Plsb_context * pC, Toklist * pTL );
+int write_logical_line( Plsb_context * pC, Toklist * pTL );
+int plsb_spool_open( Plsb_context * pC );
+void plsb_spool_close( Plsb_context * pC );
+void exit_all_levels( Plsb_context * pC );
+int push_level( Plsb_context * pC );
+void pop_level( Plsb_context * pC );
+void defer_unindent( Plsb_context * pC, int how_many );
+void add_indent( Plsb_context * pC, Toknode * pTN, S_state state );
+void reduce_indent( Plsb_context * pC, Toknode * pTN, S_state state );
 
-int  do_select_syntax( Toknode * pTN );
-int  do_insert_syntax( Toknode * pTN );
-int  do_update_syntax( Toknode * pTN );
-int  do_cursor_syntax( Toknode * pTN );
-int  do_fetch_syntax( Toknode * pTN );
+int  do_select_syntax( Plsb_context * pC, Toknode * pTN );
+int  do_insert_syntax( Plsb_context * pC, Toknode * pTN );
+int  do_update_syntax( Plsb_context * pC, Toknode * pTN );
+int  do_cursor_syntax( Plsb_context * pC, Toknode * pTN );
+int  do_fetch_syntax( Plsb_context * pC, Toknode * pTN );
 
-void plsb_close( void );
+void plsb_close( Plsb_context * pC );
+int plsb_beautify( Plsb_context * pC );
+int plsb_format_piece( const char * in, size_t len,
+	const Plsb_options * pOpt, Ofile out, int * pAt_rest );
+void plsb_index_init( Plsb_index * pX );
+void plsb_index_free( Plsb_index * pX );
+int plsb_index_load( Plsb_index * pX, const char * path );
+int plsb_index_save( const Plsb_index * pX, const char * path );
+int plsb_format_resume( const char * in, size_t len,
+	const Plsb_options * pOpt, Plsb_index * pX, Ofile out );
+int plsb_batch( int jobs, const char * out_dir, const Plsb_options * pOpt,
+	int count, char * paths[] );
+int plsb_check( int jobs, const Plsb_options * pOpt, int count,
+	char * paths[] );
+int plsb_cache_config( const char * dir );
+int plsb_cache_fixed( const char * text, size_t len,
+	const Plsb_options * pOpt );
+void plsb_cache_record( const char * text, size_t len,
+	const Plsb_options * pOpt );
 Probability is_final( Pls_token_type type );
 Probability is_first( Pls_token_type type );
 int need_space( Pls_token_type first, Pls_token_type second );
@@ -177,6 +287,6 @@ int extend_toklist( Toklist * pLL, Pls_tok * pT );
 Pls_tok * truncate_toklist( Toklist * pTL );
 int init_toklist( Toklist * pLL, Pls_tok * pT );
 void empty_toklist( Toklist * pLL );
-void free_toknode( Toknode ** ppTN );
+void free_toklist( Toklist * pTL );
 
 #endif
@@ -26,10 +26,9 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-Pls_globals pls_globals;
-
 /*******************************************************************
  is_final -- report the likelihood that a given token type is the
  last token on a logical line.
@@ -39,6 +38,7 @@ Probability is_final( Pls_token_type type )
 	switch ( type )
 	{
 	case T_remark :
+	case T_wrapped :
 	case T_eof :
 		return P_always;
 	case T_semicolon :
@@ -101,6 +101,7 @@ int need_space( Pls_token_type first, Pls_token_type second )
 	{
 		case T_semicolon :
 		case T_eof :
+		case T_wrapped :	/* begins with its own white space */
 		case T_percent :
 		case T_comma :
 		case T_dot :
@@ -203,14 +204,76 @@ int need_unindent( Pls_token_type type )
 }
 
 /************************************************************************
- plsb_init -- initialize whatever needs to be initialized, in particular
- pls_globals.  Ultimately this will be a home for code to read a
- configuration file.
+ plsb_init -- initialize a Plsb_context, which we assume to contain
+ garbage.  Ultimately this will be a home for code to read a
+ configuration file.  The formatted output goes to the specified Ofile,
+ which remains the client code's responsibility to close.
+ ***********************************************************************/
+int plsb_init( Plsb_context * pC, Ofile output )
+{
+	ASSERT( pC != NULL );
+	ASSERT( output.p != NULL );
+	if( NULL == pC || NULL == output.p )
+		return ERROR_FOUND;
+
+	pC->indentation = 0;
+	pC->indent_string = "    ";
+	pC->soft_indent_string = "  ";
+	pC->output = output;
+	pC->on_warm = NULL;
+
+	pC->is_open = FALSE;
+	pC->s.p = NULL;
+
+	pC->deferred_unindents = 0;
+	pC->type_top = -1;
+
+	pC->spool = NULL;
+	pC->spool_read = 0L;
+	pC->spool_len = 0;
+	pC->pSpool_head = NULL;
+	pC->pSpool_tail = NULL;
+
+	pC->curr_level.s_type = ST_none;
+	pC->curr_level.state = S_none;
+	pC->curr_level.indents_count = 0;
+	pC->curr_level.parens_count = 0;
+	pC->curr_level.pNext = NULL;
+	pC->level_stack = NULL;
+
+	/* Build the indentation now, and have a slab ready for the      */
+	/* Syntax_levels, rather than waiting for the first indented     */
+	/* line or nested statement, so that the steady state allocates  */
+	/* nothing.                                                      */
+
+	if( reserveSlab( sizeof( Syntax_level ) ) != OKAY )
+		return ERROR_FOUND;
+
+	return o_set_indent( output, pC->indent_string );
+}
+
+/************************************************************************
+ plsb_at_rest -- return TRUE if a Plsb_context is in the same state as
+ when plsb_init() left it: no indentation, nothing on the type stack,
+ no unindents pending, and no SQL statement in progress.  At such a
+ point, whatever follows may be beautified by a fresh context with the
+ same result.
  ***********************************************************************/
-int plsb_init( void )
+int plsb_at_rest( const Plsb_context * pC )
 {
-	pls_globals.indentation = 0;
-	pls_globals.indent_string = "    ";
-	pls_globals.soft_indent_string = "  ";
-	return OKAY;
+	ASSERT( pC != NULL );
+	if( NULL == pC )
+		return FALSE;
+
+	if( pC->indentation != 0            ||
+		pC->deferred_unindents != 0     ||
+		pC->type_top != -1              ||
+		pC->curr_level.s_type != ST_none ||
+		pC->curr_level.state != S_none  ||
+		pC->curr_level.indents_count != 0 ||
+		pC->curr_level.parens_count != 0  ||
+		pC->level_stack != NULL )
+		return FALSE;
+	else
+		return TRUE;
 }
@@ -1,6 +1,13 @@
-/* plsb01.c -- low-level routines for managing doubly-linked lists of
-   line elements.  Each element may represents a token and, optionally,
-   some spacing to be inserted in front of the token.
+/* plsb01.c -- low-level routines for managing lists of line elements.
+   Each element may represents a token and, optionally, some spacing to
+   be inserted in front of the token.
+
+   The elements of a list are Toknodes in a single growable array,
+   which is kept from one logical line to the next so that once it is
+   big enough, building a line allocates no memory.  The array has a
+   sentinel Toknode, with no token, at each end of the list.  Hence the
+   next or previous element is simply the adjacent Toknode, unless that
+   is a sentinel (see NEXT_NODE and PREV_NODE in plsb.h).
 
     Copyright (C) 1999  Scott McKellar  mck9@swbell.net
 
@@ -25,20 +32,20 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static Toknode * pFree;
+#define INITIAL_NODES 64	/* including the two sentinels */
 
-static Toknode * alloc_toknode( Pls_tok * pT );
-static void scavenge_toknodes( void * dummy );
+static int reserve_node( Toklist * pTL );
+static void init_toknode( Toknode * pTN, Pls_tok * pT );
+static void mark_ends( Toklist * pTL );
 
 /*********************************************************************
  extend_toklist -- append a Toknode to a Toklist.
  ********************************************************************/
 int extend_toklist( Toklist * pLL, Pls_tok * pT )
 {
-	Toknode * pTN;
-
 	/* sanity checks */
 
 	ASSERT( pLL != NULL );
@@ -46,26 +53,12 @@ int extend_toklist( Toklist * pLL, Pls_tok * pT )
 	if( NULL == pLL || NULL == pT )
 		return ERROR_FOUND;
 
-	pTN = alloc_toknode( pT );
-	if( NULL == pTN )
+	if( reserve_node( pLL ) != OKAY )
 		return ERROR_FOUND;
 
-	if( NULL == pLL->pLast )
-	{
-		/* list empty?  Direct both pointers to the new node */
-
-		pLL->pLast  = pTN;
-		pLL->pFirst = pTN;
-	}
-	else
-	{
-		/* list not empty -- juggle pointers, append to list */
-
-		ASSERT( NULL == pLL->pLast->pNext );
-		pLL->pLast->pNext = pTN;
-		pTN->pPrev = pLL->pLast;
-		pLL->pLast = pTN;
-	}
+	++pLL->count;
+	init_toknode( pLL->nodes + pLL->count, pT );
+	mark_ends( pLL );
 	return OKAY;
 }
 
@@ -75,33 +68,18 @@ int extend_toklist( Toklist * pLL, Pls_tok * pT )
  ********************************************************************/
 Pls_tok * truncate_toklist( Toklist * pTL )
 {
-	Toknode * pTN;
 	Pls_tok * pT;
 
 	ASSERT( pTL != NULL );
-	if( NULL == pTL || NULL == pTL->pLast )
+	if( NULL == pTL || 0 == pTL->count )
 		return NULL;
 
-	ASSERT( pTL->pFirst != NULL );
-	ASSERT( NULL == pTL->pLast->pNext );
-
-	/* detach the last Toknode from the list */
-
-	pTN = pTL->pLast;
-	pTL->pLast = pTN->pPrev;
-	if( pTL->pLast != NULL )
-		pTL->pLast->pNext = NULL;
-	pTN->pPrev = NULL;
-
-	/* detach the Pls_tok from the Toknode */
-
-	pT = pTN->pT;
-	pTN->pT = NULL;	/* not strictly necessary */
-
-	/* discard the Toknode by sticking it on the free list */
+	/* detach the Pls_tok from the Toknode, which */
+	/* becomes the sentinel at the end of the list */
 
-	pTN->pNext = pFree;
-	pFree = pTN;
+	pT = pTL->nodes[ pTL->count ].pT;
+	--pTL->count;
+	mark_ends( pTL );
 
 	return pT;
 }
@@ -109,183 +87,143 @@ Pls_tok * truncate_toklist( Toklist * pTL )
 /*********************************************************************
  init_toklist -- initialize a Toklist with a Toknode, or, if pT is
  NULL, make it empty.  We assume that the Toklist initially contains
- garbage.  If it contains pointers to  any Toknodes, we'll leak memory.
+ garbage.  If it owns an array of Toknodes, we'll leak memory; use
+ empty_toklist() instead to reuse a list.
  ********************************************************************/
 int init_toklist( Toklist * pTL, Pls_tok * pT )
 {
-	int rc = OKAY;
-	Toknode * pTN;
-
 	/* sanity checks */
 
 	ASSERT( pTL != NULL );
 	if( NULL == pTL )
 		return ERROR_FOUND;
 
+	pTL->nodes    = NULL;
+	pTL->count    = 0;
+	pTL->capacity = 0;
+	pTL->pFirst   = NULL;
+	pTL->pLast    = NULL;
+
 	if( NULL == pT )
-		pTN = NULL;
+		return OKAY;
 	else
-	{
-		pTN = alloc_toknode( pT );
-		if( NULL == pTN )
-			rc = ERROR_FOUND;
-	}
-
-	pTL->pFirst = pTL->pLast = pTN;
-
-	return rc;
+		return extend_toklist( pTL, pT );
 }
 
 /*********************************************************************
- empty_Toklist -- discards all the Toknodes in the list, leaving
- the list empty.
+ empty_Toklist -- discards all the Toknodes in the list, and the
+ tokens attached to them, leaving the list empty.  We keep the array
+ for the next logical line.
  ********************************************************************/
 void empty_toklist( Toklist * pTL )
 {
-	Toknode * pTN;
+	size_t i;
 
 	ASSERT( pTL != NULL );
 	if( NULL == pTL )
 		return;
 
-	if( NULL == pTL->pFirst )
+	if( 0 == pTL->count )
 	{
 		/* already empty? do nothing */
 
-		ASSERT( NULL == pTL->pLast );
+		ASSERT( NULL == pTL->pFirst && NULL == pTL->pLast );
 		return;
 	}
 
-	/* Make sure the list looks superficially healthy.  We don't */
-	/* trouble ourselves to make sure that the list is actually  */
-	/* intact, i.e. that the chain leads from the first to the   */
-	/* last, or that the backwards pointers are all valid.       */
+	/* Make sure the list looks superficially healthy */
 
-	ASSERT( pTL->pLast != NULL );
-	ASSERT( NULL == pTL->pLast->pNext );
-	ASSERT( NULL == pTL->pFirst->pPrev );
+	ASSERT( pTL->pFirst == pTL->nodes + 1 );
+	ASSERT( pTL->pLast  == pTL->nodes + pTL->count );
 
 	/* Free the token attached to each node */
 
-	for( pTN = pTL->pFirst; pTN != NULL; pTN = pTN->pNext )
-		pls_free_tok( &(pTN->pT) );
-
-	/* transfer all the Toknodes to the free list */
-	/* (where we only use the forwards pointers)  */
+	for( i = 1; i <= pTL->count; ++i )
+		pls_free_tok( &(pTL->nodes[ i ].pT) );
 
-	pTL->pLast->pNext = pFree;
-	pTL->pLast = NULL;
-	pFree = pTL->pFirst;
-	pTL->pFirst = NULL;
+	pTL->count = 0;
+	mark_ends( pTL );
 }
 
 /*********************************************************************
- alloc_toknode -- allocate and construct a Toknode; from the free
- list if possible, from the free store if necessary.
- *********************************************************************/
-static Toknode * alloc_toknode( Pls_tok * pT )
+ free_toklist -- discard all the Toknodes in the list, as with
+ empty_toklist(), and release the array as well.
+ ********************************************************************/
+void free_toklist( Toklist * pTL )
 {
-	Toknode * pTN;
+	ASSERT( pTL != NULL );
+	if( NULL == pTL )
+		return;
 
-	/* sanity check */
+	empty_toklist( pTL );
+	if( pTL->nodes != NULL )
+		freeMemory( pTL->nodes );
+	(void) init_toklist( pTL, NULL );
+}
 
-	ASSERT( pT != NULL );
-	if( NULL == pT )
-		return NULL;
+/*********************************************************************
+ reserve_node -- make sure the array has room for one more Toknode,
+ plus the sentinels, doubling the allocation as needed.  Any pointers
+ to Toknodes are invalid afterwards.
+ *********************************************************************/
+static int reserve_node( Toklist * pTL )
+{
+	size_t new_cap;
+	Toknode * pNew;
 
-	// FIXME: the memory manager is seg faulting.
-	// given the average size of PL/SQL code, it would be better
-	// to use a simple algorithm that isnt very memory efficient during
-	// processing, but cleans up after itself when the tokenised document
-	// is no longer needed.
-	pFree = NULL;
+	if( pTL->count + 3 <= pTL->capacity )
+		return OKAY;
 
-	/* allocate a Toknode */
+	new_cap = pTL->capacity ? pTL->capacity * 2 : INITIAL_NODES;
 
-	if( NULL == pFree )
-		pTN = allocMemory( sizeof( Toknode ) );
+	if( NULL == pTL->nodes )
+		pNew = allocMemory( new_cap * sizeof( Toknode ) );
 	else
-	{
-		static int first_time = TRUE;
-
-		if( TRUE == first_time )
-		{
-			registerMemoryPool( scavenge_toknodes, NULL );
-			first_time = FALSE;
-		}
-		pTN = pFree;
-		pFree = pFree->pNext;
-	}
-
-	/* initialize it */
+		pNew = resizeMemory( pTL->nodes, new_cap * sizeof( Toknode ) );
 
-	if( pTN != NULL )
-	{
-		pTN->pNext  = NULL;
-		pTN->pPrev  = NULL;
-		pTN->type   = pT->type;
-		pTN->spacer = 0;
-		pTN->lf     = FALSE;
-		pTN->indent_change = 0;
-		pTN->size   = pls_tok_size( pT );
-		pTN->pT     = pT;
-	}
+	if( NULL == pNew )
+		return ERROR_FOUND;
 
-	return pTN;
+	pTL->nodes = pNew;
+	pTL->capacity = new_cap;
+	return OKAY;
 }
 
-/**********************************************************************
- free_toknode -- deallocate a Toknode.  First we free the token, then
- we stick the Toknode on the free list.
+/*********************************************************************
+ init_toknode -- construct a Toknode for a token.
  *********************************************************************/
-void free_toknode( Toknode ** ppTN )
+static void init_toknode( Toknode * pTN, Pls_tok * pT )
 {
-	Toknode * pTN;
-
-	/* sanity checks */
-
-	ASSERT( ppTN != NULL );
-	if( NULL == ppTN )
-		return;
-
-	pTN = *ppTN;
-	*ppTN = NULL;
-
-	ASSERT( pTN != NULL );
-	if( NULL == pTN )
-		return;
-
-	/* deallocate the token, if any */
-
-	ASSERT( pTN->pT != NULL );
-	if( pTN->pT != NULL )
-		pls_free_tok( &(pTN->pT) );
-
-	/* stick the Toknode on the free list (we use */
-	/* only the forward pointer for this purpose) */
-
-	pTN->pNext = pFree;
-	pFree = pTN;
-	return;
+	pTN->type   = pT->type;
+	pTN->spacer = 0;
+	pTN->lf     = FALSE;
+	pTN->indent_change = 0;
+	pTN->size   = pls_tok_size( pT );
+	pTN->pT     = pT;
 }
 
-/***********************************************************************
- scavenge_toknodes -- return all the Toknodes on the free list to the
- free store.  We don't use the dummy parameter; it's only there so that
- we can install this function as a memory scavenger.
- **********************************************************************/
-static void scavenge_toknodes( void * dummy )
+/*********************************************************************
+ mark_ends -- after the list has grown or shrunk, install the
+ sentinels and point pFirst and pLast at the ends of the list.
+ *********************************************************************/
+static void mark_ends( Toklist * pTL )
 {
-	Toknode * pNext;
-	Toknode * pTN;
+	if( NULL == pTL->nodes )
+		return;		/* never used; nothing to mark */
 
-	pTN = pFree;
-	pFree = NULL;
+	pTL->nodes[ 0 ].pT = NULL;
+	pTL->nodes[ 0 ].type = T_none;
+	pTL->nodes[ pTL->count + 1 ].pT = NULL;
+	pTL->nodes[ pTL->count + 1 ].type = T_none;
 
-	while( pTN != NULL )
+	if( 0 == pTL->count )
+	{
+		pTL->pFirst = NULL;
+		pTL->pLast  = NULL;
+	}
+	else
 	{
-		pNext = pTN->pNext;
-		freeMemory( &pTN );
-		pTN = pNext;
+		pTL->pFirst = pTL->nodes + 1;
+		pTL->pLast  = pTL->nodes + pTL->count;
 	}
 }
@@ -23,37 +23,20 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static int initialized = FALSE;
-static int is_open = FALSE;
-static Sfile s;
+/* We read tokens through a Pls_lookahead, so that we can peek at */
+/* the next token without consuming it.  The need to destroy any  */
+/* tokens left over is what drives the open-read-close paradigm   */
+/* of this module.  The close gives us an opportunity to do so.   */
 
-/* We use the following as a pushback stack so that we can read  */
-/* a token, push it onto the stack, and then read it again by    */
-/* popping it back off.                                          */
+/* The Sfile and the Pls_lookahead live in the Plsb_context, so   */
+/* several input streams may be read concurrently, each through   */
+/* its own context. */
 
-/* The need to be able to deallocate anything left in this stack */
-/* is what drives the open-read-close paradigm of this module.   */
-/* The close gives us an opportunity to empty the stack.         */
-
-/* Note that we can't read multiple Sfiles concurrently.  In     */
-/* order to do that, the open would have to return some kind of  */
-/* handle to a dynamically allocated object for retaining the    */
-/* state of that input stream.  The client code would have to    */
-/* pass the handle back when it wanted to get a logical line, in */
-/* order to specify which input stream it wanted to get the line */
-/* from.  All this is doable but is not likely to be useful.     */
-
-static Toklist tokstack;
-
-/* macros implement the stack operations: */
-
-#define push_token(x) extend_toklist( &tokstack, (x) )
-#define pop_token()   truncate_toklist( &tokstack )
-
-static Pls_tok * next_token( void );
-static Pls_tok * look_ahead( void );
+static Pls_tok * next_token( Plsb_context * pC );
+static Pls_tok * look_ahead( Plsb_context * pC );
 static int begin_with_comment(
 	const Pls_tok * pPrev, const Pls_tok * pComment );
 static int sometimes_final( Pls_token_type type,
@@ -65,51 +48,50 @@ static int sometimes_first( Pls_token_type type,
  plsb_open -- prepare to read an Sfile to assemble logical lines.
  Make sure that we aren't already open.
  ********************************************************************/
-int plsb_open( Sfile sfile )
+int plsb_open( Plsb_context * pC, Sfile sfile )
 {
 	int rc = OKAY;
 
-	ASSERT( FALSE == is_open );
-	if( TRUE == is_open )
+	ASSERT( pC != NULL );
+	ASSERT( FALSE == pC->is_open );
+	if( NULL == pC || TRUE == pC->is_open )
 		return ERROR_FOUND;
 
-	/* On the first call, initialize the token stack. */
-
-	if( FALSE == initialized )
-		rc = init_toklist( &tokstack, NULL );
-
-	if( OKAY == rc )
-	{
-		/* Note that if we are open, we are also */
-		/* initialized; the reverse is not true. */
-
-		s = sfile;
-		initialized = TRUE;
-		is_open = TRUE;
-	}
+	pls_lookahead_init( &pC->ahead );
+	pC->s = sfile;
+	pC->is_open = TRUE;
 
 	return rc;
 }
 
 /*********************************************************************
- plsb_close -- shut down.  In particular, empty the token stack.  It
- is the client code's responsibility to close the Sfile.
+ plsb_close -- shut down.  In particular, destroy any tokens we have
+ read ahead, any syntax levels left on the stack, and the spool.  It
+ is the client code's responsibility to close the Sfile and the
+ Ofile.
  ********************************************************************/
-void plsb_close( void )
+void plsb_close( Plsb_context * pC )
 {
-	ASSERT( TRUE == is_open );
-	if( TRUE == is_open )
+	ASSERT( pC != NULL );
+	ASSERT( TRUE == pC->is_open );
+	if( pC != NULL && TRUE == pC->is_open )
 	{
-		empty_toklist( &tokstack );
-		is_open = FALSE;
+		pls_lookahead_free( &pC->ahead );
+		pC->is_open = FALSE;
+
+		while( pC->level_stack != NULL )
+			pop_level( pC );
+
+		plsb_spool_close( pC );
 	}
 }
 
 /*********************************************************************
  get_logical_line -- read tokens and assemble them into a Toklist
- representing a logical line.
+ representing a logical line.  The Toklist must have been initialized
+ by init_toklist(); we empty it first, keeping its array of Toknodes.
  ********************************************************************/
-int get_logical_line( Toklist * pTL )
+int get_logical_line( Plsb_context * pC, Toklist * pTL )
 {
 	int rc = OKAY;
 	Pls_token_type type;
@@ -117,10 +99,11 @@ int get_logical_line( Toklist * pTL )
 
 	/* sanity checks */
 
-	ASSERT( s.p != NULL );
+	ASSERT( pC != NULL );
+	ASSERT( pC->s.p != NULL );
 	ASSERT( pTL != NULL );
 
-	rc = init_toklist( pTL, NULL );
+	empty_toklist( pTL );
 
 	if( OKAY == rc )
 	{
@@ -130,7 +113,7 @@ int get_logical_line( Toklist * pTL )
 		{
 			Probability finality;
 
-			pT = next_token();
+			pT = next_token( pC );
 			if( NULL == pT )
 			{
 				rc = ERROR_FOUND;
@@ -154,7 +137,7 @@ int get_logical_line( Toklist * pTL )
 			{
 				Pls_tok * pNext_token;
 
-				pNext_token = look_ahead();
+				pNext_token = look_ahead( pC );
 				if( NULL == pNext_token )
 				{
 					finished = TRUE;
@@ -204,23 +187,15 @@ int get_logical_line( Toklist * pTL )
  next_token -- return a pointer to the next Pls_tok (ignoring white
  space).
  *********************************************************************/
-static Pls_tok * next_token( void )
+static Pls_tok * next_token( Plsb_context * pC )
 {
 	Pls_tok * pT;
 
-	/* First check the pushback stack.  This is a bit of a cheat; */
-	/* we break encapsulation by accessing the innards of the     */
-	/* Toklist directly.  It would be cleaner but less efficient  */
-	/* to pop the stack first, and read the sFile if we get NULL. */
-
 	/* Loop until we get NULL or something besides white space */
 
 	for( ;; )
 	{
-		if( NULL == tokstack.pLast )
-			pT = pls_next_tok( s );
-		else
-			pT = pop_token();
+		pT = pls_take_tok( &pC->ahead, pC->s );
 
 		if( NULL == pT )
 			break;
@@ -234,32 +209,39 @@ static Pls_tok * next_token( void )
 }
 
 /**********************************************************************
- look_ahead -- return a token to the next Pls_tok, but leave it on the
- pushback stack.   This function is the main reason for implementing
- the pushback stack in the first place.
+ look_ahead -- return a pointer to the next Pls_tok (ignoring white
+ space), but leave it in the lookahead buffer to be read again.
  *********************************************************************/
-static Pls_tok * look_ahead( void )
+static Pls_tok * look_ahead( Plsb_context * pC )
 {
 	Pls_tok * pT;
 
-	pT = next_token();
-	if( pT != NULL )
-		push_token( pT );
+	for( ;; )
+	{
+		pT = pls_peek_tok( &pC->ahead, pC->s, 0 );
+
+		if( NULL == pT || pT->type != T_whitespace )
+			break;
+
+		/* discard white space */
+
+		pT = pls_take_tok( &pC->ahead, pC->s );
+		pls_free_tok( &pT );
+	}
 
 	return pT;
 }
 
 /**********************************************************************
  begin_with_comment -- determine whether a comment starts on a different
- line from the previous token.
-
- Note: we don't yet give the right answer if the previous token spans
- multiple lines.
+ line from the previous token.  The previous token may span multiple
+ lines (a string literal, for example), so we compare the comment with
+ the line on which the previous token ends.
  *********************************************************************/
 static int begin_with_comment(
 	const Pls_tok * pPrev, const Pls_tok * pComment )
 {
-	if( pPrev->line == pComment->line )
+	if( pPrev->line + (int) pPrev->extra_lines == pComment->line )
 		return FALSE;
 	else
 		return TRUE;
@@ -23,33 +23,33 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static int deferred_unindents = 0;
+/* A literal or comment too big to keep in memory goes to a spool */
+/* file as it is read.  See the Spooled list in plsb.h. */
 
-/* The following is used to maintain a stack to keep track of  */
-/* which token types are at the beginning of each level of     */
-/* indent.  The main reason is so that we can un-indent twice  */
-/* between the end of a WHEN clause and a following END token. */
-
-#define TYPESTACK_DEPTH 32
-static Pls_token_type typestack[ TYPESTACK_DEPTH ];
-static int type_top = -1;
+#define STREAM_THRESHOLD 65536
 
 static int sometimes_indent( Pls_token_type first, Pls_token_type second );
-static void put_line( Toklist * pTL );
-static void write_indent( int i );
+static void put_line( Plsb_context * pC, Toklist * pTL );
+static void write_indent( Plsb_context * pC, int i );
+static void spool_text( void * p, Pls_stream_event event,
+	const Pls_tok * pT, const char * text, size_t len );
+static void put_spooled( Plsb_context * pC );
+static void emit_text( void * p, Pls_stream_event event,
+	const Pls_tok * pT, const char * text, size_t len );
 
-static Pls_token_type pop_type( void );
-static void push_type( Pls_token_type type );
+static Pls_token_type pop_type( Plsb_context * pC );
+static void push_type( Plsb_context * pC, Pls_token_type type );
 
 /*******************************************************************
  defer_unindent -- Note that at the beginning of the next logical
  line we should unindent a specified number of times.
  ******************************************************************/
-void defer_unindent( int how_many )
+void defer_unindent( Plsb_context * pC, int how_many )
 {
-	deferred_unindents = how_many;
+	pC->deferred_unindents = how_many;
 }
 
 /*******************************************************************
@@ -61,7 +61,7 @@ void defer_unindent( int how_many )
  2. Breaking the logical line into two or more physical lines in
 	order to avoid exceeding a maximum line length (not implemented)
  ********************************************************************/
-int write_logical_line( Toklist * pTL )
+int write_logical_line( Plsb_context * pC, Toklist * pTL )
 {
 	int rc = OKAY;
 	Probability if_indent;
@@ -72,8 +72,9 @@ int write_logical_line( Toklist * pTL )
 
 	/* sanity checks */
 
+	ASSERT( pC != NULL );
 	ASSERT( pTL != NULL );
-	if( NULL == pTL )
+	if( NULL == pC || NULL == pTL )
 		return ERROR_FOUND;
 
 	pTN = pTL->pFirst;
@@ -89,8 +90,8 @@ int write_logical_line( Toklist * pTL )
 
 	/* Determine where to put separator spaces */
 
-	for( pNext = pTN->pNext; pNext != NULL;
-		 pTN = pNext, pNext = pNext->pNext )
+	for( pNext = NEXT_NODE( pTN ); pNext != NULL;
+		 pTN = pNext, pNext = NEXT_NODE( pNext ) )
 	{
 		if( need_space( pTN->type, pNext->type ) == TRUE )
 			pNext->spacer = 1;
@@ -105,30 +106,31 @@ int write_logical_line( Toklist * pTL )
 	{
 		Pls_token_type indent_type;
 
-		if( pls_globals.indentation >= 0 )
-			--pls_globals.indentation;
-		indent_type = pop_type();
+		if( pC->indentation >= 0 )
+			--pC->indentation;
+		indent_type = pop_type( pC );
 		if( T_when == indent_type &&
 			T_end  == first_type  &&
-			pls_globals.indentation >= 0 )
-			--pls_globals.indentation;
+			pC->indentation >= 0 )
+			--pC->indentation;
 	}
 
 	/* Analyze the syntax; add additional   */
 	/* line feeds and indentation as needed */
 
-	rc = edit_syntax( pTL );
+	rc = edit_syntax( pC, pTL );
 
 	/* Write the tokens */
 
-	put_line( pTL );
+	put_line( pC, pTL );
 
 	/* Write a newline -- unless we just wrote a "--" - style */
-	/* comment, since that has its own newline. */
+	/* comment, since that has its own newline.  Go by the flag, */
+	/* because the text may have been spooled away by now.       */
 
 	if( last_type != T_remark ||
-		pTL->pLast->pT->buf[ 0 ] != '-' )
-		fputc( '\n', stdout );
+		! ( pTL->pLast->pT->flags & PLS_TF_HYPHEN ) )
+		o_putc( pC->output, '\n' );
 
 	/* Adjust indentation if necessary */
 
@@ -141,7 +143,7 @@ int write_logical_line( Toklist * pTL )
 		Toknode * pSecond;
 		Pls_token_type second_type;
 
-		pSecond = pTL->pFirst->pNext;
+		pSecond = NEXT_NODE( pTL->pFirst );
 		if( NULL == pSecond )
 			second_type = T_none;
 		else
@@ -153,16 +155,16 @@ int write_logical_line( Toklist * pTL )
 
 	if( P_always == if_indent )
 	{
-		++pls_globals.indentation;
-		push_type( first_type );
+		++pC->indentation;
+		push_type( pC, first_type );
 		if( T_exception == first_type )
-			++pls_globals.indentation;
+			++pC->indentation;
 	}
 
-	pls_globals.indentation -= deferred_unindents;
-	if( pls_globals.indentation < 0 )
-		pls_globals.indentation = 0;
-	deferred_unindents = 0;
+	pC->indentation -= pC->deferred_unindents;
+	if( pC->indentation < 0 )
+		pC->indentation = 0;
+	pC->deferred_unindents = 0;
 
 	return rc;
 }
@@ -191,69 +193,204 @@ static int sometimes_indent( Pls_token_type first, Pls_token_type second )
 /********************************************************************
  put_line -- write the indentation and the tokens
  *******************************************************************/
-static void put_line( Toklist * pTL )
+static void put_line( Plsb_context * pC, Toklist * pTL )
 {
 	Toknode * pTN;
 
 	/* Write each token, preceded by a white space as needed */
 
-	for( pTN = pTL->pFirst; pTN != NULL; pTN = pTN->pNext )
+	for( pTN = pTL->pFirst; pTN != NULL; pTN = NEXT_NODE( pTN ) )
 	{
 		/* Write a line feed if need be (except that if we are */
 		/* on the first token of the line, we have already     */
 		/* written one). */
 
 		if( pTN != pTL->pFirst && TRUE == pTN->lf )
-			fputc( '\n', stdout );
+			o_putc( pC->output, '\n' );
 
-		pls_globals.indentation += pTN->indent_change;
+		pC->indentation += pTN->indent_change;
 
 		/* Write any necessary indentation */
 
 		if( pTN == pTL->pFirst || TRUE == pTN->lf )
-			write_indent( pls_globals.indentation );
+			write_indent( pC, pC->indentation );
 		else
 			if( pTN->spacer > 0 )
-				fputc( ' ', stdout );
+				o_putc( pC->output, ' ' );
+
+		if( pTN->pT->flags & PLS_TF_STREAMED )
+			put_spooled( pC );
+		else
+			pls_emit_text( pTN->pT, emit_text, &pC->output );
+	}
+}
+
+/********************************************************************
+ emit_text -- stream sink: copy a segment of a token's text to the
+ Ofile pointed to by p.
+ *******************************************************************/
+static void emit_text( void * p, Pls_stream_event event,
+	const Pls_tok * pT, const char * text, size_t len )
+{
+	(void) pT;
+
+	if( PLS_STREAM_SEGMENT == event )
+		(void) o_write( *(Ofile *) p, text, len );
+}
+
+/********************************************************************
+ plsb_spool_open -- arrange for oversized literals and comments to
+ be spooled to a temporary file instead of being held in memory.  If
+ we can't open a temporary file, we just hold them in memory.
+ *******************************************************************/
+int plsb_spool_open( Plsb_context * pC )
+{
+	ASSERT( pC != NULL );
+	if( NULL == pC )
+		return ERROR_FOUND;
+
+	if( NULL == pC->spool )
+		pC->spool = tmpfile();
+
+	if( pC->spool != NULL )
+		(void) pls_stream( spool_text, pC, STREAM_THRESHOLD );
+
+	return OKAY;
+}
+
+/********************************************************************
+ plsb_spool_close -- stop spooling, and discard the spool file
+ together with any lengths we haven't used up.
+ *******************************************************************/
+void plsb_spool_close( Plsb_context * pC )
+{
+	Spooled * pS;
+
+	ASSERT( pC != NULL );
+	if( NULL == pC || NULL == pC->spool )
+		return;
+
+	(void) pls_stream( NULL, NULL, 0 );
 
-		pls_write_text( pTN->pT, stdout );
+	while( pC->pSpool_head != NULL )
+	{
+		pS = pC->pSpool_head;
+		pC->pSpool_head = pS->pNext;
+		freeMemory( pS );
+	}
+	pC->pSpool_tail = NULL;
+
+	fclose( pC->spool );
+	pC->spool = NULL;
+	pC->spool_read = 0L;
+}
+
+/********************************************************************
+ spool_text -- stream sink: append each segment to the spool file,
+ and at the end of the token remember how long it was.
+ *******************************************************************/
+static void spool_text( void * p, Pls_stream_event event,
+	const Pls_tok * pT, const char * text, size_t len )
+{
+	Plsb_context * pC;
+	Spooled * pS;
+
+	(void) pT;
+
+	pC = p;
+	if( PLS_STREAM_BEGIN == event )
+		pC->spool_len = 0;
+	else if( PLS_STREAM_SEGMENT == event )
+	{
+		fseek( pC->spool, 0L, SEEK_END );
+		fwrite( text, 1, len, pC->spool );
+		pC->spool_len += len;
+	}
+	else
+	{
+		pS = allocMemory( sizeof( Spooled ) );
+		if( NULL == pS )
+			return;
+
+		pS->pNext = NULL;
+		pS->len   = pC->spool_len;
+		if( NULL == pC->pSpool_tail )
+			pC->pSpool_head = pS;
+		else
+			pC->pSpool_tail->pNext = pS;
+		pC->pSpool_tail = pS;
 	}
 }
 
+/********************************************************************
+ put_spooled -- copy the text of the next spooled token from the
+ spool file to the output.
+ *******************************************************************/
+static void put_spooled( Plsb_context * pC )
+{
+	Spooled * pS;
+	unsigned long remaining;
+	char buf[ BUFSIZ ];
+
+	pS = pC->pSpool_head;
+	ASSERT( pS != NULL );
+	if( NULL == pS )
+		return;
+
+	pC->pSpool_head = pS->pNext;
+	if( NULL == pC->pSpool_head )
+		pC->pSpool_tail = NULL;
+
+	fseek( pC->spool, pC->spool_read, SEEK_SET );
+	for( remaining = pS->len; remaining > 0; )
+	{
+		size_t n;
+
+		n = remaining < sizeof buf ? (size_t) remaining : sizeof buf;
+		n = fread( buf, 1, n, pC->spool );
+		if( 0 == n )
+			break;
+		(void) o_write( pC->output, buf, n );
+		remaining -= n;
+	}
+
+	pC->spool_read += (long) pS->len;
+	freeMemory( pS );
+}
+
 /********************************************************************
  write_indent -- write the specified degree of indentation
  *******************************************************************/
-static void write_indent( int i )
+static void write_indent( Plsb_context * pC, int i )
 {
-	for( ; i > 0; --i )
-		fputs( pls_globals.indent_string, stdout );
+	(void) o_indent( pC->output, pC->indent_string, i );
 }
 
 /********************************************************************
  push_type -- push a type on the type stack.
  *******************************************************************/
-static void push_type( Pls_token_type type )
+static void push_type( Plsb_context * pC, Pls_token_type type )
 {
-	++type_top;
-	if( type_top < TYPESTACK_DEPTH )
-		typestack[ type_top ] = type;
+	++pC->type_top;
+	if( pC->type_top < TYPESTACK_DEPTH )
+		pC->typestack[ pC->type_top ] = type;
 }
 
 /*******************************************************************
  pop_type -- pop a type from the type_stack.
  ******************************************************************/
-static Pls_token_type pop_type( void )
+static Pls_token_type pop_type( Plsb_context * pC )
 {
 	Pls_token_type type;
 
-	if( type_top >= 0 )
+	if( pC->type_top >= 0 )
 	{
-		if( type_top < TYPESTACK_DEPTH )
-			type = typestack[ type_top ];
+		if( pC->type_top < TYPESTACK_DEPTH )
+			type = pC->typestack[ pC->type_top ];
 		else
 			type = T_none;
 
-		--type_top;
+		--pC->type_top;
 	}
 	else
 		type = T_none;
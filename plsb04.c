@@ -11,7 +11,8 @@
 
    In order to handle a subquery (a SELECT context which may be
    imbedded within some other kind of context) we maintain a stack
-   of nested levels (not yet implemented).
+   of nested levels (not yet implemented).  The current level and
+   the stack belong to the Plsb_context.
 
     Copyright (C) 1999  Scott McKellar  mck9@swbell.net
 
@@ -36,22 +37,9 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-Syntax_level curr_level =
-{
-	ST_none,
-	S_none,
-	0,
-	0,
-	NULL
-};
-
-static Syntax_level * level_stack = NULL;
-static Syntax_level * freelist    = NULL;
-
-static void scavenge_levels( void * dummy );
-
 /********************************************************************
  edit_syntax -- Examine the syntax (rather crudely) of the logical
  line and decide where to put additional line feeds and indentation.
@@ -62,7 +50,7 @@ static void scavenge_levels( void * dummy );
  approach used for the procedural code doesn't work very well,
  because there's no good way to tell when to unindent.
  *******************************************************************/
-int edit_syntax( Toklist * pTL )
+int edit_syntax( Plsb_context * pC, Toklist * pTL )
 {
 	int rc = OKAY;
 	Toknode * pTN;
@@ -83,33 +71,33 @@ int edit_syntax( Toklist * pTL )
 	/* Similar confusion could arise if, for example, a     */
 	/* package uses SELECT as a procedure or function name. */
 
-	if( S_none == curr_level.state )
+	if( S_none == pC->curr_level.state )
 	{
 		switch( pTL->pFirst->type )
 		{
 			case T_select :
-				rc = push_level();
-				curr_level.s_type = ST_select;
-				curr_level.state  = S_select;
+				rc = push_level( pC );
+				pC->curr_level.s_type = ST_select;
+				pC->curr_level.state  = S_select;
 				break;
 			case T_insert :
-				curr_level.s_type = ST_insert;
-				curr_level.state  = S_insert;
+				pC->curr_level.s_type = ST_insert;
+				pC->curr_level.state  = S_insert;
 				break;
 			case T_update :
-				curr_level.s_type = ST_update;
-				curr_level.state  = S_update;
+				pC->curr_level.s_type = ST_update;
+				pC->curr_level.state  = S_update;
 				break;
 			case T_delete :
-				curr_level.s_type = ST_delete;
+				pC->curr_level.s_type = ST_delete;
 				break;
 			case T_cursor :
-				curr_level.s_type = ST_cursor;
-				curr_level.state  = S_cursor;
+				pC->curr_level.s_type = ST_cursor;
+				pC->curr_level.state  = S_cursor;
 				break;
 			case T_fetch :
-				curr_level.s_type = ST_fetch;
-				curr_level.state  = S_fetch;
+				pC->curr_level.s_type = ST_fetch;
+				pC->curr_level.state  = S_fetch;
 				break;
 			default :
 				break;
@@ -122,28 +110,28 @@ int edit_syntax( Toklist * pTL )
 
 	if( OKAY == rc )
 	{
-		for( pTN = pTL->pFirst; pTN != NULL; pTN = pTN->pNext )
+		for( pTN = pTL->pFirst; pTN != NULL; pTN = NEXT_NODE( pTN ) )
 		{
-			switch( curr_level.s_type )
+			switch( pC->curr_level.s_type )
 			{
 			case ST_none :
 				break;
 			case ST_select :
-				rc = do_select_syntax( pTN );
+				rc = do_select_syntax( pC, pTN );
 				break;
 			case ST_insert :
-				rc = do_insert_syntax( pTN );
+				rc = do_insert_syntax( pC, pTN );
 				break;
 			case ST_update :
-				rc = do_update_syntax( pTN );
+				rc = do_update_syntax( pC, pTN );
 				break;
 			case ST_delete :
 				break;
 			case ST_cursor :
-				rc = do_cursor_syntax( pTN );
+				rc = do_cursor_syntax( pC, pTN );
 				break;
 			case ST_fetch :
-				rc = do_fetch_syntax( pTN );
+				rc = do_fetch_syntax( pC, pTN );
 				break;
 			default  :
 				break;		/* should be unreachable */
@@ -161,22 +149,22 @@ int edit_syntax( Toklist * pTL )
  outstanding indentation, issue a request to cancel it at the
  beginning of the next logical line.
  ******************************************************************/
-void exit_all_levels( void )
+void exit_all_levels( Plsb_context * pC )
 {
 	int total_indents;
 
-	total_indents = curr_level.indents_count;
-	while( level_stack != NULL )
+	total_indents = pC->curr_level.indents_count;
+	while( pC->level_stack != NULL )
 	{
-		pop_level();
-		total_indents += curr_level.indents_count;
+		pop_level( pC );
+		total_indents += pC->curr_level.indents_count;
 	}
 
-	curr_level.indents_count = 0;
-	curr_level.s_type = ST_none;
-	curr_level.state  = S_none;
+	pC->curr_level.indents_count = 0;
+	pC->curr_level.s_type = ST_none;
+	pC->curr_level.state  = S_none;
 
-	defer_unindent( total_indents );
+	defer_unindent( pC, total_indents );
 }
 
 /*******************************************************************
@@ -184,23 +172,22 @@ void exit_all_levels( void )
  curr_level.  Deallocate the popped level by sticking it on the
  free list.
  ******************************************************************/
-void pop_level( void )
+void pop_level( Plsb_context * pC )
 {
-	if( level_stack != NULL )
+	if( pC->level_stack != NULL )
 	{
 		Syntax_level * pOld;
 
 		/* Remove the level, copy it to curr_level */
 
-		pOld = level_stack;
-		level_stack = level_stack->pNext;
-		curr_level = *pOld;
-		curr_level.pNext = NULL;	/* a gesture for good hygiene */
+		pOld = pC->level_stack;
+		pC->level_stack = pC->level_stack->pNext;
+		pC->curr_level = *pOld;
+		pC->curr_level.pNext = NULL;	/* a gesture for good hygiene */
 
 		/* Deallocate it */
 
-		pOld->pNext = freelist;
-		freelist = pOld;
+		freeSlab( pOld );
 	}
 }
 /*******************************************************************
@@ -208,95 +195,56 @@ void pop_level( void )
  from curr_level); save it on the stack.  Return OKAY if successful
  or ERROR_FOUND if not.
  ******************************************************************/
-int push_level( void )
+int push_level( Plsb_context * pC )
 {
 	Syntax_level * new_level;
 
-	/* Allocate from the free_list if */
-	/* possible, else from the heap.  */
-
-	if( NULL == freelist )
-	{
-		static int first_time = TRUE;
-
-		new_level = allocMemory( sizeof( Syntax_level ) );
-		if( NULL == new_level )
-			return ERROR_FOUND;
-
-		if( TRUE == first_time )
-		{
-			/* First time? install a memory scavenger */
-
-			registerMemoryPool( scavenge_levels, NULL );
-			first_time = FALSE;
-		}
-	}
-	else
-	{
-		new_level = freelist;
-		freelist  = freelist->pNext;
-	}
-
-	ASSERT( new_level != NULL );
+	new_level = allocSlab( sizeof( Syntax_level ) );
+	if( NULL == new_level )
+		return ERROR_FOUND;
 
 	/* Push the level onto the stack */
 
-	*new_level = curr_level;
-	new_level->pNext = level_stack;
-	level_stack = new_level;
+	*new_level = pC->curr_level;
+	new_level->pNext = pC->level_stack;
+	pC->level_stack = new_level;
 
-	curr_level.parens_count = 0;
-	curr_level.indents_count = 0;
+	pC->curr_level.parens_count = 0;
+	pC->curr_level.indents_count = 0;
 
 	return OKAY;
 }
 
-/********************************************************************
- scavenge_levels -- a memory scavenger to clear out the free list.
- *******************************************************************/
-static void scavenge_levels( void * dummy )
-{
-	Syntax_level * pSL;
-	Syntax_level * pTemp;
-
-	for( pSL = freelist; pSL != NULL; )
-	{
-		pTemp = pSL->pNext;
-		freeMemory( pSL );
-		pSL = pTemp;
-	}
-}
-
 /********************************************************************
  add_indent -- annotate a token to begin a new level of indentation
  and change state.  This function, like the next one, is not a
  well-encapsulated abstraction, just a convenient gimmick for reducing
  the sheer bulk of the code.
  ********************************************************************/
-void add_indent( Toknode * pTN, S_state state )
+void add_indent( Plsb_context * pC, Toknode * pTN, S_state state )
 {
 	ASSERT( pTN != NULL );
 	if( pTN != NULL )
 	{
 		pTN->lf = TRUE;
 		pTN->indent_change = 1;
-		++curr_level.indents_count;
-		curr_level.state = state;
+		++pC->curr_level.indents_count;
+		pC->curr_level.state = state;
 	}
 }
 
 /*******************************************************************
  reduce_indent -- annotate a token to unindent and change state.
  ******************************************************************/
-void reduce_indent( Toknode * pTN, S_state state )
+void reduce_indent( Plsb_context * pC, Toknode * pTN, S_state state )
 {
 	ASSERT( pTN != NULL );
 	if( pTN != NULL )
 	{
 		pTN->lf = TRUE;
 		pTN->indent_change = -1;
-		--curr_level.indents_count;
-		curr_level.state = state;
+		--pC->curr_level.indents_count;
+		pC->curr_level.state = state;
 	}
 }
 
@@ -24,38 +24,39 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static void do_select( Toknode * pTN );
-static void do_select_list( Toknode * pTN );
-static void do_into( Toknode * pTN );
-static void do_into_list( Toknode * pTN );
-static int  do_from( Toknode * pTN );
-static int  do_from_list( Toknode * pTN );
-static void do_where( Toknode * pTN );
-static int  do_where_list( Toknode * pTN );
-static void do_start( Toknode * pTN );
-static int  do_start_clause( Toknode * pTN );
-static void do_connect( Toknode * pTN );
-static int  do_connect_clause( Toknode * pTN );
-static void do_group( Toknode * pTN );
-static void do_group_list( Toknode * pTN );
-static void do_having( Toknode * pTN );
-static int  do_having_list( Toknode * pTN );
-static void do_splice( Toknode * pTN );
-static void do_order( Toknode * pTN );
-static void do_order_list( Toknode * pTN );
-static void do_for( Toknode * pTN );
-static void do_for_update( Toknode * pTN );
-static void do_of( Toknode * pTN );
-static void do_of_list( Toknode * pTN );
-static void do_nowait( Toknode * pTN );
+static void do_select( Plsb_context * pC, Toknode * pTN );
+static void do_select_list( Plsb_context * pC, Toknode * pTN );
+static void do_into( Plsb_context * pC, Toknode * pTN );
+static void do_into_list( Plsb_context * pC, Toknode * pTN );
+static int  do_from( Plsb_context * pC, Toknode * pTN );
+static int  do_from_list( Plsb_context * pC, Toknode * pTN );
+static void do_where( Plsb_context * pC, Toknode * pTN );
+static int  do_where_list( Plsb_context * pC, Toknode * pTN );
+static void do_start( Plsb_context * pC, Toknode * pTN );
+static int  do_start_clause( Plsb_context * pC, Toknode * pTN );
+static void do_connect( Plsb_context * pC, Toknode * pTN );
+static int  do_connect_clause( Plsb_context * pC, Toknode * pTN );
+static void do_group( Plsb_context * pC, Toknode * pTN );
+static void do_group_list( Plsb_context * pC, Toknode * pTN );
+static void do_having( Plsb_context * pC, Toknode * pTN );
+static int  do_having_list( Plsb_context * pC, Toknode * pTN );
+static void do_splice( Plsb_context * pC, Toknode * pTN );
+static void do_order( Plsb_context * pC, Toknode * pTN );
+static void do_order_list( Plsb_context * pC, Toknode * pTN );
+static void do_for( Plsb_context * pC, Toknode * pTN );
+static void do_for_update( Plsb_context * pC, Toknode * pTN );
+static void do_of( Plsb_context * pC, Toknode * pTN );
+static void do_of_list( Plsb_context * pC, Toknode * pTN );
+static void do_nowait( Plsb_context * pC, Toknode * pTN );
 
 /*******************************************************************
  do_select_syntax -- traverse the logical line, parsing as you go,
  using a finite state machine.
  ******************************************************************/
-int do_select_syntax( Toknode * pTN )
+int do_select_syntax( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
@@ -63,83 +64,83 @@ int do_select_syntax( Toknode * pTN )
 	{
 		/* Found a semicolon -- the SQL statement is finished. */
 
-		exit_all_levels();
+		exit_all_levels( pC );
 	}
-	else switch( curr_level.state )
+	else switch( pC->curr_level.state )
 	{
 		case S_select :
-			do_select( pTN );
+			do_select( pC, pTN );
 			break;
 		case S_select_list :
-			do_select_list( pTN );
+			do_select_list( pC, pTN );
 			break;
 		case S_into :
-			do_into( pTN );
+			do_into( pC, pTN );
 			break;
 		case S_into_list :
-			do_into_list( pTN );
+			do_into_list( pC, pTN );
 			break;
 		case S_from :
-			rc = do_from( pTN );
+			rc = do_from( pC, pTN );
 			break;
 		case S_from_list :
-			rc = do_from_list( pTN );
+			rc = do_from_list( pC, pTN );
 			break;
 		case S_where :
-			do_where( pTN );
+			do_where( pC, pTN );
 			break;
 		case S_where_list :
-			rc = do_where_list( pTN );
+			rc = do_where_list( pC, pTN );
 			break;
 		case S_start :
-			do_start( pTN );
+			do_start( pC, pTN );
 			break;
 		case S_start_clause :
-			rc = do_start_clause( pTN );
+			rc = do_start_clause( pC, pTN );
 			break;
 		case S_connect :
-			do_connect( pTN );
+			do_connect( pC, pTN );
 			break;
 		case S_connect_clause :
-			rc = do_connect_clause( pTN );
+			rc = do_connect_clause( pC, pTN );
 			break;
 		case S_group :
-			do_group( pTN );
+			do_group( pC, pTN );
 			break;
 		case S_group_list :
-			do_group_list( pTN );
+			do_group_list( pC, pTN );
 			break;
 		case S_having :
-			do_having( pTN );
+			do_having( pC, pTN );
 			break;
 		case S_having_list :
-			rc = do_having_list( pTN );
+			rc = do_having_list( pC, pTN );
 			break;
 		case S_union :
 		case S_intersect :
 		case S_minus :
-			do_splice( pTN );
+			do_splice( pC, pTN );
 			break;
 		case S_order :
-			do_order( pTN );
+			do_order( pC, pTN );
 			break;
 		case S_order_list :
-			do_order_list( pTN );
+			do_order_list( pC, pTN );
 			break;
 		case S_for :
-			do_for( pTN );
+			do_for( pC, pTN );
 			break;
 		case S_for_update :
-			do_for_update( pTN );
+			do_for_update( pC, pTN );
 			break;
 		case S_of :
-			do_of( pTN );
+			do_of( pC, pTN );
 			break;
 		case S_of_list :
-			do_of_list( pTN );
+			do_of_list( pC, pTN );
 			break;
 		case S_nowait :
-			do_nowait( pTN );
+			do_nowait( pC, pTN );
 			break;
 		default :
 			break;
@@ -152,7 +153,7 @@ int do_select_syntax( Toknode * pTN )
  do_select -- We have just found a SELECT.  Stay in this state until
  we find the first token other than DISTINCT, ALL, or a comment.
  ******************************************************************/
-static void do_select( Toknode * pTN )
+static void do_select( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
@@ -162,11 +163,11 @@ static void do_select( Toknode * pTN )
 		case T_all :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_select_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_select_list );
 			break;
 		default :
-			add_indent( pTN, S_select_list );
+			add_indent( pC, pTN, S_select_list );
 			break;
 	}
 }
@@ -175,21 +176,21 @@ static void do_select( Toknode * pTN )
  do_select_list -- We are amid the list of SELECTed items.  Stay in
  this state until we find INTO or FROM.
  ******************************************************************/
-static void do_select_list( Toknode * pTN )
+static void do_select_list( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_into :
-			reduce_indent( pTN, S_into );
+			reduce_indent( pC, pTN, S_into );
 			break;
 		case T_from :
-			reduce_indent( pTN, S_from );
+			reduce_indent( pC, pTN, S_from );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_comma :
 			/* We want each selected item on a separate line, so */
@@ -197,11 +198,11 @@ static void do_select_list( Toknode * pTN )
 			/* (provided it isn't a comment).  We are careful to */
 			/* ignore a comma within parentheses. */
 
-			if( 0 == curr_level.parens_count )
+			if( 0 == pC->curr_level.parens_count )
 			{
 				Toknode * pNext_node;
 
-				pNext_node = pTN->pNext;
+				pNext_node = NEXT_NODE( pTN );
 				if( pNext_node != NULL &&
 					pNext_node->type != T_remark )
 					pNext_node->lf = TRUE;
@@ -218,13 +219,13 @@ static void do_select_list( Toknode * pTN )
  comments that may appear between INTO and the first identifier; no
  other tokens may legally appear here.)
  ******************************************************************/
-static void do_into( Toknode * pTN )
+static void do_into( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_identifier :
 		case T_quoted_id :
-			add_indent( pTN, S_into_list );
+			add_indent( pC, pTN, S_into_list );
 			break;
 		default :
 			break;
@@ -235,12 +236,12 @@ static void do_into( Toknode * pTN )
  do_into_list -- We are amid the list of INTO targets.  Stay in
  this state until we find FROM.
  ******************************************************************/
-static void do_into_list( Toknode * pTN )
+static void do_into_list( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_from :
-			reduce_indent( pTN, S_from );
+			reduce_indent( pC, pTN, S_from );
 			break;
 		case T_comma :
 		{
@@ -250,7 +251,7 @@ static void do_into_list( Toknode * pTN )
 
 			Toknode * pNext_node;
 
-			pNext_node = pTN->pNext;
+			pNext_node = NEXT_NODE( pTN );
 			if( pNext_node != NULL &&
 				pNext_node->type != T_remark )
 				pNext_node->lf = TRUE;
@@ -265,7 +266,7 @@ static void do_into_list( Toknode * pTN )
  do_from -- We just found a FROM.  Stay in this state until we find
  the beginning of a table name.
  ******************************************************************/
-static int do_from( Toknode * pTN )
+static int do_from( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
@@ -273,24 +274,24 @@ static int do_from( Toknode * pTN )
 	{
 		case T_identifier :
 		case T_quoted_id :
-			add_indent( pTN, S_from_list );
+			add_indent( pC, pTN, S_from_list );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
-				add_indent( pTN, S_select );
+				add_indent( pC, pTN, S_select );
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -304,55 +305,55 @@ static int do_from( Toknode * pTN )
  of WHERE, START, CONNECT, UNION, INTERSECT, MINUS, GROUP, ORDER, FOR,
  or SELECT.
  ******************************************************************/
-static int do_from_list( Toknode * pTN )
+static int do_from_list( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_where :
-			reduce_indent( pTN, S_where );
+			reduce_indent( pC, pTN, S_where );
 			break;
 		case T_start :
-			reduce_indent( pTN, S_start );
+			reduce_indent( pC, pTN, S_start );
 			break;
 		case T_connect :
-			reduce_indent( pTN, S_connect );
+			reduce_indent( pC, pTN, S_connect );
 			break;
 		case T_union :
-			reduce_indent( pTN, S_union );
+			reduce_indent( pC, pTN, S_union );
 			break;
 		case T_intersect :
-			reduce_indent( pTN, S_intersect );
+			reduce_indent( pC, pTN, S_intersect );
 			break;
 		case T_minus :
-			reduce_indent( pTN, S_minus );
+			reduce_indent( pC, pTN, S_minus );
 			break;
 		case T_group :
-			reduce_indent( pTN, S_group );
+			reduce_indent( pC, pTN, S_group );
 			break;
 		case T_order :
-			reduce_indent( pTN, S_order );
+			reduce_indent( pC, pTN, S_order );
 			break;
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
-				add_indent( pTN, S_select );
+				add_indent( pC, pTN, S_select );
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_comma :
 			/* We want each table on a separate line, so we add */
@@ -360,11 +361,11 @@ static int do_from_list( Toknode * pTN )
 			/* isn't a comment).  We are careful to ignore a    */
 			/* comma within parentheses. */
 
-			if( 0 == curr_level.parens_count )
+			if( 0 == pC->curr_level.parens_count )
 			{
 				Toknode * pNext_node;
 
-				pNext_node = pTN->pNext;
+				pNext_node = NEXT_NODE( pTN );
 				if( pNext_node != NULL &&
 					pNext_node->type != T_remark )
 					pNext_node->lf = TRUE;
@@ -380,18 +381,18 @@ static int do_from_list( Toknode * pTN )
  do_where -- We just found a WHERE.  Stay in this state until we find
  something other than a comment.
  ******************************************************************/
-static void do_where( Toknode * pTN )
+static void do_where( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_where_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_where_list );
 			break;
 		default :
-			add_indent( pTN, S_where_list );
+			add_indent( pC, pTN, S_where_list );
 			break;
 	}
 }
@@ -401,52 +402,52 @@ static void do_where( Toknode * pTN )
  state until we find a semicolon (detected elsewhere), START,
  CONNECT, UNION, INTERSECT, MINUS, GROUP, ORDER, FOR, or SELECT.
  ******************************************************************/
-static int do_where_list( Toknode * pTN )
+static int do_where_list( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_start :
-			reduce_indent( pTN, S_start );
+			reduce_indent( pC, pTN, S_start );
 			break;
 		case T_connect :
-			reduce_indent( pTN, S_connect );
+			reduce_indent( pC, pTN, S_connect );
 			break;
 		case T_union :
-			reduce_indent( pTN, S_union );
+			reduce_indent( pC, pTN, S_union );
 			break;
 		case T_intersect :
-			reduce_indent( pTN, S_intersect );
+			reduce_indent( pC, pTN, S_intersect );
 			break;
 		case T_minus :
-			reduce_indent( pTN, S_minus );
+			reduce_indent( pC, pTN, S_minus );
 			break;
 		case T_group :
-			reduce_indent( pTN, S_group );
+			reduce_indent( pC, pTN, S_group );
 			break;
 		case T_order :
-			reduce_indent( pTN, S_order );
+			reduce_indent( pC, pTN, S_order );
 			break;
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
-				add_indent( pTN, S_select );
+				add_indent( pC, pTN, S_select );
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -458,7 +459,7 @@ static int do_where_list( Toknode * pTN )
  do_start -- We just found a START.  Stay in this state until we find
  something other than WITH or a comment.
  ******************************************************************/
-static void do_start( Toknode * pTN )
+static void do_start( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
@@ -466,10 +467,10 @@ static void do_start( Toknode * pTN )
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_start_clause );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_start_clause );
 		default :
-			add_indent( pTN, S_start_clause );
+			add_indent( pC, pTN, S_start_clause );
 			break;
 	}
 }
@@ -478,25 +479,25 @@ static void do_start( Toknode * pTN )
  do_start_clause -- We are amid a START condition.  Stay in this
  state until we find a semicolon (detected elsewhere) or CONNECT.
  ******************************************************************/
-static int do_start_clause( Toknode * pTN )
+static int do_start_clause( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_connect :
-			reduce_indent( pTN, S_connect );
+			reduce_indent( pC, pTN, S_connect );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
-				add_indent( pTN, S_select );
+				add_indent( pC, pTN, S_select );
 			break;
 		default :
 			break;
@@ -508,7 +509,7 @@ static int do_start_clause( Toknode * pTN )
  do_connect -- We just found a CONNECT.  Stay in this state until we
  find something other than BY or a comment.
  ******************************************************************/
-static void do_connect( Toknode * pTN )
+static void do_connect( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
@@ -516,10 +517,10 @@ static void do_connect( Toknode * pTN )
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_connect_clause );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_connect_clause );
 		default :
-			add_indent( pTN, S_connect_clause );
+			add_indent( pC, pTN, S_connect_clause );
 			break;
 	}
 }
@@ -529,52 +530,52 @@ static void do_connect( Toknode * pTN )
  this state until we find a semicolon (detected elsewhere), START,
  CONNECT, UNION, INTERSECT, MINUS, GROUP, ORDER, FOR, or SELECT.
  ******************************************************************/
-static int do_connect_clause( Toknode * pTN )
+static int do_connect_clause( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_start :
-			reduce_indent( pTN, S_start );
+			reduce_indent( pC, pTN, S_start );
 			break;
 		case T_connect :
-			reduce_indent( pTN, S_connect );
+			reduce_indent( pC, pTN, S_connect );
 			break;
 		case T_union :
-			reduce_indent( pTN, S_union );
+			reduce_indent( pC, pTN, S_union );
 			break;
 		case T_intersect :
-			reduce_indent( pTN, S_intersect );
+			reduce_indent( pC, pTN, S_intersect );
 			break;
 		case T_minus :
-			reduce_indent( pTN, S_minus );
+			reduce_indent( pC, pTN, S_minus );
 			break;
 		case T_group :
-			reduce_indent( pTN, S_group );
+			reduce_indent( pC, pTN, S_group );
 			break;
 		case T_order :
-			reduce_indent( pTN, S_order );
+			reduce_indent( pC, pTN, S_order );
 			break;
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
-				add_indent( pTN, S_select );
+				add_indent( pC, pTN, S_select );
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -586,7 +587,7 @@ static int do_connect_clause( Toknode * pTN )
  do_group -- We just found a GROUP.  Stay in this state until we
  find something other than BY or a comment.
  ******************************************************************/
-static void do_group( Toknode * pTN )
+static void do_group( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
@@ -594,10 +595,10 @@ static void do_group( Toknode * pTN )
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_group_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_group_list );
 		default :
-			add_indent( pTN, S_group_list );
+			add_indent( pC, pTN, S_group_list );
 			break;
 	}
 }
@@ -607,42 +608,42 @@ static void do_group( Toknode * pTN )
  state until we find a semicolon (detected elsewhere), START, CONNECT,
  UNION, INTERSECT, MINUS, GROUP, ORDER, FOR, or SELECT.
  ******************************************************************/
-static void do_group_list( Toknode * pTN )
+static void do_group_list( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_having :
-			reduce_indent( pTN, S_having );
+			reduce_indent( pC, pTN, S_having );
 			break;
 		case T_start :
-			reduce_indent( pTN, S_start );
+			reduce_indent( pC, pTN, S_start );
 			break;
 		case T_connect :
-			reduce_indent( pTN, S_connect );
+			reduce_indent( pC, pTN, S_connect );
 			break;
 		case T_union :
-			reduce_indent( pTN, S_union );
+			reduce_indent( pC, pTN, S_union );
 			break;
 		case T_intersect :
-			reduce_indent( pTN, S_intersect );
+			reduce_indent( pC, pTN, S_intersect );
 			break;
 		case T_minus :
-			reduce_indent( pTN, S_minus );
+			reduce_indent( pC, pTN, S_minus );
 			break;
 		case T_group :
-			reduce_indent( pTN, S_group );
+			reduce_indent( pC, pTN, S_group );
 			break;
 		case T_order :
-			reduce_indent( pTN, S_order );
+			reduce_indent( pC, pTN, S_order );
 			break;
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_comma :
 			/* We want each expression on a separate line, */
@@ -650,11 +651,11 @@ static void do_group_list( Toknode * pTN )
 			/* (provided it isn't a comment).  We ignore a */
 			/* comma within parentheses. */
 
-			if( 0 == curr_level.parens_count )
+			if( 0 == pC->curr_level.parens_count )
 			{
 				Toknode * pNext_node;
 
-				pNext_node = pTN->pNext;
+				pNext_node = NEXT_NODE( pTN );
 				if( pNext_node != NULL &&
 					pNext_node->type != T_remark )
 					pNext_node->lf = TRUE;
@@ -669,17 +670,17 @@ static void do_group_list( Toknode * pTN )
  do_having -- We just found a HAVING.  Stay in this state until we
  find something other than a comment.
  ******************************************************************/
-static void do_having( Toknode * pTN )
+static void do_having( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_having_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_having_list );
 		default :
-			add_indent( pTN, S_having_list );
+			add_indent( pC, pTN, S_having_list );
 			break;
 	}
 }
@@ -689,52 +690,52 @@ static void do_having( Toknode * pTN )
  state until we find a semicolon (detected elsewhere), START, CONNECT,
  UNION, INTERSECT, MINUS, GROUP, ORDER, FOR, or SELECT.
  ******************************************************************/
-static int do_having_list( Toknode * pTN )
+static int do_having_list( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_start :
-			reduce_indent( pTN, S_start );
+			reduce_indent( pC, pTN, S_start );
 			break;
 		case T_connect :
-			reduce_indent( pTN, S_connect );
+			reduce_indent( pC, pTN, S_connect );
 			break;
 		case T_union :
-			reduce_indent( pTN, S_union );
+			reduce_indent( pC, pTN, S_union );
 			break;
 		case T_intersect :
-			reduce_indent( pTN, S_intersect );
+			reduce_indent( pC, pTN, S_intersect );
 			break;
 		case T_minus :
-			reduce_indent( pTN, S_minus );
+			reduce_indent( pC, pTN, S_minus );
 			break;
 		case T_group :
-			reduce_indent( pTN, S_group );
+			reduce_indent( pC, pTN, S_group );
 			break;
 		case T_order :
-			reduce_indent( pTN, S_order );
+			reduce_indent( pC, pTN, S_order );
 			break;
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
-				add_indent( pTN, S_select );
+				add_indent( pC, pTN, S_select );
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -747,13 +748,13 @@ static int do_having_list( Toknode * pTN )
  the previous SELECT statement to another one.  We treat all of
  them the same.  Stay in this state until we find a SELECT.
  ******************************************************************/
-static void do_splice( Toknode * pTN )
+static void do_splice( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_select :
 			pTN->lf = TRUE;
-			curr_level.state = S_select;
+			pC->curr_level.state = S_select;
 			break;
 		default :
 			break;
@@ -764,7 +765,7 @@ static void do_splice( Toknode * pTN )
  do_order -- We just found an ORDER.  Stay in this state until we
  find something other than BY or a comment.
  ******************************************************************/
-static void do_order( Toknode * pTN )
+static void do_order( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
@@ -772,10 +773,10 @@ static void do_order( Toknode * pTN )
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_order_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_order_list );
 		default :
-			add_indent( pTN, S_order_list );
+			add_indent( pC, pTN, S_order_list );
 			break;
 	}
 }
@@ -784,24 +785,24 @@ static void do_order( Toknode * pTN )
  do_order_list -- We are amid the list of sort keys.  Stay in this
  state until we find a semicolon (detected elsewhere) or FOR.
  ******************************************************************/
-static void do_order_list( Toknode * pTN )
+static void do_order_list( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_comma :
 		{
@@ -811,7 +812,7 @@ static void do_order_list( Toknode * pTN )
 
 			Toknode * pNext_node;
 
-			pNext_node = pTN->pNext;
+			pNext_node = NEXT_NODE( pTN );
 			if( pNext_node != NULL &&
 				pNext_node->type != T_remark )
 				pNext_node->lf = TRUE;
@@ -826,12 +827,12 @@ static void do_order_list( Toknode * pTN )
  do_for -- We just found an ORDER.  Stay in this state until we
  find UPDATE.
  ******************************************************************/
-static void do_for( Toknode * pTN )
+static void do_for( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_update :
-			curr_level.state = S_for_update;
+			pC->curr_level.state = S_for_update;
 		default :
 			break;
 	}
@@ -841,30 +842,30 @@ static void do_for( Toknode * pTN )
  do_for_update -- We just found FOR UPDATE.  Stay in this state until
  we find OF, NOWAIT, ORDER, or FOR.
  ******************************************************************/
-static void do_for_update( Toknode * pTN )
+static void do_for_update( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_of:
-			curr_level.state = S_of;
+			pC->curr_level.state = S_of;
 			break;
 		case T_nowait :
-			reduce_indent( pTN, S_nowait );
+			reduce_indent( pC, pTN, S_nowait );
 			break;
 		case T_order :
-			reduce_indent( pTN, S_order );
+			reduce_indent( pC, pTN, S_order );
 			break;
 		case T_for :
-			reduce_indent( pTN, S_for );
+			reduce_indent( pC, pTN, S_for );
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -876,14 +877,14 @@ static void do_for_update( Toknode * pTN )
  state until we find something besides a comment.  (It should be
  an identifier or quoted identier, but we don't check for it.)
  ******************************************************************/
-static void do_of( Toknode * pTN )
+static void do_of( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_comment :
 			break;
 		default :
-			add_indent( pTN, S_of_list );
+			add_indent( pC, pTN, S_of_list );
 			break;
 	}
 }
@@ -893,27 +894,27 @@ static void do_of( Toknode * pTN )
  clause.  Stay in this state until we find a semicolon (detected
  elsewhere) or any of NOWAIT, ORDER, or FOR.
  ******************************************************************/
-static void do_of_list( Toknode * pTN )
+static void do_of_list( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_order :
 			pTN->lf = TRUE;
 			pTN->indent_change = -2;
-			curr_level.indents_count -= 2;
-			curr_level.state = S_order;
+			pC->curr_level.indents_count -= 2;
+			pC->curr_level.state = S_order;
 			break;
 		case T_for :
 			pTN->lf = TRUE;
 			pTN->indent_change = -2;
-			curr_level.indents_count -= 2;
-			curr_level.state = S_for;
+			pC->curr_level.indents_count -= 2;
+			pC->curr_level.state = S_for;
 			break;
 		case T_nowait :
 			pTN->lf = TRUE;
 			pTN->indent_change = -2;
-			curr_level.indents_count -= 2;
-			curr_level.state = S_nowait;
+			pC->curr_level.indents_count -= 2;
+			pC->curr_level.state = S_nowait;
 			break;
 		case T_comma :
 		{
@@ -923,20 +924,20 @@ static void do_of_list( Toknode * pTN )
 
 			Toknode * pNext_node;
 
-			pNext_node = pTN->pNext;
+			pNext_node = NEXT_NODE( pTN );
 			if( pNext_node != NULL &&
 				pNext_node->type != T_remark )
 				pNext_node->lf = TRUE;
 			break;
 		}
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -947,24 +948,24 @@ static void do_of_list( Toknode * pTN )
  do_nowait -- We just found a NOWAIT.  Stay in this state until we
  find a semicolon (detected elsewhere), ORDER, or FOR.
  ******************************************************************/
-static void do_nowait( Toknode * pTN )
+static void do_nowait( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_order :
-			curr_level.state = S_order;
+			pC->curr_level.state = S_order;
 			break;
 		case T_for :
-			curr_level.state = S_for;
+			pC->curr_level.state = S_for;
 			break;
 		case T_rparens :
-			if( curr_level.parens_count <= 0 )
+			if( pC->curr_level.parens_count <= 0 )
 			{
 				pTN->lf = TRUE;
-				pTN->indent_change = - curr_level.indents_count;
-				pop_level();
+				pTN->indent_change = - pC->curr_level.indents_count;
+				pop_level( pC );
 			}
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
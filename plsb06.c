@@ -24,24 +24,25 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static void do_insert( Toknode * pTN );
-static int  do_into( Toknode * pTN );
-static int  do_subquery( Toknode * pTN );
-static int  do_into_list( Toknode * pTN );
-static void do_column_list_a( Toknode * pTN );
-static void do_column_list_b( Toknode * pTN );
-static int  do_column_list_c( Toknode * pTN );
-static void do_values( Toknode * pTN );
-static void do_values_list_a( Toknode * pTN );
-static void do_values_list_b( Toknode * pTN );
+static void do_insert( Plsb_context * pC, Toknode * pTN );
+static int  do_into( Plsb_context * pC, Toknode * pTN );
+static int  do_subquery( Plsb_context * pC, Toknode * pTN );
+static int  do_into_list( Plsb_context * pC, Toknode * pTN );
+static void do_column_list_a( Plsb_context * pC, Toknode * pTN );
+static void do_column_list_b( Plsb_context * pC, Toknode * pTN );
+static int  do_column_list_c( Plsb_context * pC, Toknode * pTN );
+static void do_values( Plsb_context * pC, Toknode * pTN );
+static void do_values_list_a( Plsb_context * pC, Toknode * pTN );
+static void do_values_list_b( Plsb_context * pC, Toknode * pTN );
 
 /*******************************************************************
  do_insert_syntax -- traverse the logical line, parsing as you go,
  using a finite state machine.
  ******************************************************************/
-int do_insert_syntax( Toknode * pTN )
+int do_insert_syntax( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
@@ -49,39 +50,39 @@ int do_insert_syntax( Toknode * pTN )
 	{
 		/* Found a semicolon -- the SQL statement is finished. */
 
-		exit_all_levels();
+		exit_all_levels( pC );
 	}
-	else switch( curr_level.state )
+	else switch( pC->curr_level.state )
 	{
 		case S_insert :
-			do_insert( pTN );
+			do_insert( pC, pTN );
 			break;
 		case S_into :
-			rc = do_into( pTN );
+			rc = do_into( pC, pTN );
 			break;
 		case S_into_list :
-			rc = do_into_list( pTN );
+			rc = do_into_list( pC, pTN );
 			break;
 		case S_subquery :
-			rc = do_subquery( pTN );
+			rc = do_subquery( pC, pTN );
 			break;
 		case S_column_list_a :
-			do_column_list_a( pTN );
+			do_column_list_a( pC, pTN );
 			break;
 		case S_column_list_b :
-			do_column_list_b( pTN );
+			do_column_list_b( pC, pTN );
 			break;
 		case S_column_list_c :
-			rc = do_column_list_c( pTN );
+			rc = do_column_list_c( pC, pTN );
 			break;
 		case S_values :
-			do_values( pTN );
+			do_values( pC, pTN );
 			break;
 		case S_values_list_a :
-			do_values_list_a( pTN );
+			do_values_list_a( pC, pTN );
 			break;
 		case S_values_list_b :
-			do_values_list_b( pTN );
+			do_values_list_b( pC, pTN );
 			break;
 		default :
 			/* The default case includes S_values_list_c, which  */
@@ -99,12 +100,12 @@ int do_insert_syntax( Toknode * pTN )
 /*******************************************************************
  do_insert -- We have just found INSERT.  Look for INTO.
  ******************************************************************/
-static void do_insert( Toknode * pTN )
+static void do_insert( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_into :
-			curr_level.state = S_into;
+			pC->curr_level.state = S_into;
 			break;
 		default :
 			break;
@@ -116,23 +117,23 @@ static void do_insert( Toknode * pTN )
  an identifier (starting a table or view name) or a left parens
  (starting a subquery).
  ******************************************************************/
-static int do_into( Toknode * pTN )
+static int do_into( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_identifier :
-			curr_level.state = S_into_list;
+			pC->curr_level.state = S_into_list;
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_subquery );
-			rc = push_level();
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_subquery );
+			rc = push_level( pC );
 			if( OKAY == rc )
 			{
-				curr_level.s_type = ST_select;
-				curr_level.state  = S_select;
+				pC->curr_level.s_type = ST_select;
+				pC->curr_level.state  = S_select;
 				pTN->lf = TRUE;
 			}
 			break;
@@ -146,25 +147,25 @@ static int do_into( Toknode * pTN )
  do_subquery -- We just finished a subquery after INSERT INTO.  Look
  for VALUES, a column list, or SELECT (starting another subquery).
  ******************************************************************/
-static int do_subquery( Toknode * pTN )
+static int do_subquery( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_values :
-			reduce_indent( pTN, S_values );
+			reduce_indent( pC, pTN, S_values );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			reduce_indent( pTN, S_column_list_a );
+			++pC->curr_level.parens_count;
+			reduce_indent( pC, pTN, S_column_list_a );
 			break;
 		case T_select :
-			rc  = push_level();
+			rc  = push_level( pC );
 			if( OKAY == rc )
 			{
-				curr_level.s_type = ST_select;
-				curr_level.state  = S_select;
+				pC->curr_level.s_type = ST_select;
+				pC->curr_level.state  = S_select;
 			}
 			break;
 		default :
@@ -178,26 +179,26 @@ static int do_subquery( Toknode * pTN )
  inserting.  Look for a left parenthesis (signifying the beginning
  of a column list), VALUES, or SELECT (signifying a subquery).
  ******************************************************************/
-static int do_into_list( Toknode * pTN )
+static int do_into_list( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_values :
-			curr_level.state = S_values;
+			pC->curr_level.state = S_values;
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			curr_level.state = S_column_list_a;
+			++pC->curr_level.parens_count;
+			pC->curr_level.state = S_column_list_a;
 			pTN->lf = TRUE;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
 			{
-				curr_level.s_type = ST_select;
-				add_indent( pTN, S_select );
+				pC->curr_level.s_type = ST_select;
+				add_indent( pC, pTN, S_select );
 			}
 			break;
 		default :
@@ -210,19 +211,19 @@ static int do_into_list( Toknode * pTN )
  do_column_list_a -- We just started a list of columns into which we
  are inserting.  Look for the first column name.
  ******************************************************************/
-static void do_column_list_a( Toknode * pTN )
+static void do_column_list_a( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_identifier :
-			add_indent( pTN, S_column_list_b );
+			add_indent( pC, pTN, S_column_list_b );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			if( curr_level.parens_count > 0 )
-				--curr_level.parens_count;
+			if( pC->curr_level.parens_count > 0 )
+				--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
@@ -233,19 +234,19 @@ static void do_column_list_a( Toknode * pTN )
  do_column_list_b -- We are amid the list of columns into which we
  are inserting.  Look for a closing right parenthesis.
  ******************************************************************/
-static void do_column_list_b( Toknode * pTN )
+static void do_column_list_b( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			if( curr_level.parens_count > 0 )
+			if( pC->curr_level.parens_count > 0 )
 			{
-				--curr_level.parens_count;
-				if( curr_level.parens_count < 1 )
-					reduce_indent( pTN, S_column_list_c );
+				--pC->curr_level.parens_count;
+				if( pC->curr_level.parens_count < 1 )
+					reduce_indent( pC, pTN, S_column_list_c );
 			}
 			break;
 		case T_comma :
@@ -254,11 +255,11 @@ static void do_column_list_b( Toknode * pTN )
 			/* isn't a comment).  We are careful to ignore a     */
 			/* comma within nested parentheses. */
 
-			if( 1 == curr_level.parens_count )
+			if( 1 == pC->curr_level.parens_count )
 			{
 				Toknode * pNext_node;
 
-				pNext_node = pTN->pNext;
+				pNext_node = NEXT_NODE( pTN );
 				if( pNext_node != NULL &&
 					pNext_node->type != T_remark )
 					pNext_node->lf = TRUE;
@@ -273,21 +274,21 @@ static void do_column_list_b( Toknode * pTN )
  do_column_list_c -- We just finished a list of columns into which we
  are inserting.  Look for VALUES or SELECT.
  ******************************************************************/
-static int do_column_list_c( Toknode * pTN )
+static int do_column_list_c( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_values :
-			curr_level.state = S_values;
+			pC->curr_level.state = S_values;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
 			{
-				curr_level.s_type = ST_select;
-				add_indent( pTN, S_select );
+				pC->curr_level.s_type = ST_select;
+				add_indent( pC, pTN, S_select );
 			}
 			break;
 		default :
@@ -300,13 +301,13 @@ static int do_column_list_c( Toknode * pTN )
  do_values -- We just found VALUES.  Look for the parenthesis which
  starts the list of values.
  ******************************************************************/
-static void do_values( Toknode * pTN )
+static void do_values( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_lparens :
-			++curr_level.parens_count;
-			curr_level.state = S_values_list_a;
+			++pC->curr_level.parens_count;
+			pC->curr_level.state = S_values_list_a;
 			pTN->lf = TRUE;
 			break;
 		default :
@@ -319,26 +320,26 @@ static void do_values( Toknode * pTN )
  list of values.  Look for the first expression in the values list
  (i.e. just about anything but a comment).
  ******************************************************************/
-static void do_values_list_a( Toknode * pTN )
+static void do_values_list_a( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_values_list_b );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_values_list_b );
 			break;
 		case T_rparens :	/* shouldn't happen */
-			if( curr_level.parens_count > 0 )
+			if( pC->curr_level.parens_count > 0 )
 			{
-				--curr_level.parens_count;
-				if( curr_level.parens_count < 1 )
-					reduce_indent( pTN, S_values_list_c );
+				--pC->curr_level.parens_count;
+				if( pC->curr_level.parens_count < 1 )
+					reduce_indent( pC, pTN, S_values_list_c );
 			}
 			break;
 		default :
-			add_indent( pTN, S_values_list_b );
+			add_indent( pC, pTN, S_values_list_b );
 			break;
 	}
 }
@@ -347,19 +348,19 @@ static void do_values_list_a( Toknode * pTN )
  do_values_list_b -- We are amid the list of values to be inserted.
  Look for the closing right parenthesis.
   ******************************************************************/
-static void do_values_list_b( Toknode * pTN )
+static void do_values_list_b( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_rparens :
-			if( curr_level.parens_count > 0 )
+			if( pC->curr_level.parens_count > 0 )
 			{
-				--curr_level.parens_count;
-				if( curr_level.parens_count < 1 )
-					reduce_indent( pTN, S_values_list_c );
+				--pC->curr_level.parens_count;
+				if( pC->curr_level.parens_count < 1 )
+					reduce_indent( pC, pTN, S_values_list_c );
 			}
 			break;
 		case T_comma :
@@ -368,11 +369,11 @@ static void do_values_list_b( Toknode * pTN )
 			/* it isn't a comment).  We are careful to ignore a  */
 			/* comma within nested parentheses. */
 
-			if( 1 == curr_level.parens_count )
+			if( 1 == pC->curr_level.parens_count )
 			{
 				Toknode * pNext_node;
 
-				pNext_node = pTN->pNext;
+				pNext_node = NEXT_NODE( pTN );
 				if( pNext_node != NULL &&
 					pNext_node->type != T_remark )
 					pNext_node->lf = TRUE;
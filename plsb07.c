@@ -24,22 +24,23 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-static int  do_update( Toknode * pTN );
-static void do_subquery( Toknode * pTN );
-static int  do_set( Toknode * pTN );
-static int  do_set_list( Toknode * pTN );
-static int  do_set_subquery( Toknode * pTN );
-static int  do_set_comma( Toknode * pTN );
-static void do_where( Toknode * pTN );
-static int  do_where_list( Toknode * pTN );
+static int  do_update( Plsb_context * pC, Toknode * pTN );
+static void do_subquery( Plsb_context * pC, Toknode * pTN );
+static int  do_set( Plsb_context * pC, Toknode * pTN );
+static int  do_set_list( Plsb_context * pC, Toknode * pTN );
+static int  do_set_subquery( Plsb_context * pC, Toknode * pTN );
+static int  do_set_comma( Plsb_context * pC, Toknode * pTN );
+static void do_where( Plsb_context * pC, Toknode * pTN );
+static int  do_where_list( Plsb_context * pC, Toknode * pTN );
 
 /*******************************************************************
  do_update_syntax -- traverse the logical line, parsing as you go,
  using a finite state machine.
  ******************************************************************/
-int do_update_syntax( Toknode * pTN )
+int do_update_syntax( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
@@ -47,33 +48,33 @@ int do_update_syntax( Toknode * pTN )
 	{
 		/* Found a semicolon -- the SQL statement is finished. */
 
-		exit_all_levels();
+		exit_all_levels( pC );
 	}
-	else switch( curr_level.state )
+	else switch( pC->curr_level.state )
 	{
 		case S_update :
-			rc = do_update( pTN );
+			rc = do_update( pC, pTN );
 			break;
 		case S_subquery :
-			do_subquery( pTN );
+			do_subquery( pC, pTN );
 			break;
 		case S_set :
-			rc = do_set( pTN );
+			rc = do_set( pC, pTN );
 			break;
 		case S_set_list :
-			rc = do_set_list( pTN );
+			rc = do_set_list( pC, pTN );
 			break;
 		case S_set_subquery :
-			rc = do_set_subquery( pTN );
+			rc = do_set_subquery( pC, pTN );
 			break;
 		case S_set_comma :
-			rc = do_set_comma( pTN );
+			rc = do_set_comma( pC, pTN );
 			break;
 		case S_where :
-			do_where( pTN );
+			do_where( pC, pTN );
 			break;
 		case S_where_list :
-			rc = do_where_list( pTN );
+			rc = do_where_list( pC, pTN );
 			break;
 		default :
 			break;
@@ -86,7 +87,7 @@ int do_update_syntax( Toknode * pTN )
  do_update -- We have just found UPDATE.  Look for a left parens
  (signifying the beginning of a subquery) or SET.
  ******************************************************************/
-static int do_update( Toknode * pTN )
+static int do_update( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
@@ -94,16 +95,16 @@ static int do_update( Toknode * pTN )
 	{
 		case T_set :
 			pTN->lf = TRUE;
-			curr_level.state = S_set;
+			pC->curr_level.state = S_set;
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_subquery );
-			rc = push_level();
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_subquery );
+			rc = push_level( pC );
 			if( OKAY == rc )
 			{
-				curr_level.s_type = ST_select;
-				curr_level.state  = S_select;
+				pC->curr_level.s_type = ST_select;
+				pC->curr_level.state  = S_select;
 			}
 			break;
 		default :
@@ -116,24 +117,29 @@ static int do_update( Toknode * pTN )
  do_subquery -- We just finished a subquery after UPDATE.  Look for
  SET.
  ******************************************************************/
-static void do_subquery( Toknode * pTN )
+static void do_subquery( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_set :
-			reduce_indent( pTN, S_set );
+			reduce_indent( pC, pTN, S_set );
 			break;
 		case T_rparens :
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_comma :
-			if( 0 == curr_level.parens_count &&
-				pTN->pNext != NULL &&
-				pTN->pNext->type != T_remark )
-				pTN->pNext->lf = TRUE;
+			if( 0 == pC->curr_level.parens_count )
+			{
+				Toknode * pNext_node;
+
+				pNext_node = NEXT_NODE( pTN );
+				if( pNext_node != NULL &&
+					pNext_node->type != T_remark )
+					pNext_node->lf = TRUE;
+			}
 			break;
 		default :
 			break;
@@ -145,18 +151,18 @@ static void do_subquery( Toknode * pTN )
  than a comment) should be a left parenthesis or an identifier.
  Put in on the next line with an indent.
  ******************************************************************/
-static int do_set( Toknode * pTN )
+static int do_set( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_identifier :
-			add_indent( pTN, S_set_list );
+			add_indent( pC, pTN, S_set_list );
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_set_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_set_list );
 			break;
 		default :
 			break;
@@ -167,34 +173,39 @@ static int do_set( Toknode * pTN )
 /*******************************************************************
  do_set_list -- We are amid the assignments in a SET clause.
  ******************************************************************/
-static int do_set_list( Toknode * pTN )
+static int do_set_list( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_where :
-			reduce_indent( pTN, S_where );
+			reduce_indent( pC, pTN, S_where );
 			break;
 		case T_rparens :
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_comma :
-			if( 0 == curr_level.parens_count &&
-				pTN->pNext != NULL &&
-				pTN->pNext->type != T_remark )
-				pTN->pNext->lf = TRUE;
+			if( 0 == pC->curr_level.parens_count )
+			{
+				Toknode * pNext_node;
+
+				pNext_node = NEXT_NODE( pTN );
+				if( pNext_node != NULL &&
+					pNext_node->type != T_remark )
+					pNext_node->lf = TRUE;
+			}
 			break;
 		case T_select :
-			add_indent( pTN, S_set_subquery );
-			rc = push_level();
+			add_indent( pC, pTN, S_set_subquery );
+			rc = push_level( pC );
 			if( OKAY == rc )
 			{
-				curr_level.s_type = ST_select;
-				curr_level.state  = S_select;
+				pC->curr_level.s_type = ST_select;
+				pC->curr_level.state  = S_select;
 			}
 			break;
 		default :
@@ -208,24 +219,29 @@ static int do_set_list( Toknode * pTN )
  for WHERE or a comma.  Nothing else is valid SQL here (except a
  comment).
  ******************************************************************/
-static int do_set_subquery( Toknode * pTN )
+static int do_set_subquery( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_where :
-			reduce_indent( pTN, S_where );
-			if( curr_level.indents_count > 0 )
-				--curr_level.indents_count;
+			reduce_indent( pC, pTN, S_where );
+			if( pC->curr_level.indents_count > 0 )
+				--pC->curr_level.indents_count;
 			pTN->indent_change = -2;
 			break;
 		case T_comma :
-			if( pTN->pNext != NULL &&
-				pTN->pNext->type != T_remark )
-				pTN->pNext->lf = TRUE;
-			curr_level.state = S_set_comma;
+		{
+			Toknode * pNext_node;
+
+			pNext_node = NEXT_NODE( pTN );
+			if( pNext_node != NULL &&
+				pNext_node->type != T_remark )
+				pNext_node->lf = TRUE;
+			pC->curr_level.state = S_set_comma;
 			break;
+		}
 		default :
 			break;
 	}
@@ -237,18 +253,18 @@ static int do_set_subquery( Toknode * pTN )
  clause.  All we should find (other than a comment) is an
  identifier or a left parens (signifying a list of columns).
  ******************************************************************/
-static int do_set_comma( Toknode * pTN )
+static int do_set_comma( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_lparens :
-			++curr_level.parens_count;
-			reduce_indent( pTN, S_set_list );
+			++pC->curr_level.parens_count;
+			reduce_indent( pC, pTN, S_set_list );
 			break;
 		case T_identifier :
-			reduce_indent( pTN, S_set_list );
+			reduce_indent( pC, pTN, S_set_list );
 			break;
 		default :
 			break;
@@ -260,18 +276,18 @@ static int do_set_comma( Toknode * pTN )
  do_where -- We just found a WHERE.  Stay in this state until we find
  something other than a comment.
  ******************************************************************/
-static void do_where( Toknode * pTN )
+static void do_where( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_remark :
 			break;
 		case T_lparens :
-			++curr_level.parens_count;
-			add_indent( pTN, S_where_list );
+			++pC->curr_level.parens_count;
+			add_indent( pC, pTN, S_where_list );
 			break;
 		default :
-			add_indent( pTN, S_where_list );
+			add_indent( pC, pTN, S_where_list );
 			break;
 	}
 }
@@ -280,26 +296,26 @@ static void do_where( Toknode * pTN )
  do_where_list -- We are amid the WHERE condition.  Stay in this
  state until we find a semicolon (detected elsewhere) or SELECT.
  ******************************************************************/
-static int do_where_list( Toknode * pTN )
+static int do_where_list( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	switch( pTN->type )
 	{
 		case T_lparens :
-			++curr_level.parens_count;
+			++pC->curr_level.parens_count;
 			break;
 		case T_select :
-			rc = push_level();
+			rc = push_level( pC );
 			if( OKAY == rc )
 			{
-				add_indent( pTN, S_where_list );
-				curr_level.s_type = ST_select;
-				curr_level.state  = S_select;
+				add_indent( pC, pTN, S_where_list );
+				pC->curr_level.s_type = ST_select;
+				pC->curr_level.state  = S_select;
 			}
 			break;
 		case T_rparens :
-			--curr_level.parens_count;
+			--pC->curr_level.parens_count;
 			break;
 		default :
 			break;
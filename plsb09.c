@@ -24,34 +24,35 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
 #include "plsb.h"
 
-void do_fetch( Toknode * pTN );
-static void do_into( Toknode * pTN );
+void do_fetch( Plsb_context * pC, Toknode * pTN );
+static void do_into( Plsb_context * pC, Toknode * pTN );
 static void do_into_list( Toknode * pTN );
 
 /*******************************************************************
  do_cursor_syntax -- look for SELECT, then switch to the machine for
  indenting SELECT statements.
  ******************************************************************/
-int do_cursor_syntax( Toknode * pTN )
+int do_cursor_syntax( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
 	if( T_select == pTN->type )
 	{
-		rc = push_level();
+		rc = push_level( pC );
 		if( OKAY == rc )
 		{
-			curr_level.s_type = ST_select;
-			add_indent( pTN, S_select );
+			pC->curr_level.s_type = ST_select;
+			add_indent( pC, pTN, S_select );
 		}
 	}
 	else if( T_semicolon == pTN->type )
 	{
 		/* Found a semicolon -- the CURSOR statement is finished. */
 
-		exit_all_levels();
+		exit_all_levels( pC );
 	}
 
 	return rc;
@@ -61,7 +62,7 @@ int do_cursor_syntax( Toknode * pTN )
  do_fetch_syntax -- traverse the logical line, parsing as you go,
  using a finite state machine.
  ******************************************************************/
-int do_fetch_syntax( Toknode * pTN )
+int do_fetch_syntax( Plsb_context * pC, Toknode * pTN )
 {
 	int rc = OKAY;
 
@@ -69,15 +70,15 @@ int do_fetch_syntax( Toknode * pTN )
 	{
 		/* Found a semicolon -- the SQL statement is finished. */
 
-		exit_all_levels();
+		exit_all_levels( pC );
 	}
-	else switch( curr_level.state )
+	else switch( pC->curr_level.state )
 	{
 		case S_fetch :
-			do_fetch( pTN );
+			do_fetch( pC, pTN );
 			break;
 		case S_into :
-			do_into( pTN );
+			do_into( pC, pTN );
 			break;
 		case S_into_list :
 			do_into_list( pTN );
@@ -92,12 +93,12 @@ int do_fetch_syntax( Toknode * pTN )
 /*******************************************************************
  do_fetch -- We have just found FETCH.  Look for INTO.
  ******************************************************************/
-void do_fetch( Toknode * pTN )
+void do_fetch( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_into :
-			curr_level.state = S_into;
+			pC->curr_level.state = S_into;
 			break;
 		default :
 			break;
@@ -108,12 +109,12 @@ void do_fetch( Toknode * pTN )
  do_into -- We have just found an INTO after FETCH.  Look for
  an identifier.
  ******************************************************************/
-static void do_into( Toknode * pTN )
+static void do_into( Plsb_context * pC, Toknode * pTN )
 {
 	switch( pTN->type )
 	{
 		case T_identifier :
-			add_indent( pTN, S_into_list );
+			add_indent( pC, pTN, S_into_list );
 			break;
 		default :
 			break;
@@ -136,7 +137,7 @@ static void do_into_list( Toknode * pTN )
 
 			Toknode * pNext_node;
 
-			pNext_node = pTN->pNext;
+			pNext_node = NEXT_NODE( pTN );
 			if( pNext_node != NULL &&
 				pNext_node->type != T_remark )
 				pNext_node->lf = TRUE;
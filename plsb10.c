@@ -0,0 +1,164 @@
+/* plsb10.c -- routines for beautifying a whole input stream, and for
+   beautifying a buffer in memory without any files at all.  The latter
+   serves as the entry point for a program which links plsb as a
+   library instead of running it as a separate process.
+
+   Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+   This program is open software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "ofile.h"
+#include "plsb.h"
+
+/********************************************************************
+ plsb_beautify -- main loop for fetching and writing successive
+ logical lines, until the end of the input.  The context must have
+ been initialized by plsb_init() and opened by plsb_open().
+ *******************************************************************/
+int plsb_beautify( Plsb_context * pC )
+{
+	int rc = OKAY;
+	int finished = FALSE;
+	int warm = FALSE;
+	Toklist list;
+
+	ASSERT( pC != NULL );
+	if( NULL == pC )
+		return ERROR_FOUND;
+
+	(void) init_toklist( &list, NULL );
+
+	while( FALSE == finished )
+	{
+		rc = get_logical_line( pC, &list );
+
+		if( rc != OKAY )
+			finished = TRUE;
+		else
+		{
+			rc = write_logical_line( pC, &list );
+			if( OKAY != rc || T_eof == list.pLast->type )
+				finished = TRUE;
+		}
+
+		empty_toklist( &list );
+
+		/* Having recycled one logical line, we shouldn't need */
+		/* the heap again, except for longer or deeper ones.   */
+
+		if( ! warm )
+		{
+			if( pC->on_warm != NULL )
+				pC->on_warm();
+			warm = TRUE;
+		}
+	}
+
+	free_toklist( &list );
+
+	return rc;
+}
+
+/********************************************************************
+ plsb_default_options -- fill a Plsb_options with the settings that
+ plsb itself uses.
+ *******************************************************************/
+void plsb_default_options( Plsb_options * pOpt )
+{
+	ASSERT( pOpt != NULL );
+	if( NULL == pOpt )
+		return;
+
+	pOpt->indent_string = "    ";
+	pOpt->spool = FALSE;
+}
+
+/********************************************************************
+ plsb_format -- beautify len bytes of PL/SQL source code in memory,
+ appending the result to an Ofile.  Typically the Ofile was opened
+ by o_memory(), so that the client code can fetch the result with
+ o_contents(); the client code remains responsible for closing it.
+
+ A NULL pOpt means the default options.  The input need not be
+ nul-terminated, and we don't modify it.  If some of the input can't
+ be beautified, what was written before the problem stays in the
+ Ofile, but we return ERROR_FOUND.
+ *******************************************************************/
+int plsb_format( const char * in, size_t len, const Plsb_options * pOpt,
+	Ofile out )
+{
+	return plsb_format_piece( in, len, pOpt, out, NULL );
+}
+
+/********************************************************************
+ plsb_format_piece -- the same as plsb_format(), except that we also
+ report, through pAt_rest (if not NULL), whether the beautifier came
+ to rest at the end of the input (see plsb_at_rest()).  If so, the
+ text following this piece may be beautified separately.
+ *******************************************************************/
+int plsb_format_piece( const char * in, size_t len,
+	const Plsb_options * pOpt, Ofile out, int * pAt_rest )
+{
+	int rc;
+	Sfile s;
+	Plsb_context ctx;
+
+	if( pAt_rest != NULL )
+		*pAt_rest = FALSE;
+
+	ASSERT( in != NULL || 0 == len );
+	ASSERT( out.p != NULL );
+	if( ( NULL == in && len > 0 ) || NULL == out.p )
+		return ERROR_FOUND;
+
+	s = s_memory( NULL == in ? "" : in, len );
+	if( NULL == s.p )
+		return ERROR_FOUND;
+
+	rc = plsb_init( &ctx, out );
+	if( OKAY == rc && pOpt != NULL && pOpt->indent_string != NULL )
+	{
+		ctx.indent_string = pOpt->indent_string;
+		rc = o_set_indent( ctx.output, ctx.indent_string );
+	}
+
+	if( OKAY == rc )
+		rc = plsb_open( &ctx, s );
+
+	if( OKAY == rc )
+	{
+		if( pOpt != NULL && pOpt->spool )
+			rc = plsb_spool_open( &ctx );
+		if( OKAY == rc )
+			rc = plsb_beautify( &ctx );
+		if( OKAY == rc && pAt_rest != NULL )
+			*pAt_rest = plsb_at_rest( &ctx );
+		plsb_close( &ctx );
+	}
+
+	s_close( &s );
+
+	if( OKAY == rc && o_error( out ) )
+		rc = ERROR_FOUND;
+
+	return rc;
+}
@@ -0,0 +1,780 @@
+/* plsb11.c -- routines for beautifying many files at once, such as all
+   the source files in a directory tree.
+
+   We first gather the names and sizes of all the files, and sort them
+   from largest to smallest.  Then a number of workers take files from
+   the front of the list until none remain, each beautifying its own
+   file in memory through plsb_format_units().  Starting with the largest
+   files keeps a single big file from starting last and leaving the
+   other workers idle at the end.  The workers are POSIX threads if we
+   are compiled with PLS_THREADS #defined; otherwise there is only one
+   worker, and --jobs makes no difference.  When there are more
+   workers than files, each file is beautified a unit at a time, with
+   the spare workers beautifying other units of it (see plsb12.c).
+
+   Each result goes to a temporary file in the same directory as its
+   destination, which is then renamed over the destination, so that a
+   reader never sees a partly written file and a failure never destroys
+   the original.
+
+   In check mode we write nothing, but only list the files which are
+   not formatted already.  Either way, a file which the cache of fixed
+   points (see plsb15.c) knows to be formatted is not beautified again.
+
+   Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+   This program is open software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "ofile.h"
+#include "plsb.h"
+
+#define MAX_JOBS     256
+#define INITIAL_WORK 64
+
+/* One file to be beautified */
+
+typedef struct
+{
+	char * in_name;
+	char * out_name;	/* same as in_name if rewriting in place */
+	off_t size;
+	mode_t mode;
+} Work;
+
+/* The list of files, and the workers' shared position in it */
+
+typedef struct
+{
+	Work * items;
+	size_t count;
+	size_t capacity;
+	size_t next;		/* the next item to be taken */
+	int failures;
+	int unit_jobs;		/* how many units of one file at a time */
+	int check;			/* boolean: only check, don't write */
+	const Plsb_options * pOpt;
+} Batch;
+
+static Mutex batch_lock = MUTEX_INITIALIZER;	/* guards next and failures */
+
+static const char * suffixes[] =
+{
+	".sql", ".pls", ".plb", ".pks", ".pkb", ".pck", ".prc", ".fnc",
+	".trg", ".typ", ".tps", ".tpb", NULL
+};
+
+static int run_batch( int jobs, const char * out_dir,
+	const Plsb_options * pOpt, int check, int count, char * paths[] );
+static int add_path( Batch * pB, const char * path, const char * out_path,
+	int named );
+static int add_dir( Batch * pB, const char * path, const char * out_path );
+static int add_work( Batch * pB, const char * path, const char * out_path,
+	const struct stat * pStat );
+static int is_source_name( const char * name );
+static char * join_path( const char * dir, const char * name );
+static const char * base_name( const char * path );
+static int make_dirs( const char * path );
+static int find_collision( Batch * pB );
+static int by_out_name( const void * p1, const void * p2 );
+static int larger_first( const void * p1, const void * p2 );
+static void * worker( void * p );
+static int format_file( const Work * pW, const Batch * pB );
+static int replace_file( const char * name, mode_t mode,
+	const char * text, size_t len );
+static void free_batch( Batch * pB );
+
+/********************************************************************
+ plsb_batch -- beautify each of count files or directories named in
+ paths[], using as many as jobs workers at once.  Within a directory
+ we take every file with a familiar suffix for PL/SQL source code,
+ and descend into every subdirectory, but don't follow symbolic links.
+
+ If out_dir is NULL, we rewrite each file in place (leaving it alone
+ if it is already formatted).  Otherwise out_dir receives a mirror
+ image of the input: the formatted version of each file named in
+ paths[] goes directly into out_dir, and the contents of each
+ directory named in paths[] go into out_dir, with the same structure
+ of subdirectories.  If two inputs would go to the same place (such
+ as two files with the same name in different directories), we do
+ no beautifying at all.
+
+ A NULL pOpt means the default options; spooling is not allowed.
+ Return OKAY if every file was beautified, or ERROR_FOUND otherwise.
+ *******************************************************************/
+int plsb_batch( int jobs, const char * out_dir, const Plsb_options * pOpt,
+	int count, char * paths[] )
+{
+	return run_batch( jobs, out_dir, pOpt, FALSE, count, paths );
+}
+
+/********************************************************************
+ plsb_check -- like plsb_batch(), but instead of writing anything,
+ write the name of each file which is not formatted already to
+ standard output.  Return OKAY if every file is formatted, or
+ ERROR_FOUND otherwise.
+ *******************************************************************/
+int plsb_check( int jobs, const Plsb_options * pOpt, int count,
+	char * paths[] )
+{
+	return run_batch( jobs, NULL, pOpt, TRUE, count, paths );
+}
+
+/********************************************************************
+ run_batch -- do the work of plsb_batch() or plsb_check().
+ *******************************************************************/
+static int run_batch( int jobs, const char * out_dir,
+	const Plsb_options * pOpt, int check, int count, char * paths[] )
+{
+	int rc = OKAY;
+	int i;
+	Batch batch;
+	Plsb_options opt;
+
+	ASSERT( paths != NULL || 0 == count );
+	if( NULL == paths && count > 0 )
+		return ERROR_FOUND;
+
+	/* The tokenizer has only one stream sink, */
+	/* so the workers can't spool. */
+
+	if( NULL == pOpt )
+		plsb_default_options( &opt );
+	else
+		opt = *pOpt;
+	opt.spool = FALSE;
+
+	batch.items    = NULL;
+	batch.count    = 0;
+	batch.capacity = 0;
+	batch.next     = 0;
+	batch.failures = 0;
+	batch.unit_jobs = 1;
+	batch.check    = check;
+	batch.pOpt     = &opt;
+
+	if( out_dir != NULL && make_dirs( out_dir ) != OKAY )
+	{
+		fprintf( stderr, "Unable to create directory %s\n", out_dir );
+		rc = ERROR_FOUND;
+	}
+
+	/* Gather the work */
+
+	for( i = 0; OKAY == rc && i < count; ++i )
+	{
+		struct stat st;
+		char * out_path = NULL;
+
+		if( out_dir != NULL )
+		{
+			/* A directory maps onto out_dir itself; */
+			/* a file goes into it under its own name */
+
+			if( 0 == stat( paths[ i ], &st ) && S_ISDIR( st.st_mode ) )
+				out_path = strDup( out_dir );
+			else
+				out_path = join_path( out_dir, base_name( paths[ i ] ) );
+
+			if( NULL == out_path )
+			{
+				rc = ERROR_FOUND;
+				break;
+			}
+		}
+
+		if( add_path( &batch, paths[ i ], out_path, TRUE ) != OKAY )
+			rc = ERROR_FOUND;
+
+		if( out_path != NULL )
+			freeMemory( out_path );
+	}
+
+	/* Two workers mustn't write the same file */
+
+	if( OKAY == rc && ! check && find_collision( &batch ) != OKAY )
+		rc = ERROR_FOUND;
+
+	/* Do it, largest files first */
+
+	if( OKAY == rc && batch.count > 0 )
+	{
+		qsort( batch.items, batch.count, sizeof( Work ), larger_first );
+
+		if( jobs < 1 )
+			jobs = 1;
+		else if( jobs > MAX_JOBS )
+			jobs = MAX_JOBS;
+
+		/* With more jobs than files, the leftover jobs go */
+		/* to beautifying the units of each file at once  */
+
+		if( (size_t) jobs > batch.count )
+		{
+			batch.unit_jobs = jobs / (int) batch.count;
+			jobs = (int) batch.count;
+		}
+
+#ifdef PLS_THREADS
+		{
+			pthread_t threads[ MAX_JOBS ];
+			int started;
+
+			/* This thread is one of the workers */
+
+			for( started = 0; started < jobs - 1; ++started )
+				if( pthread_create( &threads[ started ], NULL,
+									worker, &batch ) != 0 )
+					break;
+
+			(void) worker( &batch );
+
+			while( started > 0 )
+				(void) pthread_join( threads[ --started ], NULL );
+		}
+#else
+		(void) worker( &batch );
+#endif
+
+		if( batch.failures > 0 )
+			rc = ERROR_FOUND;
+	}
+
+	free_batch( &batch );
+
+	return rc;
+}
+
+/********************************************************************
+ add_path -- add a file to the batch, or the source files within a
+ directory.  If named is TRUE, the path came from the client code,
+ and we take it no matter what it is called, following a symbolic
+ link if need be.  out_path is where the result goes, or NULL for
+ in place.
+ *******************************************************************/
+static int add_path( Batch * pB, const char * path, const char * out_path,
+	int named )
+{
+	struct stat st;
+	int rc;
+
+	if( named )
+		rc = stat( path, &st );
+	else
+		rc = lstat( path, &st );
+
+	if( rc != 0 )
+	{
+		fprintf( stderr, "Unable to find %s\n", path );
+		return ERROR_FOUND;
+	}
+
+	if( S_ISDIR( st.st_mode ) )
+	{
+		if( out_path != NULL && make_dirs( out_path ) != OKAY )
+		{
+			fprintf( stderr, "Unable to create directory %s\n", out_path );
+			return ERROR_FOUND;
+		}
+		return add_dir( pB, path, out_path );
+	}
+	else if( ! S_ISREG( st.st_mode ) )
+	{
+		if( named )
+		{
+			fprintf( stderr, "%s is not a regular file\n", path );
+			return ERROR_FOUND;
+		}
+		return OKAY;		/* ignore symbolic links, devices, etc. */
+	}
+	else if( named || is_source_name( base_name( path ) ) )
+		return add_work( pB, path, out_path, &st );
+	else
+		return OKAY;
+}
+
+/********************************************************************
+ add_dir -- add each source file within a directory, recursively.
+ *******************************************************************/
+static int add_dir( Batch * pB, const char * path, const char * out_path )
+{
+	int rc = OKAY;
+	DIR * pDir;
+	struct dirent * pEnt;
+
+	pDir = opendir( path );
+	if( NULL == pDir )
+	{
+		fprintf( stderr, "Unable to open directory %s\n", path );
+		return ERROR_FOUND;
+	}
+
+	while( OKAY == rc && ( pEnt = readdir( pDir ) ) != NULL )
+	{
+		char * child;
+		char * out_child = NULL;
+
+		if( 0 == strcmp( pEnt->d_name, "." ) ||
+			0 == strcmp( pEnt->d_name, ".." ) )
+			continue;
+
+		child = join_path( path, pEnt->d_name );
+		if( out_path != NULL )
+			out_child = join_path( out_path, pEnt->d_name );
+
+		if( NULL == child || ( out_path != NULL && NULL == out_child ) )
+			rc = ERROR_FOUND;
+		else
+			rc = add_path( pB, child, out_child, FALSE );
+
+		if( child != NULL )
+			freeMemory( child );
+		if( out_child != NULL )
+			freeMemory( out_child );
+	}
+
+	closedir( pDir );
+	return rc;
+}
+
+/********************************************************************
+ add_work -- append a file to the list.
+ *******************************************************************/
+static int add_work( Batch * pB, const char * path, const char * out_path,
+	const struct stat * pStat )
+{
+	Work * pW;
+
+	if( pB->count == pB->capacity )
+	{
+		size_t new_cap;
+		Work * pNew;
+
+		new_cap = pB->capacity ? pB->capacity * 2 : INITIAL_WORK;
+		if( NULL == pB->items )
+			pNew = allocMemory( new_cap * sizeof( Work ) );
+		else
+			pNew = resizeMemory( pB->items, new_cap * sizeof( Work ) );
+
+		if( NULL == pNew )
+			return ERROR_FOUND;
+
+		pB->items = pNew;
+		pB->capacity = new_cap;
+	}
+
+	pW = pB->items + pB->count;
+	pW->in_name = strDup( path );
+	if( NULL == pW->in_name )
+		return ERROR_FOUND;
+
+	if( NULL == out_path )
+		pW->out_name = pW->in_name;
+	else
+	{
+		pW->out_name = strDup( out_path );
+		if( NULL == pW->out_name )
+		{
+			freeMemory( pW->in_name );
+			return ERROR_FOUND;
+		}
+	}
+
+	pW->size = pStat->st_size;
+	pW->mode = pStat->st_mode & 07777;
+	++pB->count;
+	return OKAY;
+}
+
+/********************************************************************
+ is_source_name -- return TRUE if a filename ends with one of the
+ suffixes customarily used for PL/SQL source code, regardless of
+ case.
+ *******************************************************************/
+static int is_source_name( const char * name )
+{
+	size_t len;
+	int i;
+
+	len = strlen( name );
+	for( i = 0; suffixes[ i ] != NULL; ++i )
+	{
+		size_t suf_len;
+		const char * p;
+		const char * q;
+
+		suf_len = strlen( suffixes[ i ] );
+		if( len <= suf_len )
+			continue;
+
+		for( p = name + len - suf_len, q = suffixes[ i ]; *q != '\0';
+			 ++p, ++q )
+		{
+			if( tolower( (unsigned char) *p ) != *q )
+				break;
+		}
+
+		if( '\0' == *q )
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/********************************************************************
+ join_path -- return a newly allocated string consisting of a
+ directory name, a slash, and a filename.  The client code must free
+ it with freeMemory().
+ *******************************************************************/
+static char * join_path( const char * dir, const char * name )
+{
+	size_t dir_len;
+	size_t name_len;
+	char * path;
+
+	dir_len  = strlen( dir );
+	name_len = strlen( name );
+
+	while( dir_len > 1 && '/' == dir[ dir_len - 1 ] )
+		--dir_len;
+
+	path = allocMemory( dir_len + name_len + 2 );
+	if( path != NULL )
+	{
+		memcpy( path, dir, dir_len );
+		path[ dir_len ] = '/';
+		memcpy( path + dir_len + 1, name, name_len + 1 );
+	}
+	return path;
+}
+
+/********************************************************************
+ base_name -- return a pointer to the last component of a path.
+ *******************************************************************/
+static const char * base_name( const char * path )
+{
+	const char * p;
+
+	p = strrchr( path, '/' );
+	if( NULL == p )
+		return path;
+	else
+		return p + 1;
+}
+
+/********************************************************************
+ make_dirs -- create a directory, together with any of its parents
+ that don't exist yet.
+ *******************************************************************/
+static int make_dirs( const char * path )
+{
+	int rc = OKAY;
+	char * copy;
+	char * p;
+
+	copy = strDup( path );
+	if( NULL == copy )
+		return ERROR_FOUND;
+
+	for( p = copy + 1; ; ++p )
+	{
+		if( '/' == *p || '\0' == *p )
+		{
+			char save = *p;
+
+			*p = '\0';
+			if( mkdir( copy, 0777 ) != 0 && errno != EEXIST )
+				rc = ERROR_FOUND;
+			*p = save;
+
+			if( '\0' == save || rc != OKAY )
+				break;
+		}
+	}
+
+	freeMemory( copy );
+	return rc;
+}
+
+/********************************************************************
+ find_collision -- look for two files in the batch with the same
+ output file, and complain about the first such pair we find.  The
+ list is left sorted by output file.
+ *******************************************************************/
+static int find_collision( Batch * pB )
+{
+	size_t i;
+
+	if( pB->count < 2 )
+		return OKAY;
+
+	qsort( pB->items, pB->count, sizeof( Work ), by_out_name );
+
+	for( i = 1; i < pB->count; ++i )
+	{
+		if( 0 == strcmp( pB->items[ i - 1 ].out_name,
+						 pB->items[ i ].out_name ) )
+		{
+			fprintf( stderr, "%s and %s would both be written to %s\n",
+				pB->items[ i - 1 ].in_name, pB->items[ i ].in_name,
+				pB->items[ i ].out_name );
+			return ERROR_FOUND;
+		}
+	}
+
+	return OKAY;
+}
+
+/********************************************************************
+ by_out_name -- comparison function for qsort(), to sort Work items
+ by output file.
+ *******************************************************************/
+static int by_out_name( const void * p1, const void * p2 )
+{
+	const Work * pW1 = p1;
+	const Work * pW2 = p2;
+
+	return strcmp( pW1->out_name, pW2->out_name );
+}
+
+/********************************************************************
+ larger_first -- compare two Works for qsort(), so as to put the
+ larger file first.
+ *******************************************************************/
+static int larger_first( const void * p1, const void * p2 )
+{
+	const Work * pW1 = p1;
+	const Work * pW2 = p2;
+
+	if( pW1->size > pW2->size )
+		return -1;
+	else if( pW1->size < pW2->size )
+		return 1;
+	else
+		return strcmp( pW1->in_name, pW2->in_name );
+}
+
+/********************************************************************
+ worker -- take files from the list and beautify them, one at a
+ time, until none remain.
+ *******************************************************************/
+static void * worker( void * p )
+{
+	Batch * pB = p;
+
+	for( ;; )
+	{
+		size_t i;
+
+		lockMutex( &batch_lock );
+		i = pB->next;
+		if( i < pB->count )
+			++pB->next;
+		unlockMutex( &batch_lock );
+
+		if( i >= pB->count )
+			break;
+
+		if( format_file( pB->items + i, pB ) != OKAY )
+		{
+			lockMutex( &batch_lock );
+			++pB->failures;
+			unlockMutex( &batch_lock );
+		}
+	}
+
+	return NULL;
+}
+
+/********************************************************************
+ format_file -- beautify one file in memory, and put the result
+ where it belongs.  In check mode, just report whether it was
+ formatted already.
+ *******************************************************************/
+static int format_file( const Work * pW, const Batch * pB )
+{
+	int rc = OKAY;
+	FILE * pIn;
+	char * text;
+	size_t len;
+	Ofile out;
+
+	pIn = fopen( pW->in_name, "r" );
+	if( NULL == pIn )
+	{
+		fprintf( stderr, "Unable to open %s for input\n", pW->in_name );
+		return ERROR_FOUND;
+	}
+
+	text = s_read_all( pIn, &len );
+	fclose( pIn );
+	if( NULL == text )
+	{
+		fprintf( stderr, "Unable to read %s\n", pW->in_name );
+		return ERROR_FOUND;
+	}
+
+	/* If the cache knows the file to be formatted already, */
+	/* we need only copy it, if anything */
+
+	if( plsb_cache_fixed( text, len, pB->pOpt ) )
+	{
+		if( pW->out_name != pW->in_name &&
+			replace_file( pW->out_name, pW->mode, text, len ) != OKAY )
+		{
+			fprintf( stderr, "Unable to write %s\n", pW->out_name );
+			rc = ERROR_FOUND;
+		}
+
+		freeMemory( text );
+		return rc;
+	}
+
+	out = o_memory();
+	if( NULL == out.p )
+		rc = ERROR_FOUND;
+	else
+	{
+		const char * result;
+		size_t result_len;
+
+		if( plsb_format_units( text, len, pB->pOpt, pB->unit_jobs,
+							   out ) != OKAY )
+		{
+			fprintf( stderr, "Unable to beautify %s\n", pW->in_name );
+			rc = ERROR_FOUND;
+		}
+		else if( NULL == ( result = o_contents( out, &result_len ) ) )
+			rc = ERROR_FOUND;
+		else if( result_len == len && 0 == memcmp( result, text, len ) )
+		{
+			/* already formatted; leave it alone */
+
+			plsb_cache_record( text, len, pB->pOpt );
+			if( pW->out_name != pW->in_name &&
+				replace_file( pW->out_name, pW->mode, text, len ) != OKAY )
+			{
+				fprintf( stderr, "Unable to write %s\n", pW->out_name );
+				rc = ERROR_FOUND;
+			}
+		}
+		else if( pB->check )
+		{
+			printf( "%s\n", pW->in_name );
+			rc = ERROR_FOUND;
+		}
+		else if( replace_file( pW->out_name, pW->mode,
+							   result, result_len ) != OKAY )
+		{
+			fprintf( stderr, "Unable to write %s\n", pW->out_name );
+			rc = ERROR_FOUND;
+		}
+
+		(void) o_close( &out );
+	}
+
+	freeMemory( text );
+	return rc;
+}
+
+/********************************************************************
+ replace_file -- write text to a temporary file in the same directory
+ as the named file, and then rename it to that name, replacing any
+ file already there.
+ *******************************************************************/
+static int replace_file( const char * name, mode_t mode,
+	const char * text, size_t len )
+{
+	static const char tmp_suffix[] = ".plsbXXXXXX";
+	int rc = OKAY;
+	int fd;
+	char * tmp_name;
+	size_t name_len;
+	Ofile out;
+
+	name_len = strlen( name );
+	tmp_name = allocMemory( name_len + sizeof tmp_suffix );
+	if( NULL == tmp_name )
+		return ERROR_FOUND;
+
+	memcpy( tmp_name, name, name_len );
+	memcpy( tmp_name + name_len, tmp_suffix, sizeof tmp_suffix );
+
+	fd = mkstemp( tmp_name );
+	if( fd < 0 )
+	{
+		freeMemory( tmp_name );
+		return ERROR_FOUND;
+	}
+
+	out = o_fd( fd );
+	if( NULL == out.p )
+		rc = ERROR_FOUND;
+	else
+	{
+		if( o_write( out, text, len ) != OKAY )
+			rc = ERROR_FOUND;
+		if( o_close( &out ) != OKAY )
+			rc = ERROR_FOUND;
+	}
+
+	if( OKAY == rc && fchmod( fd, mode ) != 0 )
+		rc = ERROR_FOUND;
+	if( close( fd ) != 0 )
+		rc = ERROR_FOUND;
+
+	if( OKAY == rc && rename( tmp_name, name ) != 0 )
+		rc = ERROR_FOUND;
+
+	if( rc != OKAY )
+		(void) remove( tmp_name );
+
+	freeMemory( tmp_name );
+	return rc;
+}
+
+/********************************************************************
+ free_batch -- release the list of files.
+ *******************************************************************/
+static void free_batch( Batch * pB )
+{
+	size_t i;
+
+	for( i = 0; i < pB->count; ++i )
+	{
+		if( pB->items[ i ].out_name != pB->items[ i ].in_name )
+			freeMemory( pB->items[ i ].out_name );
+		freeMemory( pB->items[ i ].in_name );
+	}
+
+	if( pB->items != NULL )
+		freeMemory( pB->items );
+
+	pB->items = NULL;
+	pB->count = 0;
+	pB->capacity = 0;
+}
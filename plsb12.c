@@ -0,0 +1,602 @@
+/* plsb12.c -- routines for beautifying a single large input in pieces,
+   several pieces at a time.
+
+   An install script typically holds many units (packages, procedures,
+   and so forth), each terminated by a "/" line.  Between units the
+   beautifier usually comes to rest, with no indentation and no SQL
+   statement in progress, so that each unit could be beautified by a
+   fresh Plsb_context with the same result.  We split the input just
+   before each "/" line that looks like the end of a unit, beautify the
+   pieces in parallel, and concatenate the results in order.
+
+   To find the "/" lines we make a quick pass over the text, recognizing
+   only comments, quoted strings, and the bodies of wrapped units, so
+   as not to be fooled by a "/" line inside any of them.  We only split
+   where the preceding token is a semicolon, a comment, or the body of
+   a wrapped unit, since each of them ends a logical line regardless of
+   what follows.
+
+   Not every unit leaves the beautifier at rest, so we check.  If a
+   piece ends with the beautifier in any other state, the next piece
+   was beautified from the wrong starting point, and we beautify the
+   two of them again as one piece (or more, if need be).  Either way
+   the result is the same as if we had beautified the whole input at
+   once.
+
+   Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+   This program is open software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "ofile.h"
+#include "plsb.h"
+
+#define MAX_JOBS       256
+#define INITIAL_PIECES 16
+#define MAX_BLANKS     6	/* trailing blanks allowed on a "/" line */
+
+/* What kind of token we saw last, in the quick pass */
+
+typedef enum
+{
+	LAST_OTHER,
+	LAST_FINAL,		/* a semicolon or comment */
+	LAST_WRAPPED	/* the body of a wrapped unit */
+} Last_seen;
+
+/* One piece of the input, and its result */
+
+typedef struct
+{
+	const char * in;
+	size_t len;
+	Ofile out;
+	int rc;
+	int at_rest;
+} Piece;
+
+/* The pieces, and the workers' shared position in them */
+
+typedef struct
+{
+	Piece * pieces;
+	size_t count;
+	size_t capacity;
+	size_t * order;		/* indexes of the pieces, largest first */
+	size_t next;		/* the next entry in order[] to be taken */
+	const Plsb_options * pOpt;
+} Piecework;
+
+static Mutex piece_lock = MUTEX_INITIALIZER;	/* guards next */
+
+static int redo_pieces( Piecework * pW, size_t * pI, const char * end,
+	Ofile out );
+static int find_pieces( Piecework * pW, const char * in, size_t len );
+static int add_piece( Piecework * pW, const char * in, size_t len );
+static size_t slash_line( const char * in, size_t len, size_t i );
+static size_t wrapped_body( const char * in, size_t len, size_t i );
+static size_t skip_past( const char * in, size_t len, size_t i,
+	const char * end );
+static int is_word_char( int c );
+static void sort_pieces( Piecework * pW );
+static void * piece_worker( void * p );
+static void free_pieces( Piecework * pW );
+
+/********************************************************************
+ plsb_format_units -- beautify len bytes of PL/SQL source code in
+ memory, like plsb_format(), but split it into units and beautify as
+ many as jobs units at a time.  The result is the same as from
+ plsb_format().  Without PLS_THREADS, or with fewer than two jobs or
+ units, this is merely an expensive way to call plsb_format().
+ *******************************************************************/
+int plsb_format_units( const char * in, size_t len,
+	const Plsb_options * pOpt, int jobs, Ofile out )
+{
+	int rc = OKAY;
+	size_t i;
+	Piecework work;
+	Plsb_options opt;
+
+	ASSERT( in != NULL || 0 == len );
+	ASSERT( out.p != NULL );
+	if( ( NULL == in && len > 0 ) || NULL == out.p )
+		return ERROR_FOUND;
+
+#ifndef PLS_THREADS
+	jobs = 1;
+#endif
+
+	if( jobs < 2 )
+		return plsb_format( in, len, pOpt, out );
+
+	/* The tokenizer has only one stream sink, */
+	/* so the pieces can't spool. */
+
+	if( NULL == pOpt )
+		plsb_default_options( &opt );
+	else
+		opt = *pOpt;
+	opt.spool = FALSE;
+
+	work.pieces   = NULL;
+	work.count    = 0;
+	work.capacity = 0;
+	work.order    = NULL;
+	work.next     = 0;
+	work.pOpt     = &opt;
+
+	if( find_pieces( &work, in, len ) != OKAY || work.count < 2 )
+	{
+		free_pieces( &work );
+		return plsb_format( in, len, &opt, out );
+	}
+
+	sort_pieces( &work );
+	if( NULL == work.order )
+	{
+		free_pieces( &work );
+		return plsb_format( in, len, &opt, out );
+	}
+
+	if( jobs > MAX_JOBS )
+		jobs = MAX_JOBS;
+	if( (size_t) jobs > work.count )
+		jobs = (int) work.count;
+
+#ifdef PLS_THREADS
+	{
+		pthread_t threads[ MAX_JOBS ];
+		int started;
+
+		/* This thread is one of the workers */
+
+		for( started = 0; started < jobs - 1; ++started )
+			if( pthread_create( &threads[ started ], NULL,
+								piece_worker, &work ) != 0 )
+				break;
+
+		(void) piece_worker( &work );
+
+		while( started > 0 )
+			(void) pthread_join( threads[ --started ], NULL );
+	}
+#else
+	(void) piece_worker( &work );
+#endif
+
+	/* Collect the results in order, as long as each piece ends   */
+	/* where the next one can begin afresh.  When one doesn't, we  */
+	/* beautify it again together with the pieces after it, until */
+	/* we come to rest at the end of a piece, doubling the number  */
+	/* of pieces each time so that the work stays proportional.   */
+	/* A piece that failed gets the same treatment, so that we     */
+	/* fail at the same point as plsb_format() would. */
+
+	i = 0;
+	while( OKAY == rc && i < work.count )
+	{
+		Piece * pP = work.pieces + i;
+		const char * text = NULL;
+		size_t text_len;
+
+		if( OKAY == pP->rc && ( pP->at_rest || i + 1 == work.count ) )
+			text = o_contents( pP->out, &text_len );
+
+		if( text != NULL )
+		{
+			if( o_write( out, text, text_len ) != OKAY )
+				rc = ERROR_FOUND;
+			++i;
+		}
+		else
+			rc = redo_pieces( &work, &i, in + len, out );
+	}
+
+	free_pieces( &work );
+	return rc;
+}
+
+/********************************************************************
+ redo_pieces -- beautify the piece at *pI together with a growing
+ number of the pieces after it, until we come to rest at the end or
+ run out of pieces.  Then write the result and advance *pI past the
+ pieces we used.  end points to the end of the whole input.
+ *******************************************************************/
+static int redo_pieces( Piecework * pW, size_t * pI, const char * end,
+	Ofile out )
+{
+	int rc = OKAY;
+	size_t first = *pI;
+	size_t span = 2;
+
+	for( ;; )
+	{
+		size_t last;
+		const char * stop;
+		int at_rest;
+		Ofile piece_out;
+
+		last = first + span - 1;
+		if( last + 1 >= pW->count )
+		{
+			/* All the rest, directly to the output */
+
+			*pI = pW->count;
+			return plsb_format( pW->pieces[ first ].in,
+				(size_t) ( end - pW->pieces[ first ].in ), pW->pOpt, out );
+		}
+
+		stop = pW->pieces[ last + 1 ].in;
+		piece_out = o_memory();
+		if( NULL == piece_out.p )
+			return ERROR_FOUND;
+
+		rc = plsb_format_piece( pW->pieces[ first ].in,
+			(size_t) ( stop - pW->pieces[ first ].in ), pW->pOpt,
+			piece_out, &at_rest );
+
+		if( OKAY == rc && at_rest )
+		{
+			const char * text;
+			size_t text_len;
+
+			text = o_contents( piece_out, &text_len );
+			if( NULL == text || o_write( out, text, text_len ) != OKAY )
+				rc = ERROR_FOUND;
+
+			(void) o_close( &piece_out );
+			*pI = last + 1;
+			return rc;
+		}
+
+		(void) o_close( &piece_out );
+		span *= 2;
+	}
+}
+
+/********************************************************************
+ find_pieces -- make a quick pass over the input, and divide it into
+ pieces just before each "/" line which ends a unit.
+ *******************************************************************/
+static int find_pieces( Piecework * pW, const char * in, size_t len )
+{
+	size_t i = 0;
+	size_t start = 0;
+	int line_start = TRUE;
+	Last_seen last = LAST_OTHER;
+
+	while( i < len )
+	{
+		int c = (unsigned char) in[ i ];
+
+		if( line_start && '/' == c )
+		{
+			size_t end;
+
+			end = slash_line( in, len, i );
+			if( end > i )
+			{
+				size_t split = i;
+
+				/* The body of a wrapped unit ends before the newline */
+				/* preceding the "/" line, but only if there is a "/"  */
+				/* line; so the newline must go with the next piece.   */
+
+				if( LAST_WRAPPED == last )
+					--split;
+
+				if( last != LAST_OTHER && split > start )
+				{
+					if( add_piece( pW, in + start, split - start ) != OKAY )
+						return ERROR_FOUND;
+					start = split;
+				}
+
+				last = LAST_OTHER;
+				i = end;
+				continue;
+			}
+		}
+
+		line_start = FALSE;
+
+		if( '\n' == c )
+		{
+			line_start = TRUE;
+			++i;
+		}
+		else if( ' ' == c || '\t' == c || '\r' == c )
+			++i;
+		else if( ';' == c )
+		{
+			last = LAST_FINAL;
+			++i;
+		}
+		else if( '-' == c && i + 1 < len && '-' == in[ i + 1 ] )
+		{
+			/* Leave the newline to be seen as such */
+
+			while( i < len && in[ i ] != '\n' )
+				++i;
+			last = LAST_FINAL;
+		}
+		else if( '/' == c && i + 1 < len && '*' == in[ i + 1 ] )
+		{
+			i = skip_past( in, len, i + 2, "*/" );
+			last = LAST_FINAL;
+		}
+		else if( '\'' == c )
+		{
+			/* A doubled quote just looks like two strings */
+
+			i = skip_past( in, len, i + 1, "'" );
+			last = LAST_OTHER;
+		}
+		else if( '"' == c )
+		{
+			i = skip_past( in, len, i + 1, "\"" );
+			last = LAST_OTHER;
+		}
+		else if( is_word_char( c ) )
+		{
+			size_t word = i;
+
+			while( i < len && is_word_char( (unsigned char) in[ i ] ) )
+				++i;
+
+			last = LAST_OTHER;
+			if( 7 == i - word )
+			{
+				size_t end;
+
+				end = wrapped_body( in, len, i );
+				if( end > i )
+				{
+					/* The "/" line ending the body is next */
+
+					i = end;
+					line_start = TRUE;
+					last = LAST_WRAPPED;
+				}
+			}
+		}
+		else
+		{
+			last = LAST_OTHER;
+			++i;
+		}
+	}
+
+	if( start < len || 0 == pW->count )
+		return add_piece( pW, in + start, len - start );
+	else
+		return OKAY;
+}
+
+/********************************************************************
+ add_piece -- append a piece to the list.
+ *******************************************************************/
+static int add_piece( Piecework * pW, const char * in, size_t len )
+{
+	Piece * pP;
+
+	if( pW->count == pW->capacity )
+	{
+		size_t new_cap;
+		Piece * pNew;
+
+		new_cap = pW->capacity ? pW->capacity * 2 : INITIAL_PIECES;
+		if( NULL == pW->pieces )
+			pNew = allocMemory( new_cap * sizeof( Piece ) );
+		else
+			pNew = resizeMemory( pW->pieces, new_cap * sizeof( Piece ) );
+
+		if( NULL == pNew )
+			return ERROR_FOUND;
+
+		pW->pieces = pNew;
+		pW->capacity = new_cap;
+	}
+
+	pP = pW->pieces + pW->count;
+	pP->in      = in;
+	pP->len     = len;
+	pP->out.p   = NULL;
+	pP->rc      = ERROR_FOUND;
+	pP->at_rest = FALSE;
+	++pW->count;
+	return OKAY;
+}
+
+/********************************************************************
+ slash_line -- given the offset of a "/" at the beginning of a line,
+ see whether it is alone on the line, apart from a few trailing
+ blanks.  If so, return the offset of the start of the next line (or
+ of the end of the input).  Otherwise return the offset of the "/".
+ *******************************************************************/
+static size_t slash_line( const char * in, size_t len, size_t i )
+{
+	size_t j;
+	int blanks = 0;
+
+	for( j = i + 1; j < len; ++j )
+	{
+		if( '\n' == in[ j ] )
+			return j + 1;
+		else if( ( ' ' == in[ j ] || '\t' == in[ j ] || '\r' == in[ j ] ) &&
+				 blanks < MAX_BLANKS )
+			++blanks;
+		else
+			return i;
+	}
+
+	return len;
+}
+
+/********************************************************************
+ wrapped_body -- given the offset just past a seven-letter word, see
+ whether the word is the WRAPPED keyword of a wrapped unit, by the
+ same test that the tokenizer applies: it must end the line, and the
+ next line must begin with "a0".  If so, return the offset of the "/"
+ line which ends the body (or of the end of the input).  Otherwise
+ return the offset we were given.
+ *******************************************************************/
+static size_t wrapped_body( const char * in, size_t len, size_t i )
+{
+	static const char marker[] = "wrapped";
+	size_t j;
+	int k;
+
+	for( k = 0; k < 7; ++k )
+		if( tolower( (unsigned char) in[ i - 7 + k ] ) != marker[ k ] )
+			return i;
+
+	for( j = i, k = 0; j < len && k < MAX_BLANKS &&
+		 ( ' ' == in[ j ] || '\t' == in[ j ] || '\r' == in[ j ] ); ++j, ++k )
+		;
+
+	if( len - j < 3 || in[ j ] != '\n' ||
+		( in[ j + 1 ] != 'a' && in[ j + 1 ] != 'A' ) || in[ j + 2 ] != '0' )
+		return i;
+
+	/* Look for a "/" line */
+
+	for( ++j; j < len; ++j )
+	{
+		if( '\n' == in[ j - 1 ] && '/' == in[ j ] &&
+			slash_line( in, len, j ) > j )
+			return j;
+	}
+
+	return len;
+}
+
+/********************************************************************
+ skip_past -- return the offset just past the next occurrence of a
+ terminating string, or of the end of the input if there isn't one.
+ *******************************************************************/
+static size_t skip_past( const char * in, size_t len, size_t i,
+	const char * end )
+{
+	size_t end_len;
+
+	end_len = strlen( end );
+	for( ; i + end_len <= len; ++i )
+	{
+		if( 0 == memcmp( in + i, end, end_len ) )
+			return i + end_len;
+	}
+
+	return len;
+}
+
+/********************************************************************
+ is_word_char -- return TRUE if a character may appear in an
+ identifier or keyword (or a number, which is just as good for our
+ purposes).
+ *******************************************************************/
+static int is_word_char( int c )
+{
+	return isalnum( c ) || '_' == c || '$' == c || '#' == c || c >= 0x80;
+}
+
+/********************************************************************
+ sort_pieces -- list the pieces in order of decreasing size, so that
+ the workers start with the largest ones.  A simple insertion sort
+ will do, since the pieces are few compared with the work of
+ beautifying them.  On failure leave pW->order NULL.
+ *******************************************************************/
+static void sort_pieces( Piecework * pW )
+{
+	size_t i;
+
+	pW->order = allocMemory( pW->count * sizeof( size_t ) );
+	if( NULL == pW->order )
+		return;
+
+	for( i = 0; i < pW->count; ++i )
+	{
+		size_t j = i;
+
+		while( j > 0 &&
+			   pW->pieces[ pW->order[ j - 1 ] ].len < pW->pieces[ i ].len )
+		{
+			pW->order[ j ] = pW->order[ j - 1 ];
+			--j;
+		}
+		pW->order[ j ] = i;
+	}
+}
+
+/********************************************************************
+ piece_worker -- take pieces and beautify them, one at a time, until
+ none remain.
+ *******************************************************************/
+static void * piece_worker( void * p )
+{
+	Piecework * pW = p;
+
+	for( ;; )
+	{
+		size_t i;
+		Piece * pP;
+
+		lockMutex( &piece_lock );
+		i = pW->next;
+		if( i < pW->count )
+			++pW->next;
+		unlockMutex( &piece_lock );
+
+		if( i >= pW->count )
+			break;
+
+		pP = pW->pieces + pW->order[ i ];
+		pP->out = o_memory();
+		if( pP->out.p != NULL )
+			pP->rc = plsb_format_piece( pP->in, pP->len, pW->pOpt,
+				pP->out, &pP->at_rest );
+	}
+
+	return NULL;
+}
+
+/********************************************************************
+ free_pieces -- release the pieces and their results.
+ *******************************************************************/
+static void free_pieces( Piecework * pW )
+{
+	size_t i;
+
+	for( i = 0; i < pW->count; ++i )
+		if( pW->pieces[ i ].out.p != NULL )
+			(void) o_close( &pW->pieces[ i ].out );
+
+	if( pW->pieces != NULL )
+		freeMemory( pW->pieces );
+	if( pW->order != NULL )
+		freeMemory( pW->order );
+
+	pW->pieces = NULL;
+	pW->order = NULL;
+	pW->count = 0;
+	pW->capacity = 0;
+}
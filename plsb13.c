@@ -0,0 +1,313 @@
+/* plsb13.c -- routines for beautifying only selected lines of an input,
+   passing the rest through unchanged.
+
+   The indentation of any line depends on everything before it, so we
+   still have to read the input from the top, and keep the state of the
+   beautifier up to date.  But the text beautified outside the selected
+   lines goes into a scratch buffer and is thrown away, and once we are
+   past the last selected line we stop reading tokens altogether and
+   copy the rest of the input as is.
+
+   Keeping the state up to date this way is not cheap: the lines ahead
+   of a selection are fully beautified, only to be discarded.  A scan
+   that tracked the state without producing any text would be faster,
+   but write_logical_line() doesn't separate the two, so for now a
+   selection near the end of a large input costs nearly as much as
+   beautifying the whole thing.
+
+   We work in chunks of whole input lines.  A chunk holds one or more
+   consecutive logical lines, such that no input line holds parts of two
+   different chunks.  If any line of a chunk is selected, the whole chunk
+   is replaced by its beautified version; otherwise it is copied byte for
+   byte.  Blank lines between chunks are copied unless they are selected,
+   in which case they are dropped, as plsb drops them.
+
+   Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+   This program is open software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "ofile.h"
+#include "plsb.h"
+
+/* Our position in the input, for copying it */
+
+typedef struct
+{
+	const char * in;
+	size_t len;
+	size_t pos;		/* offset of the start of the current line */
+	int line;		/* number of the current line */
+} Cursor;
+
+static int selected( const Plsb_range * ranges, int count,
+	int first, int last );
+static int last_line( const Toklist * pTL );
+static int pass_lines( Cursor * pCur, int upto, const Plsb_range * ranges,
+	int count, Ofile out );
+static void skip_lines( Cursor * pCur, int upto );
+static size_t line_end( const Cursor * pCur );
+
+/********************************************************************
+ plsb_format_lines -- beautify the lines of an input in memory that
+ fall within any of count ranges of line numbers (counting from 1),
+ and copy the rest unchanged, appending the result to an Ofile.  The
+ ranges may overlap, and need not be in order.  Otherwise this works
+ like plsb_format().
+ *******************************************************************/
+int plsb_format_lines( const char * in, size_t len,
+	const Plsb_options * pOpt, const Plsb_range * ranges, int count,
+	Ofile out )
+{
+	int rc = OKAY;
+	int i;
+	int max_line = 0;
+	int chunk_first = 0;	/* zero if no chunk is open */
+	int chunk_last = 0;
+	Cursor cur;
+	Sfile s;
+	Ofile chunk;
+	Plsb_context ctx;
+	Toklist list;
+
+	ASSERT( in != NULL || 0 == len );
+	ASSERT( ranges != NULL || 0 == count );
+	ASSERT( out.p != NULL );
+	if( ( NULL == in && len > 0 ) || ( NULL == ranges && count > 0 ) ||
+		NULL == out.p )
+		return ERROR_FOUND;
+
+	if( NULL == in )
+		in = "";
+
+	for( i = 0; i < count; ++i )
+		if( ranges[ i ].last > max_line )
+			max_line = ranges[ i ].last;
+
+	cur.in   = in;
+	cur.len  = len;
+	cur.pos  = 0;
+	cur.line = 1;
+
+	if( max_line < 1 )
+		return o_write( out, in, len );
+
+	s = s_memory( in, len );
+	if( NULL == s.p )
+		return ERROR_FOUND;
+
+	chunk = o_memory();
+	if( NULL == chunk.p )
+	{
+		s_close( &s );
+		return ERROR_FOUND;
+	}
+
+	rc = plsb_init( &ctx, chunk );
+	if( OKAY == rc && pOpt != NULL && pOpt->indent_string != NULL )
+	{
+		ctx.indent_string = pOpt->indent_string;
+		rc = o_set_indent( ctx.output, ctx.indent_string );
+	}
+	if( OKAY == rc )
+		rc = plsb_open( &ctx, s );
+	if( rc != OKAY )
+	{
+		(void) o_close( &chunk );
+		s_close( &s );
+		return rc;
+	}
+
+	(void) init_toklist( &list, NULL );
+
+	for( ;; )
+	{
+		int first;
+		int last;
+
+		rc = get_logical_line( &ctx, &list );
+		if( rc != OKAY )
+			break;
+
+		if( T_eof == list.pFirst->type )
+			first = INT_MAX;
+		else
+			first = list.pFirst->pT->line;
+
+		/* If the logical line starts on a later input line, */
+		/* finish the chunk we have */
+
+		if( chunk_first > 0 && first > chunk_last )
+		{
+			if( selected( ranges, count, chunk_first, chunk_last ) )
+			{
+				const char * text;
+				size_t text_len;
+
+				text = o_contents( chunk, &text_len );
+				if( NULL == text || o_write( out, text, text_len ) != OKAY )
+					rc = ERROR_FOUND;
+				skip_lines( &cur, chunk_last + 1 );
+			}
+			else
+				rc = pass_lines( &cur, chunk_last + 1, NULL, 0, out );
+
+			chunk_first = 0;
+			if( rc != OKAY )
+				break;
+		}
+
+		/* Past the last selected line, with no chunk left open, we */
+		/* can stop.  An open chunk must run to its end first, since  */
+		/* it may hold a selected line.                               */
+
+		if( 0 == chunk_first && first > max_line )
+			break;
+
+		if( 0 == chunk_first )
+		{
+			rc = pass_lines( &cur, first, ranges, count, out );
+			if( rc != OKAY )
+				break;
+			(void) o_truncate( chunk, 0 );
+			chunk_first = first;
+			chunk_last = first;
+		}
+
+		rc = write_logical_line( &ctx, &list );
+		if( rc != OKAY )
+			break;
+
+		last = last_line( &list );
+		if( last > chunk_last )
+			chunk_last = last;
+
+		empty_toklist( &list );
+	}
+
+	/* Whatever is left goes through as is */
+
+	if( OKAY == rc )
+		rc = pass_lines( &cur, INT_MAX, ranges, count, out );
+
+	free_toklist( &list );
+	plsb_close( &ctx );
+	s_close( &s );
+
+	if( o_close( &chunk ) != OKAY )
+		rc = ERROR_FOUND;
+	if( OKAY == rc && o_error( out ) )
+		rc = ERROR_FOUND;
+
+	return rc;
+}
+
+/********************************************************************
+ selected -- return TRUE if any of the lines from first through last
+ falls within any of the ranges.
+ *******************************************************************/
+static int selected( const Plsb_range * ranges, int count,
+	int first, int last )
+{
+	int i;
+
+	for( i = 0; i < count; ++i )
+	{
+		if( ranges[ i ].first <= last && ranges[ i ].last >= first )
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/********************************************************************
+ last_line -- return the number of the last input line holding any
+ part of a logical line, not counting the end of file.
+ *******************************************************************/
+static int last_line( const Toklist * pTL )
+{
+	const Toknode * pTN;
+
+	pTN = pTL->pLast;
+	if( T_eof == pTN->type && PREV_NODE( pTN ) != NULL )
+		pTN = PREV_NODE( pTN );
+
+	return pTN->pT->line + (int) pTN->pT->extra_lines;
+}
+
+/********************************************************************
+ pass_lines -- advance the cursor to the start of a specified line
+ (or to the end of the input), copying each line that we pass to the
+ Ofile unless it is selected by one of the ranges.  With no ranges,
+ copy every line.
+ *******************************************************************/
+static int pass_lines( Cursor * pCur, int upto, const Plsb_range * ranges,
+	int count, Ofile out )
+{
+	int rc = OKAY;
+
+	while( pCur->line < upto && pCur->pos < pCur->len )
+	{
+		size_t end;
+
+		end = line_end( pCur );
+		if( ! selected( ranges, count, pCur->line, pCur->line ) )
+		{
+			if( o_write( out, pCur->in + pCur->pos, end - pCur->pos )
+				!= OKAY )
+				rc = ERROR_FOUND;
+		}
+
+		pCur->pos = end;
+		++pCur->line;
+	}
+
+	return rc;
+}
+
+/********************************************************************
+ skip_lines -- advance the cursor to the start of a specified line,
+ without copying anything.
+ *******************************************************************/
+static void skip_lines( Cursor * pCur, int upto )
+{
+	while( pCur->line < upto && pCur->pos < pCur->len )
+	{
+		pCur->pos = line_end( pCur );
+		++pCur->line;
+	}
+}
+
+/********************************************************************
+ line_end -- return the offset just past the newline ending the
+ current line, or of the end of the input.
+ *******************************************************************/
+static size_t line_end( const Cursor * pCur )
+{
+	const char * p;
+
+	p = memchr( pCur->in + pCur->pos, '\n', pCur->len - pCur->pos );
+	if( NULL == p )
+		return pCur->len;
+	else
+		return (size_t) ( p - pCur->in ) + 1;
+}
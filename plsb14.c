@@ -0,0 +1,955 @@
+/* plsb14.c -- routines for beautifying an edited input incrementally,
+   starting from checkpoints recorded by an earlier run.
+
+   As in plsb13.c, we work in chunks of whole input lines, each holding
+   one or more logical lines.  At the start of a chunk every few
+   kilobytes we record a checkpoint: the state of the beautifier
+   (indentation, type stack, pending unindents and syntax levels),
+   together with a hash of the text up to the next checkpoint and
+   whether that text came out of the beautifier unchanged.  The
+   checkpoints make up a Plsb_index, which the client code may save to
+   a file and load again for the next run.
+
+   On the next run we hash the new input chunk by chunk, from the front
+   and from the back, to find how much of it is the same as before.  The
+   text ahead of the first difference was already formatted, so we copy
+   it, and resume beautifying one chunk before the difference, from the
+   checkpoint recorded there.  As soon as we arrive at the start of an
+   unchanged chunk at the back, in the same state as when we passed it
+   the last time, the rest of the output can only be the same as before,
+   so we copy the rest of the input and stop.
+
+   The result is always the same as from beautifying the whole input.
+   Where the text was not already formatted, we simply do more of the
+   work over again.
+
+   Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+   This program is open software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "ofile.h"
+#include "plsb.h"
+
+/* Mixed into the key of an index, so that checkpoints from a different */
+/* version of the beautifier are never used.  Bump the version whenever */
+/* the output or the meaning of the state changes.                      */
+
+#define INDEX_SALT  "plsb checkpoints 1"
+#define INDEX_MAGIC "plsb-checkpoints"
+#define KEY_LEN 16		/* hex digits in a key */
+
+/* We don't record a checkpoint at the start of every chunk, but only */
+/* at the first one at least this many bytes past the last checkpoint, */
+/* so as to keep the index small.                                      */
+
+#define CHECKPOINT_SPACING 4096
+
+static uint64_t index_key( const Plsb_options * pOpt );
+static int same_start( const Plsb_index * pX, size_t i,
+	const char * in, size_t len );
+static int same_end( const Plsb_index * pX, size_t i,
+	const char * in, size_t len );
+static size_t segment_end( const Plsb_index * pX, size_t i );
+static long find_checkpoint( const Plsb_index * pX, size_t first,
+	size_t offset );
+static Plsb_checkpoint * add_checkpoint( Plsb_index * pX );
+static int save_state( const Plsb_context * pC, Plsb_checkpoint * pCP );
+static int restore_state( Plsb_context * pC, const Plsb_checkpoint * pCP );
+static int same_state( const Plsb_context * pC,
+	const Plsb_checkpoint * pCP );
+static size_t advance( const char * in, size_t len, size_t pos,
+	int * pLine, int upto );
+static int last_line( const Toklist * pTL );
+static int write_key( Ofile out, uint64_t key );
+static int read_key( FILE * pF, uint64_t * pKey );
+
+/********************************************************************
+ plsb_index_init -- initialize an empty Plsb_index.
+ *******************************************************************/
+void plsb_index_init( Plsb_index * pX )
+{
+	ASSERT( pX != NULL );
+	if( NULL == pX )
+		return;
+
+	pX->key      = 0;
+	pX->len      = 0;
+	pX->points   = NULL;
+	pX->count    = 0;
+	pX->capacity = 0;
+}
+
+/********************************************************************
+ plsb_index_free -- release the checkpoints of a Plsb_index, leaving
+ it empty.
+ *******************************************************************/
+void plsb_index_free( Plsb_index * pX )
+{
+	size_t i;
+
+	ASSERT( pX != NULL );
+	if( NULL == pX )
+		return;
+
+	for( i = 0; i < pX->count; ++i )
+	{
+		if( pX->points[ i ].levels != NULL )
+			freeMemory( pX->points[ i ].levels );
+	}
+
+	if( pX->points != NULL )
+		freeMemory( pX->points );
+
+	plsb_index_init( pX );
+}
+
+/********************************************************************
+ plsb_format_resume -- beautify len bytes of source code in memory,
+ appending the result to an Ofile, as plsb_format() does.  pX holds
+ the checkpoints of an earlier run over a similar input (or none at
+ all), which we use to skip the parts that haven't changed.  We then
+ replace them with the checkpoints of this run.
+
+ Spooling is not allowed.  If we fail, we leave the index empty.
+ *******************************************************************/
+int plsb_format_resume( const char * in, size_t len,
+	const Plsb_options * pOpt, Plsb_index * pX, Ofile out )
+{
+	int rc = OKAY;
+	size_t start = 0;		/* where the old index first differs */
+	size_t tail;			/* where the unchanged chunks at the end begin */
+	size_t base;			/* offset where we resume */
+	int line;				/* the number of the line at pos */
+	size_t pos;
+	int chunk_last = 0;		/* zero if no chunk is open */
+	int base_line;
+	Sfile s;
+	Ofile chunk;
+	Plsb_context ctx;
+	Plsb_index new_index;
+	Plsb_checkpoint * pCP = NULL;
+	Toklist list;
+
+	ASSERT( in != NULL || 0 == len );
+	ASSERT( pX != NULL );
+	ASSERT( out.p != NULL );
+	if( ( NULL == in && len > 0 ) || NULL == pX || NULL == out.p )
+		return ERROR_FOUND;
+
+	if( NULL == in )
+		in = "";
+
+	/* Disregard the old checkpoints if they come from  */
+	/* different options or a different beautifier */
+
+	if( pX->key != index_key( pOpt ) )
+		plsb_index_free( pX );
+
+	/* Find the first checkpoint whose text may have changed, */
+	/* and the unchanged ones at the end */
+
+	while( start < pX->count && same_start( pX, start, in, len ) )
+		++start;
+
+	if( start > 0 && start == pX->count )
+		return o_write( out, in, len );		/* nothing has changed */
+
+	tail = pX->count;
+	while( tail > start + 1 && same_end( pX, tail - 1, in, len ) )
+		--tail;
+
+	/* Resume one checkpoint before the first difference, because */
+	/* the end of the chunk before it depends on the token after it */
+
+	plsb_index_init( &new_index );
+	new_index.key = index_key( pOpt );
+	new_index.len = len;
+
+	if( start > 0 )
+		--start;
+
+	if( start < pX->count )
+	{
+		size_t i;
+
+		base = pX->points[ start ].offset;
+		line = pX->points[ start ].line;
+		if( o_write( out, in, base ) != OKAY )
+			rc = ERROR_FOUND;
+
+		/* Take over the checkpoints ahead of that one */
+
+		for( i = 0; OKAY == rc && i < start; ++i )
+		{
+			pCP = add_checkpoint( &new_index );
+			if( NULL == pCP )
+				rc = ERROR_FOUND;
+			else
+			{
+				*pCP = pX->points[ i ];
+				pX->points[ i ].levels = NULL;
+			}
+		}
+		pCP = NULL;
+	}
+	else
+	{
+		base = 0;
+		line = 1;
+	}
+
+	if( rc != OKAY )
+	{
+		plsb_index_free( &new_index );
+		plsb_index_free( pX );
+		return rc;
+	}
+
+	pos = base;
+	base_line = line - 1;
+
+	/* The tokens report line numbers counting from where we resume */
+
+	s = s_memory( in + base, len - base );
+	if( NULL == s.p )
+	{
+		plsb_index_free( &new_index );
+		plsb_index_free( pX );
+		return ERROR_FOUND;
+	}
+
+	chunk = o_memory();
+	if( NULL == chunk.p )
+	{
+		s_close( &s );
+		plsb_index_free( &new_index );
+		plsb_index_free( pX );
+		return ERROR_FOUND;
+	}
+
+	rc = plsb_init( &ctx, chunk );
+	if( OKAY == rc && pOpt != NULL && pOpt->indent_string != NULL )
+	{
+		ctx.indent_string = pOpt->indent_string;
+		rc = o_set_indent( ctx.output, ctx.indent_string );
+	}
+	if( OKAY == rc && start < pX->count )
+		rc = restore_state( &ctx, pX->points + start );
+	if( OKAY == rc )
+		rc = plsb_open( &ctx, s );
+	if( rc != OKAY )
+	{
+		while( ctx.level_stack != NULL )
+			pop_level( &ctx );
+		(void) o_close( &chunk );
+		s_close( &s );
+		plsb_index_free( &new_index );
+		plsb_index_free( pX );
+		return rc;
+	}
+
+	(void) init_toklist( &list, NULL );
+
+	for( ;; )
+	{
+		int first;
+		int last;
+
+		rc = get_logical_line( &ctx, &list );
+		if( rc != OKAY )
+			break;
+
+		if( T_eof == list.pFirst->type )
+			first = INT_MAX;
+		else
+			first = list.pFirst->pT->line + base_line;
+
+		/* If the logical line starts on a later input line, */
+		/* finish the chunk we have */
+
+		if( chunk_last > 0 && first > chunk_last )
+		{
+			const char * text;
+			size_t text_len;
+			size_t end;
+
+			if( INT_MAX == first )
+				end = len;
+			else
+				end = advance( in, len, pos, &line, chunk_last + 1 );
+
+			text = o_contents( chunk, &text_len );
+			if( NULL == text || o_write( out, text, text_len ) != OKAY )
+				rc = ERROR_FOUND;
+			else
+			{
+				pCP->hash = pls_hash( in + pos, end - pos, pCP->hash );
+				if( text_len != end - pos ||
+					memcmp( text, in + pos, text_len ) != 0 )
+					pCP->fixed = FALSE;
+			}
+
+			pos = end;
+			chunk_last = 0;
+			if( rc != OKAY )
+				break;
+		}
+
+		if( INT_MAX == first )
+			break;
+
+		/* If we're back on the old track, the */
+		/* rest is the same as the last time */
+
+		if( 0 == chunk_last )
+		{
+			long j = -1;
+
+			if( pos + pX->len >= len )
+				j = find_checkpoint( pX, tail, pos + pX->len - len );
+			if( j >= 0 && same_state( &ctx, pX->points + j ) )
+			{
+				size_t i;
+
+				if( o_write( out, in + pos, len - pos ) != OKAY )
+					rc = ERROR_FOUND;
+
+				for( i = j; OKAY == rc && i < pX->count; ++i )
+				{
+					pCP = add_checkpoint( &new_index );
+					if( NULL == pCP )
+						rc = ERROR_FOUND;
+					else
+					{
+						*pCP = pX->points[ i ];
+						pX->points[ i ].levels = NULL;
+						pCP->offset = pCP->offset + len - pX->len;
+						pCP->line += line - pX->points[ j ].line;
+					}
+				}
+				break;
+			}
+
+			/* Otherwise start a new chunk here, and a new */
+			/* checkpoint if the last one is far enough back */
+
+			if( NULL == pCP || pos - pCP->offset >= CHECKPOINT_SPACING )
+			{
+				pCP = add_checkpoint( &new_index );
+				if( NULL == pCP )
+				{
+					rc = ERROR_FOUND;
+					break;
+				}
+
+				pCP->line   = line;
+				pCP->offset = pos;
+				pCP->hash   = PLS_HASH_INIT;
+				pCP->fixed  = TRUE;
+				rc = save_state( &ctx, pCP );
+				if( rc != OKAY )
+					break;
+			}
+
+			(void) o_truncate( chunk, 0 );
+			chunk_last = first;
+		}
+
+		rc = write_logical_line( &ctx, &list );
+		if( rc != OKAY )
+			break;
+
+		last = last_line( &list ) + base_line;
+		if( last > chunk_last )
+			chunk_last = last;
+
+		empty_toklist( &list );
+	}
+
+	free_toklist( &list );
+	plsb_close( &ctx );
+	s_close( &s );
+
+	if( o_close( &chunk ) != OKAY )
+		rc = ERROR_FOUND;
+	if( OKAY == rc && o_error( out ) )
+		rc = ERROR_FOUND;
+
+	/* Replace the old checkpoints with the new ones */
+
+	plsb_index_free( pX );
+	if( OKAY == rc )
+		*pX = new_index;
+	else
+		plsb_index_free( &new_index );
+
+	return rc;
+}
+
+/********************************************************************
+ index_key -- compute a key identifying the options and the version
+ of the beautifier.
+ *******************************************************************/
+static uint64_t index_key( const Plsb_options * pOpt )
+{
+	uint64_t key;
+	const char * indent_string = "    ";
+
+	if( pOpt != NULL && pOpt->indent_string != NULL )
+		indent_string = pOpt->indent_string;
+
+	key = pls_hash( INDEX_SALT, sizeof( INDEX_SALT ), PLS_HASH_INIT );
+	key = pls_hash( indent_string, strlen( indent_string ) + 1, key );
+	return key;
+}
+
+/********************************************************************
+ segment_end -- return the offset, in the old input, of the end of
+ the text belonging to checkpoint i: the next checkpoint, or the end
+ of the input.
+ *******************************************************************/
+static size_t segment_end( const Plsb_index * pX, size_t i )
+{
+	if( i + 1 < pX->count )
+		return pX->points[ i + 1 ].offset;
+	else
+		return pX->len;
+}
+
+/********************************************************************
+ same_start -- return TRUE if the text belonging to checkpoint i came
+ out unchanged the last time, and is also found at the same offset in
+ the new input.  The text of the last checkpoint runs to the end of
+ the input, so it must also end in the same place.
+ *******************************************************************/
+static int same_start( const Plsb_index * pX, size_t i,
+	const char * in, size_t len )
+{
+	const Plsb_checkpoint * pCP = pX->points + i;
+	size_t end;
+
+	end = segment_end( pX, i );
+	if( FALSE == pCP->fixed || end > len ||
+		( i + 1 == pX->count && end != len ) )
+		return FALSE;
+
+	return pCP->hash ==
+		pls_hash( in + pCP->offset, end - pCP->offset, PLS_HASH_INIT );
+}
+
+/********************************************************************
+ same_end -- return TRUE if the text belonging to checkpoint i came
+ out unchanged the last time, and is also found at the same distance
+ from the end of the new input.
+ *******************************************************************/
+static int same_end( const Plsb_index * pX, size_t i,
+	const char * in, size_t len )
+{
+	const Plsb_checkpoint * pCP = pX->points + i;
+	size_t end;
+
+	end = segment_end( pX, i );
+	if( FALSE == pCP->fixed || pX->len - pCP->offset > len )
+		return FALSE;
+
+	return pCP->hash == pls_hash( in + pCP->offset + len - pX->len,
+		end - pCP->offset, PLS_HASH_INIT );
+}
+
+/********************************************************************
+ find_checkpoint -- find the checkpoint, at or after subscript first,
+ at a given offset in the old input.  Return its subscript, or -1 if
+ there isn't one.
+ *******************************************************************/
+static long find_checkpoint( const Plsb_index * pX, size_t first,
+	size_t offset )
+{
+	size_t lo = first;
+	size_t hi = pX->count;
+
+	while( lo < hi )
+	{
+		size_t mid = lo + ( hi - lo ) / 2;
+
+		if( pX->points[ mid ].offset < offset )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if( lo < pX->count && pX->points[ lo ].offset == offset )
+		return (long) lo;
+	else
+		return -1L;
+}
+
+/********************************************************************
+ add_checkpoint -- append an uninitialized checkpoint to an index,
+ and return a pointer to it, or NULL if unable to allocate memory.
+ *******************************************************************/
+static Plsb_checkpoint * add_checkpoint( Plsb_index * pX )
+{
+	Plsb_checkpoint * pCP;
+
+	if( pX->count == pX->capacity )
+	{
+		Plsb_checkpoint * pNew;
+		size_t new_cap;
+
+		new_cap = pX->capacity > 0 ? pX->capacity * 2 : 64;
+
+		if( NULL == pX->points )
+			pNew = allocMemory( new_cap * sizeof( Plsb_checkpoint ) );
+		else
+			pNew = resizeMemory( pX->points,
+				new_cap * sizeof( Plsb_checkpoint ) );
+
+		if( NULL == pNew )
+			return NULL;
+
+		pX->points = pNew;
+		pX->capacity = new_cap;
+	}
+
+	pCP = pX->points + pX->count++;
+	pCP->levels = NULL;
+	pCP->level_count = 0;
+	return pCP;
+}
+
+/********************************************************************
+ save_state -- record the state of a Plsb_context in a checkpoint.
+ *******************************************************************/
+static int save_state( const Plsb_context * pC, Plsb_checkpoint * pCP )
+{
+	const Syntax_level * pSL;
+	int count = 0;
+	int i;
+
+	pCP->indentation = pC->indentation;
+	pCP->deferred_unindents = pC->deferred_unindents;
+	pCP->type_top = pC->type_top;
+	for( i = 0; i <= pC->type_top && i < TYPESTACK_DEPTH; ++i )
+		pCP->typestack[ i ] = pC->typestack[ i ];
+
+	pCP->curr_level = pC->curr_level;
+	pCP->curr_level.pNext = NULL;
+
+	for( pSL = pC->level_stack; pSL != NULL; pSL = pSL->pNext )
+		++count;
+
+	pCP->level_count = count;
+	pCP->levels = NULL;
+	if( 0 == count )
+		return OKAY;
+
+	pCP->levels = allocMemory( count * sizeof( Syntax_level ) );
+	if( NULL == pCP->levels )
+	{
+		pCP->level_count = 0;
+		return ERROR_FOUND;
+	}
+
+	for( pSL = pC->level_stack, i = 0; pSL != NULL; pSL = pSL->pNext, ++i )
+	{
+		pCP->levels[ i ] = *pSL;
+		pCP->levels[ i ].pNext = NULL;
+	}
+
+	return OKAY;
+}
+
+/********************************************************************
+ restore_state -- put a freshly initialized Plsb_context into the
+ state recorded in a checkpoint.
+ *******************************************************************/
+static int restore_state( Plsb_context * pC, const Plsb_checkpoint * pCP )
+{
+	int i;
+
+	pC->indentation = pCP->indentation;
+	pC->deferred_unindents = pCP->deferred_unindents;
+	pC->type_top = pCP->type_top;
+	for( i = 0; i <= pCP->type_top && i < TYPESTACK_DEPTH; ++i )
+		pC->typestack[ i ] = pCP->typestack[ i ];
+
+	/* Push the stacked levels from the bottom up */
+
+	for( i = pCP->level_count - 1; i >= 0; --i )
+	{
+		pC->curr_level = pCP->levels[ i ];
+		if( push_level( pC ) != OKAY )
+			return ERROR_FOUND;
+	}
+
+	pC->curr_level = pCP->curr_level;
+	pC->curr_level.pNext = NULL;
+
+	return OKAY;
+}
+
+/********************************************************************
+ same_state -- return TRUE if a Plsb_context is in the state recorded
+ in a checkpoint.
+ *******************************************************************/
+static int same_state( const Plsb_context * pC,
+	const Plsb_checkpoint * pCP )
+{
+	const Syntax_level * pSL;
+	int i;
+
+	if( pC->indentation != pCP->indentation ||
+		pC->deferred_unindents != pCP->deferred_unindents ||
+		pC->type_top != pCP->type_top ||
+		pC->curr_level.s_type != pCP->curr_level.s_type ||
+		pC->curr_level.state != pCP->curr_level.state ||
+		pC->curr_level.indents_count != pCP->curr_level.indents_count ||
+		pC->curr_level.parens_count != pCP->curr_level.parens_count )
+		return FALSE;
+
+	for( i = 0; i <= pC->type_top && i < TYPESTACK_DEPTH; ++i )
+		if( pC->typestack[ i ] != pCP->typestack[ i ] )
+			return FALSE;
+
+	for( pSL = pC->level_stack, i = 0; pSL != NULL; pSL = pSL->pNext, ++i )
+	{
+		if( i >= pCP->level_count ||
+			pSL->s_type != pCP->levels[ i ].s_type ||
+			pSL->state != pCP->levels[ i ].state ||
+			pSL->indents_count != pCP->levels[ i ].indents_count ||
+			pSL->parens_count != pCP->levels[ i ].parens_count )
+			return FALSE;
+	}
+
+	return i == pCP->level_count;
+}
+
+/********************************************************************
+ advance -- starting from offset pos, the start of line *pLine, skip
+ ahead to the start of line upto (or to the end of the input).  Update
+ *pLine, and return the new offset.
+ *******************************************************************/
+static size_t advance( const char * in, size_t len, size_t pos,
+	int * pLine, int upto )
+{
+	while( *pLine < upto && pos < len )
+	{
+		const char * p;
+
+		p = memchr( in + pos, '\n', len - pos );
+		if( NULL == p )
+			pos = len;
+		else
+			pos = (size_t) ( p - in ) + 1;
+		++*pLine;
+	}
+
+	return pos;
+}
+
+/********************************************************************
+ last_line -- return the number of the last input line holding any
+ part of a logical line, not counting the end of file.
+ *******************************************************************/
+static int last_line( const Toklist * pTL )
+{
+	const Toknode * pTN;
+
+	pTN = pTL->pLast;
+	if( T_eof == pTN->type && PREV_NODE( pTN ) != NULL )
+		pTN = PREV_NODE( pTN );
+
+	return pTN->pT->line + (int) pTN->pT->extra_lines;
+}
+
+/********************************************************************
+ plsb_index_save -- write an index to a file, as text.  We write a
+ temporary file and rename it, so that a reader never sees a partial
+ index.
+
+ The first line holds a magic string, the key, the length of the
+ input, and the number of checkpoints.  Each checkpoint follows on a
+ line of its own: the line number, offset, hash, whether fixed, the
+ indentation, the pending unindents, the top of the type stack and
+ the types on it, the current syntax level, and the number of levels
+ on the stack followed by the levels, from the top.  A syntax level
+ is written as four numbers: its type, state, indents, and parens.
+ *******************************************************************/
+int plsb_index_save( const Plsb_index * pX, const char * path )
+{
+	static const char tmp_suffix[] = ".plsbXXXXXX";
+	int rc = OKAY;
+	int fd;
+	char * tmp_name;
+	size_t path_len;
+	size_t i;
+	Ofile out;
+	char buf[ 96 ];
+
+	ASSERT( pX != NULL );
+	ASSERT( path != NULL );
+	if( NULL == pX || NULL == path )
+		return ERROR_FOUND;
+
+	path_len = strlen( path );
+	tmp_name = allocMemory( path_len + sizeof tmp_suffix );
+	if( NULL == tmp_name )
+		return ERROR_FOUND;
+
+	memcpy( tmp_name, path, path_len );
+	memcpy( tmp_name + path_len, tmp_suffix, sizeof tmp_suffix );
+
+	fd = mkstemp( tmp_name );
+	if( fd < 0 )
+	{
+		freeMemory( tmp_name );
+		return ERROR_FOUND;
+	}
+
+	out = o_fd( fd );
+	if( NULL == out.p )
+		rc = ERROR_FOUND;
+	else
+	{
+		(void) o_puts( out, INDEX_MAGIC " " );
+		(void) write_key( out, pX->key );
+		sprintf( buf, " %lu %lu\n", (unsigned long) pX->len,
+			(unsigned long) pX->count );
+		(void) o_puts( out, buf );
+
+		for( i = 0; i < pX->count; ++i )
+		{
+			const Plsb_checkpoint * pCP = pX->points + i;
+			const Syntax_level * pSL;
+			int j;
+
+			sprintf( buf, "%d %lu ", pCP->line,
+				(unsigned long) pCP->offset );
+			(void) o_puts( out, buf );
+			(void) write_key( out, pCP->hash );
+			sprintf( buf, " %d %d %d %d", pCP->fixed ? 1 : 0,
+				pCP->indentation, pCP->deferred_unindents, pCP->type_top );
+			(void) o_puts( out, buf );
+
+			for( j = 0; j <= pCP->type_top && j < TYPESTACK_DEPTH; ++j )
+			{
+				sprintf( buf, " %d", (int) pCP->typestack[ j ] );
+				(void) o_puts( out, buf );
+			}
+
+			for( j = -1; j < pCP->level_count; ++j )
+			{
+				pSL = j < 0 ? &pCP->curr_level : pCP->levels + j;
+				sprintf( buf, " %d %d %d %d", (int) pSL->s_type,
+					(int) pSL->state, pSL->indents_count,
+					pSL->parens_count );
+				(void) o_puts( out, buf );
+
+				if( j < 0 )
+				{
+					sprintf( buf, " %d", pCP->level_count );
+					(void) o_puts( out, buf );
+				}
+			}
+
+			(void) o_putc( out, '\n' );
+		}
+
+		if( o_close( &out ) != OKAY )
+			rc = ERROR_FOUND;
+	}
+
+	if( close( fd ) != 0 )
+		rc = ERROR_FOUND;
+
+	if( OKAY == rc && rename( tmp_name, path ) != 0 )
+		rc = ERROR_FOUND;
+
+	if( rc != OKAY )
+		(void) remove( tmp_name );
+
+	freeMemory( tmp_name );
+	return rc;
+}
+
+/********************************************************************
+ plsb_index_load -- replace the contents of an index with those of a
+ file written by plsb_index_save().  If the file can't be read, or
+ doesn't make sense, return ERROR_FOUND and leave the index empty.
+ *******************************************************************/
+int plsb_index_load( Plsb_index * pX, const char * path )
+{
+	int rc = OKAY;
+	FILE * pF;
+	char magic[ sizeof( INDEX_MAGIC ) ];
+	unsigned long len;
+	unsigned long count;
+	unsigned long i;
+
+	ASSERT( pX != NULL );
+	ASSERT( path != NULL );
+	if( NULL == pX || NULL == path )
+		return ERROR_FOUND;
+
+	plsb_index_free( pX );
+
+	pF = fopen( path, "r" );
+	if( NULL == pF )
+		return ERROR_FOUND;
+
+	if( fscanf( pF, "%16s", magic ) != 1 ||
+		strcmp( magic, INDEX_MAGIC ) != 0 ||
+		read_key( pF, &pX->key ) != OKAY ||
+		fscanf( pF, "%lu %lu", &len, &count ) != 2 )
+		rc = ERROR_FOUND;
+	else
+		pX->len = len;
+
+	for( i = 0; OKAY == rc && i < count; ++i )
+	{
+		Plsb_checkpoint * pCP;
+		unsigned long offset;
+		int fixed;
+		int types;
+		int j;
+
+		pCP = add_checkpoint( pX );
+		if( NULL == pCP ||
+			fscanf( pF, "%d %lu", &pCP->line, &offset ) != 2 ||
+			read_key( pF, &pCP->hash ) != OKAY ||
+			fscanf( pF, "%d %d %d %d", &fixed, &pCP->indentation,
+				&pCP->deferred_unindents, &pCP->type_top ) != 4 ||
+			pCP->type_top < -1 || offset > len ||
+			( i > 0 && offset <= pX->points[ i - 1 ].offset ) )
+		{
+			rc = ERROR_FOUND;
+			break;
+		}
+
+		pCP->offset = offset;
+		pCP->fixed = fixed ? TRUE : FALSE;
+
+		types = pCP->type_top + 1;
+		if( types > TYPESTACK_DEPTH )
+			types = TYPESTACK_DEPTH;
+
+		for( j = 0; j < types; ++j )
+		{
+			int type;
+
+			if( fscanf( pF, "%d", &type ) != 1 )
+			{
+				rc = ERROR_FOUND;
+				break;
+			}
+			pCP->typestack[ j ] = (Pls_token_type) type;
+		}
+
+		for( j = -1; OKAY == rc && j < pCP->level_count; ++j )
+		{
+			Syntax_level * pSL;
+			int s_type;
+			int state;
+
+			pSL = j < 0 ? &pCP->curr_level : pCP->levels + j;
+			if( fscanf( pF, "%d %d %d %d", &s_type, &state,
+				&pSL->indents_count, &pSL->parens_count ) != 4 )
+			{
+				rc = ERROR_FOUND;
+				break;
+			}
+			pSL->s_type = (Syntax_type) s_type;
+			pSL->state = (S_state) state;
+			pSL->pNext = NULL;
+
+			if( j < 0 )
+			{
+				int levels;
+
+				if( fscanf( pF, "%d", &levels ) != 1 || levels < 0 ||
+					levels > 10000 )
+					rc = ERROR_FOUND;
+				else if( levels > 0 )
+				{
+					pCP->levels = allocMemory( levels *
+						sizeof( Syntax_level ) );
+					if( NULL == pCP->levels )
+						rc = ERROR_FOUND;
+					else
+						pCP->level_count = levels;
+				}
+			}
+		}
+	}
+
+	if( ferror( pF ) )
+		rc = ERROR_FOUND;
+	fclose( pF );
+
+	if( rc != OKAY )
+		plsb_index_free( pX );
+
+	return rc;
+}
+
+/********************************************************************
+ write_key -- write a 64-bit hash as 16 hex digits.
+ *******************************************************************/
+static int write_key( Ofile out, uint64_t key )
+{
+	char buf[ KEY_LEN + 1 ];
+
+	sprintf( buf, "%08lx%08lx",
+		(unsigned long) ( key >> 32 ),
+		(unsigned long) ( key & 0xffffffffUL ) );
+	return o_puts( out, buf );
+}
+
+/********************************************************************
+ read_key -- read a 64-bit hash written by write_key().
+ *******************************************************************/
+static int read_key( FILE * pF, uint64_t * pKey )
+{
+	char buf[ KEY_LEN + 1 ];
+	uint64_t key = 0;
+	int i;
+
+	if( fscanf( pF, "%16s", buf ) != 1 || strlen( buf ) != KEY_LEN )
+		return ERROR_FOUND;
+
+	for( i = 0; i < KEY_LEN; ++i )
+	{
+		int c = buf[ i ];
+
+		if( c >= '0' && c <= '9' )
+			key = key * 16 + (uint64_t) ( c - '0' );
+		else if( c >= 'a' && c <= 'f' )
+			key = key * 16 + (uint64_t) ( c - 'a' + 10 );
+		else
+			return ERROR_FOUND;
+	}
+
+	*pKey = key;
+	return OKAY;
+}
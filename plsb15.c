@@ -0,0 +1,248 @@
+/* plsb15.c -- routines for a cache of inputs known to be formatted
+   already.
+
+   Most of the time, most of the files checked by plsb --check have not
+   changed since the last check, and were already formatted then.  So
+   whenever we find that an input comes out of the beautifier unchanged
+   -- that it is a fixed point -- we record the fact in a directory, as
+   an empty file named for a hash of the input, the options, and the
+   version of the beautifier.  Next time, if the file is there, we know
+   the answer without beautifying the input again.  Lest two inputs with
+   the same hash share an entry, the name also includes the length of
+   the input and a second, independent hash.
+
+   The cache is disabled unless the client code or the environment
+   names a directory for it.  Each entry is created under a temporary
+   name and then renamed, so that concurrent processes never see one
+   half made.  The entries are empty, so we don't bother to evict any;
+   to clear the cache, remove the directory.
+
+   Like plstok05.c, this module uses some POSIX functions for managing
+   the directory.
+
+   Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+   This program is open software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "ofile.h"
+#include "plsb.h"
+
+#define FIXED_SUFFIX ".fix"
+#define NAME_LEN 50		/* three hex numbers of 16 digits, and two '-' */
+
+/* Mixed into the hash, so that a change to the beautifier or to the */
+/* options yields a different file name.  Bump the version whenever */
+/* the output of the beautifier changes.                             */
+
+#define FIXED_SALT "plsb fixed points 1"
+
+static Mutex config_lock = MUTEX_INITIALIZER;	/* guards the settings */
+static int configured = FALSE;
+static char cache_dir[ FILENAME_MAX ] = "";		/* empty if disabled */
+
+static int cache_enabled( void );
+static void entry_name( char * name, const char * text, size_t len,
+	const Plsb_options * pOpt );
+static char * entry_path( const char * name, const char * suffix );
+
+/********************************************************************
+ plsb_cache_config -- name the directory for the cache of fixed
+ points.  A NULL directory disables the cache.  This call overrides
+ the environment variable PLSB_CACHE.
+ *******************************************************************/
+int plsb_cache_config( const char * dir )
+{
+	int rc = OKAY;
+
+	lockMutex( &config_lock );
+
+	configured = TRUE;
+	cache_dir[ 0 ] = '\0';
+
+	if( dir != NULL )
+	{
+		/* Leave room for the file name within the directory */
+
+		if( strlen( dir ) + NAME_LEN + 32 >= sizeof( cache_dir ) )
+			rc = ERROR_FOUND;
+		else
+			strcpy( cache_dir, dir );
+	}
+
+	unlockMutex( &config_lock );
+	return rc;
+}
+
+/********************************************************************
+ plsb_cache_fixed -- return TRUE if the cache says that len bytes of
+ text come out of the beautifier unchanged, using the specified
+ options (NULL for the defaults).  Return FALSE if they don't, if we
+ don't know, or if the cache is disabled.
+ *******************************************************************/
+int plsb_cache_fixed( const char * text, size_t len,
+	const Plsb_options * pOpt )
+{
+	char name[ NAME_LEN + 1 ];
+	char * path;
+	struct stat st;
+	int found;
+
+	ASSERT( text != NULL || 0 == len );
+	if( ( NULL == text && len > 0 ) || ! cache_enabled() )
+		return FALSE;
+
+	entry_name( name, text, len, pOpt );
+	path = entry_path( name, FIXED_SUFFIX );
+	if( NULL == path )
+		return FALSE;
+
+	found = 0 == stat( path, &st ) && S_ISREG( st.st_mode );
+
+	freeMemory( path );
+	return found;
+}
+
+/********************************************************************
+ plsb_cache_record -- note in the cache that len bytes of text come
+ out of the beautifier unchanged, using the specified options.  The
+ caller must have made sure of it.  Failure to record is harmless,
+ except to performance, so we don't report it.
+ *******************************************************************/
+void plsb_cache_record( const char * text, size_t len,
+	const Plsb_options * pOpt )
+{
+	static const char tmp_suffix[] = ".tmpXXXXXX";
+	char name[ NAME_LEN + 1 ];
+	char * path;
+	char * tmp_path;
+	int fd;
+
+	ASSERT( text != NULL || 0 == len );
+	if( ( NULL == text && len > 0 ) || ! cache_enabled() )
+		return;
+
+	(void) mkdir( cache_dir, 0777 );
+
+	entry_name( name, text, len, pOpt );
+	path     = entry_path( name, FIXED_SUFFIX );
+	tmp_path = entry_path( name, tmp_suffix );
+
+	if( path != NULL && tmp_path != NULL )
+	{
+		fd = mkstemp( tmp_path );
+		if( fd >= 0 )
+		{
+			if( close( fd ) != 0 || rename( tmp_path, path ) != 0 )
+				(void) remove( tmp_path );
+		}
+	}
+
+	if( path != NULL )
+		freeMemory( path );
+	if( tmp_path != NULL )
+		freeMemory( tmp_path );
+}
+
+/********************************************************************
+ cache_enabled -- return TRUE if there is a cache directory, looking
+ it up in the environment if the client code hasn't named one.
+ *******************************************************************/
+static int cache_enabled( void )
+{
+	int enabled;
+
+	lockMutex( &config_lock );
+
+	if( ! configured )
+	{
+		const char * dir;
+
+		configured = TRUE;
+		dir = getenv( "PLSB_CACHE" );
+		if( dir != NULL &&
+			strlen( dir ) + NAME_LEN + 32 < sizeof( cache_dir ) )
+			strcpy( cache_dir, dir );
+	}
+
+	enabled = cache_dir[ 0 ] != '\0';
+
+	unlockMutex( &config_lock );
+	return enabled;
+}
+
+/********************************************************************
+ entry_name -- build the name of the cache entry for a given text and
+ options: a hash of them, a second hash computed in a different way,
+ and the length of the text, all in hex.  The buffer must have room
+ for NAME_LEN characters and a terminal nul.
+ *******************************************************************/
+static void entry_name( char * name, const char * text, size_t len,
+	const Plsb_options * pOpt )
+{
+	uint64_t key;
+	uint64_t check;
+	uint64_t len64 = (uint64_t) len;
+	const char * indent_string = "    ";
+
+	if( pOpt != NULL && pOpt->indent_string != NULL )
+		indent_string = pOpt->indent_string;
+
+	if( NULL == text )
+		text = "";
+
+	key = pls_hash( text, len, PLS_HASH_INIT );
+	key = pls_hash( FIXED_SALT, sizeof( FIXED_SALT ), key );
+	key = pls_hash( indent_string, strlen( indent_string ) + 1, key );
+
+	check = pls_check_hash( text, len, PLS_CHECK_INIT );
+	check = pls_check_hash( FIXED_SALT, sizeof( FIXED_SALT ), check );
+	check = pls_check_hash( indent_string, strlen( indent_string ) + 1,
+		check );
+
+	sprintf( name, "%08lx%08lx-%08lx%08lx-%08lx%08lx",
+		(unsigned long) ( key >> 32 ),
+		(unsigned long) ( key & 0xffffffffUL ),
+		(unsigned long) ( check >> 32 ),
+		(unsigned long) ( check & 0xffffffffUL ),
+		(unsigned long) ( len64 >> 32 ),
+		(unsigned long) ( len64 & 0xffffffffUL ) );
+}
+
+/********************************************************************
+ entry_path -- build the path of the cache entry with a given name
+ and suffix, in dynamically allocated memory.  Return NULL if unable
+ to allocate memory.
+ *******************************************************************/
+static char * entry_path( const char * name, const char * suffix )
+{
+	char * path;
+
+	path = allocMemory( strlen( cache_dir ) + strlen( name )
+		+ strlen( suffix ) + 2 );
+	if( path != NULL )
+		sprintf( path, "%s/%s%s", cache_dir, name, suffix );
+
+	return path;
+}
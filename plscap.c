@@ -25,9 +25,16 @@
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
+#include "ofile.h"
+
+#define STREAM_THRESHOLD 65536
+
+static Ofile out;
 
 static int capitalize( Sfile s );
 static void str_tolower( char * s );
+static void forward_text( void * p, Pls_stream_event event,
+	const Pls_tok * pT, const char * text, size_t len );
 
 int main( int argc, char * argv[] )
 {
@@ -48,7 +55,7 @@ int main( int argc, char * argv[] )
 		}
 	}
 
-	s = s_assign( pIn );
+	s = pls_cache_open( pIn );
 	if( NULL == s.p )
 	{
 		fprintf( stderr, "Unable to assign an Sfile\n" );
@@ -57,8 +64,29 @@ int main( int argc, char * argv[] )
 		return EXIT_FAILURE;
 	}
 
+	out = o_assign( stdout );
+	if( NULL == out.p )
+	{
+		fprintf( stderr, "Unable to assign an Ofile\n" );
+		s_close( &s );
+		if( pIn != stdin )
+			fclose( pIn );
+		return EXIT_FAILURE;
+	}
+
+	/* Literals and comments pass through unchanged, so the big */
+	/* ones can go straight to the output without being stored. */
+
+	(void) pls_stream( forward_text, &out, STREAM_THRESHOLD );
+
 	rc = capitalize( s );
 
+	if( o_close( &out ) != OKAY )
+	{
+		fprintf( stderr, "Error writing output\n" );
+		rc = ERROR_FOUND;
+	}
+
 	s_close( &s );
 	if( pIn != stdin )
 		fclose( pIn );
@@ -76,6 +104,7 @@ static int capitalize( Sfile s )
 {
 	int rc = OKAY;
 	int finished = FALSE;
+	int warm = FALSE;
 	Pls_tok * pT;
 
 	while( FALSE == finished )
@@ -92,8 +121,11 @@ static int capitalize( Sfile s )
 		{
 			if( T_identifier == pT->type )
 			{
-				str_tolower( pT->buf );
-				pls_write_text( pT, stdout );
+				/* Most identifiers are already in lower case */
+
+				if( pT->flags & PLS_TF_UPPER )
+					str_tolower( pT->buf );
+				pls_emit_text( pT, forward_text, &out );
 			}
 			else if( T_eof == pT->type )
 				finished = TRUE;
@@ -106,13 +138,13 @@ static int capitalize( Sfile s )
 
 				pKeyword = pls_keyword_name( pT->type );
 				if( '\0' == pKeyword[ 0 ] )
-					pls_write_text( pT, stdout );
+					pls_emit_text( pT, forward_text, &out );
 				else
-					fputs( pKeyword, stdout );
+					(void) o_puts( out, pKeyword );
 
 				if( T_error == pT->type )
 				{
-					fflush( stdout );
+					(void) o_flush( out );
 					fprintf( stderr, "\nERROR at line %d, column %d: %s\n",
 						pT->line, pT->col, pT->msg );
 					fflush( stderr );
@@ -120,6 +152,15 @@ static int capitalize( Sfile s )
 			}
 
 			pls_free_tok( &pT );
+
+			/* Having recycled one token, we shouldn't need the heap again */
+
+			if( ! warm )
+			{
+				(void) pls_reserve();
+				markSteadyState();
+				warm = TRUE;
+			}
 		}
 	}
 
@@ -138,4 +179,19 @@ static void str_tolower( char * s )
 		for( ; *s != NULL; ++s )
 			*s = tolower( (unsigned char) *s );
 	}
-}
\ No newline at end of file
+}
+
+/**********************************************************************
+ forward_text -- stream sink: write each segment to the Ofile pointed
+ to by p as it arrives.  We use it both for oversized literals and
+ comments, which leave the token with no text left to write, and for
+ writing the text of ordinary tokens through pls_emit_text().
+ *********************************************************************/
+static void forward_text( void * p, Pls_stream_event event,
+	const Pls_tok * pT, const char * text, size_t len )
+{
+	(void) pT;
+
+	if( PLS_STREAM_SEGMENT == event )
+		(void) o_write( *(Ofile *) p, text, len );
+}
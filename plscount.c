@@ -48,7 +48,12 @@ int main( int argc, char * argv[] )
 		}
 	}
 
-	s = s_assign( pIn );
+	/* suppress white space and comments (before opening, since */
+	/* the setting is part of the key for the token cache)      */
+
+	(void) pls_nopreserve();
+
+	s = pls_cache_open( pIn );
 	if( NULL == s.p )
 	{
 		fprintf( stderr, "Unable to assign an Sfile\n" );
@@ -57,10 +62,6 @@ int main( int argc, char * argv[] )
 		return EXIT_FAILURE;
 	}
 
-	/* suppress white space and comments */
-
-	(void) pls_nopreserve();
-
 	/* count tokens */
 
 	rc = plscount( s, &count );
@@ -104,6 +105,14 @@ static int plscount( Sfile s, unsigned long *pCount )
 
 		pls_free_tok( &pT );
 
+		/* Having recycled one token, we shouldn't need the heap again */
+
+		if( 1L == count )
+		{
+			(void) pls_reserve();
+			markSteadyState();
+		}
+
 	} while( curr_type != T_eof );
 
 	if( OKAY == rc )
@@ -47,7 +47,12 @@ int main( int argc, char * argv[] )
 		}
 	}
 
-	s = s_assign( pIn );
+	/* suppress white space and comments (before opening, since */
+	/* the setting is part of the key for the token cache)      */
+
+	(void) pls_nopreserve();
+
+	s = pls_cache_open( pIn );
 	if( NULL == s.p )
 	{
 		fprintf( stderr, "Unable to assign an Sfile\n" );
@@ -56,10 +61,6 @@ int main( int argc, char * argv[] )
 		return EXIT_FAILURE;
 	}
 
-	/* suppress white space and comments */
-
-	(void) pls_nopreserve();
-
 	/* look for comparisons to null */
 
 	rc = plsenull( s );
@@ -84,6 +85,7 @@ static int plsenull( Sfile s )
 	Pls_token_type curr_type = T_none;
 	Pls_token_type prev_type;
 	Pls_tok * pT;
+	int warm = FALSE;
 
 	do
 	{
@@ -138,6 +140,15 @@ static int plsenull( Sfile s )
 
 		pls_free_tok( &pT );
 
+		/* Having recycled one token, we shouldn't need the heap again */
+
+		if( ! warm )
+		{
+			(void) pls_reserve();
+			markSteadyState();
+			warm = TRUE;
+		}
+
 	} while( curr_type != T_eof );
 
 	return rc;
@@ -21,14 +21,32 @@
 #ifndef PLSPRIV_H
 #define PLSPRIV_H
 
+/* Internal flag: the text so far ends with a newline */
+
+#define PLS_TF_PENDING_NL 0x8000
+
+/* State of an Sfile opened by pls_cache_open(); see plstok05.c */
+
+typedef struct pls_cache Pls_cache;
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
 
 int pls_append_msg( Pls_tok * pT, const char * str );
 int pls_append_text( Pls_tok * pT, const char * str );
+void pls_scan_text( Pls_tok * pT, const char * str, size_t len );
+void pls_drain_text( Pls_tok * pT, Pls_stream_func func, void * p );
+int pls_stream_hold( int hold );
+int pls_recovering( void );
+Pls_diag_code pls_diag_lookup( const char * msg );
 Pls_token_type pls_keyword( const char * s );
+void pls_num_scan( Pls_tok * pT, const char * text );
 Pls_tok * pls_alloc_tok( void );
+void pls_reset_tok( Pls_tok * pT );
+int pls_cache_replaying( const Pls_cache * pC );
+Pls_tok * pls_cache_next( Pls_cache * pC );
+void pls_cache_record( Pls_cache * pC, const Pls_tok * pT );
 
 #ifdef __cplusplus
 	};
@@ -26,8 +26,6 @@
 #include "sfile.h"
 #include "plstok.h"
 
-static char litbuf[ 501 ];
-
 static int plsqlf( Sfile s );
 
 int main( int argc, char * argv[] )
@@ -49,7 +47,12 @@ int main( int argc, char * argv[] )
 		}
 	}
 
-	s = s_assign( pIn );
+	/* suppress white space and comments (before opening, since */
+	/* the setting is part of the key for the token cache)      */
+
+	(void) pls_nopreserve();
+
+	s = pls_cache_open( pIn );
 	if( NULL == s.p )
 	{
 		fprintf( stderr, "Unable to assign an Sfile\n" );
@@ -58,10 +61,6 @@ int main( int argc, char * argv[] )
 		return EXIT_FAILURE;
 	}
 
-	/* suppress white space and comments */
-
-	(void) pls_nopreserve();
-
 	/* look for literals containing line feeds */
 
 	rc = plsqlf( s );
@@ -78,22 +77,15 @@ int main( int argc, char * argv[] )
 
 /********************************************************************
  parse -- main loop looking for string or character literals which
- contain line feeds.
-
- We take a short cut here -- if a string literal has its first line
- feed only after 500 characters, we'll miss it.  That's a reasonable
- risk to take.  Few people will code anything that long on a single
- line.
-
- If you really want to be perfectionist you can use pls_tok_size()
- to determine the string length, and then dynamically allocate a
- sufficiently large buffer.
+ contain line feeds.  The lexer flags such literals for us, so we
+ needn't examine the text, however long it may be.
  *******************************************************************/
 static int plsqlf( Sfile s )
 {
 	int rc = OKAY;
 	Pls_token_type type;
 	Pls_tok * pT;
+	int warm = FALSE;
 
 	/* Examine each token */
 
@@ -111,8 +103,7 @@ static int plsqlf( Sfile s )
 		switch( type )
 		{
 			case T_string_lit :
-				pls_copy_text( pT, litbuf, sizeof( litbuf ) );
-				if( strchr( litbuf, '\n' ) != NULL )
+				if( pT->flags & PLS_TF_NEWLINE )
 				{
 					fprintf( stderr, "Line %d, column %d: "
 						"String literal containing line feed\n",
@@ -121,7 +112,7 @@ static int plsqlf( Sfile s )
 				}
 				break;
 			case T_char_lit :
-				if( '\n' == pT->buf[ 1 ] )
+				if( pT->flags & PLS_TF_NEWLINE )
 				{
 					fprintf( stderr, "Line %d, column %d: "
 						"Character literal containing line feed\n",
@@ -135,6 +126,15 @@ static int plsqlf( Sfile s )
 
 		pls_free_tok( &pT );
 
+		/* Having recycled one token, we shouldn't need the heap again */
+
+		if( ! warm )
+		{
+			(void) pls_reserve();
+			markSteadyState();
+			warm = TRUE;
+		}
+
 	} while( type != T_eof );
 
 	return rc;
@@ -22,6 +22,7 @@
 #define PLSTOK_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include "sfile.h"
 
 typedef enum
@@ -36,6 +37,7 @@ typedef enum
 	T_identifier,
 	T_remark,
 	T_whitespace,
+	T_wrapped,		/* body of a wrapped unit */
 
 	/* single-character punctuation (we don't isolate */
 	/* single or double quotes as separate tokens):   */
@@ -306,6 +308,61 @@ typedef enum
 						 /* surrounding a quoted identifier */
 #define PLS_BUFLEN (PLS_MAX_WORD + 1)
 
+/* Codes for lexical errors.  An error token carries one of these in its */
+/* diag member, and a recovering lexer records them in a Pls_diaglist.   */
+
+typedef enum
+{
+	PLS_E_NONE,
+	PLS_E_UNEXPECTED_CHAR,		/* character can't begin any token */
+	PLS_E_WORD_TOO_LONG,		/* identifier is too long */
+	PLS_E_UNTERMINATED_STRING,	/* string or character literal */
+	PLS_E_LONE_BANG,			/* '!' not followed by '=' */
+	PLS_E_LONE_TILDE,			/* '~' not followed by '=' */
+	PLS_E_LONE_HAT,				/* '^' not followed by '=' */
+	PLS_E_LONE_BAR,				/* '|' not followed by '|' */
+	PLS_E_BAD_PUNCT,			/* unrecognized punctuation */
+	PLS_E_UNTERMINATED_COMMENT,	/* C-style comment */
+	PLS_E_UNTERMINATED_QUOTED_ID,
+	PLS_E_QUOTED_ID_TOO_LONG,
+	PLS_E_BAD_NUMBER,			/* invalid numeric literal */
+	PLS_E_COUNT					/* not a code; how many codes there are */
+} Pls_diag_code;
+
+/* A diagnostic recorded by a recovering lexer (see pls_recover()) */
+
+typedef struct
+{
+	uint32_t offset;	/* byte offset of the offending text */
+	uint32_t length;	/* its length in bytes */
+	uint16_t code;		/* a Pls_diag_code */
+} Pls_diag;
+
+/* The client code supplies the array; the lexer never allocates it. */
+
+typedef struct
+{
+	Pls_diag * diags;
+	size_t capacity;	/* number of elements in diags */
+	size_t count;		/* how many diagnostics are recorded */
+	unsigned long lost;	/* how many more didn't fit */
+} Pls_diaglist;
+
+/* The parts of the value of a numeric literal, as collected by the */
+/* lexer.  Use pls_num_value() to put them together.                 */
+
+#define PLS_NUM_DIGITS 19	/* significant digits kept in a Pls_num */
+
+typedef struct
+{
+	uint64_t digits;	/* leading significant digits of the mantissa */
+	long scale;			/* power of ten by which to scale the digits */
+	long expo;			/* magnitude of the exponent */
+	unsigned char count;	/* how many digits are in the digits member */
+	unsigned char neg_expo;	/* boolean: the exponent is negative */
+	unsigned char inexact;	/* boolean: digits were lost */
+} Pls_num;
+
 struct pls_tok
 {
 	Pls_token_type type;
@@ -316,24 +373,161 @@ struct pls_tok
 	void * pChunk;
 	void * pLast;
 	char  * msg;
+	unsigned flags;		/* PLS_TF_* bits, below */
+	unsigned extra_lines;	/* how many lines the text continues onto */
+	uint64_t hash;		/* pls_hash() of the text */
+	Pls_num num;		/* for T_num_lit: parts of the value */
+	Pls_diag_code diag;	/* for T_error: what went wrong */
 };
 
+/* Attributes of a token's text, noted by the lexer as it goes.  These  */
+/* bits don't overlap the PLS_CF_* bits below, so that a Pls_ctok can   */
+/* carry both. */
+
+#define PLS_TF_NEWLINE   0x0002	/* contains a newline */
+#define PLS_TF_MULTILINE 0x0004	/* continues after a newline */
+#define PLS_TF_LOWER     0x0008	/* contains a lower case letter */
+#define PLS_TF_UPPER     0x0010	/* contains an upper case letter */
+#define PLS_TF_DQUOTE    0x0020	/* literal contains a doubled quote */
+#define PLS_TF_HYPHEN    0x0080	/* "--" comment, ending with a newline */
+#define PLS_TF_ALL       0x00BE	/* all of the above */
+#define PLS_TF_STREAMED  0x0040	/* text went to the stream sink instead */
+
+/* Events delivered to a stream sink (see pls_stream()) for a token whose */
+/* text is too big to hold in memory. */
+
+typedef enum
+{
+	PLS_STREAM_BEGIN,		/* token begins; no text yet */
+	PLS_STREAM_SEGMENT,		/* the next piece of the token's text */
+	PLS_STREAM_END			/* token is complete */
+} Pls_stream_event;
+
+typedef void (* Pls_stream_func)( void * p, Pls_stream_event event,
+	const struct pls_tok * pT, const char * text, size_t len );
+
 typedef struct pls_tok Pls_tok;
 
+/* A Pls_ctok is a compact, fixed-size (16 byte) record of a token, for  */
+/* client code which must hold a great many tokens in memory at once.    */
+/* It carries no text of its own.  Instead it points into a side store   */
+/* owned by the Pls_tokvec which contains it.  Each token's text is      */
+/* stored there with a terminal nul; if the PLS_CF_MSG flag is set, the  */
+/* token's error message follows immediately, also with a terminal nul.  */
+
+/* The line and column share a single member.  A line or column too big  */
+/* to fit is stored as the largest value that does fit. */
+
+typedef struct
+{
+	uint16_t type;		/* a Pls_token_type */
+	uint16_t flags;		/* PLS_CF_* and PLS_TF_* bits */
+	uint32_t offset;	/* where the text starts within the side store */
+	uint32_t length;	/* length of the text, not counting nul */
+	uint32_t pos;		/* line and column, packed */
+} Pls_ctok;
+
+#define PLS_CF_MSG 0x0001	/* an error message follows the text */
+
+#define PLS_CTOK_COL_BITS 12
+#define PLS_CTOK_MAX_COL  ( ( 1UL << PLS_CTOK_COL_BITS ) - 1 )
+#define PLS_CTOK_MAX_LINE ( ( 1UL << ( 32 - PLS_CTOK_COL_BITS ) ) - 1 )
+#define PLS_CTOK_LINE(p)  ( (int) ( (p)->pos >> PLS_CTOK_COL_BITS ) )
+#define PLS_CTOK_COL(p)   ( (int) ( (p)->pos & PLS_CTOK_MAX_COL ) )
+
+/* A growable vector of Pls_ctoks, together with the side store for */
+/* their text.  Client code may read the members directly, but      */
+/* should change them only through the pls_tokvec functions. */
+
+typedef struct
+{
+	Pls_ctok * toks;
+	size_t count;		/* how many tokens in use */
+	size_t capacity;	/* how many tokens allocated */
+	char * text;		/* side store for text and messages */
+	size_t text_len;	/* how many bytes of text in use */
+	size_t text_cap;	/* how many bytes of text allocated */
+	int preserved;		/* TRUE if white space and comments are kept */
+} Pls_tokvec;
+
+/* The exact value of a numeric literal is coef * 10^exponent. */
+
+typedef struct
+{
+	uint64_t coef;		/* coefficient, with no trailing zeros */
+	long exponent;		/* power of ten */
+	int exact;			/* boolean: FALSE if digits were lost */
+} Pls_decimal;
+
+/* A Pls_lookahead holds tokens already lexed but not yet consumed, so  */
+/* that client code can look as many as PLS_PEEK_MAX tokens ahead (see  */
+/* pls_peek_tok()).  Treat it as opaque. */
+
+#define PLS_PEEK_MAX 16
+
+typedef struct
+{
+	Pls_tok * ring[ PLS_PEEK_MAX ];
+	unsigned head;		/* subscript of the next token */
+	unsigned count;		/* how many tokens are held */
+} Pls_lookahead;
+
+/* Starting value and multiplier for pls_hash(), a 64-bit FNV-1a hash */
+
+#define PLS_HASH_INIT  UINT64_C( 0xcbf29ce484222325 )
+#define PLS_HASH_PRIME UINT64_C( 0x100000001b3 )
+
+/* Starting value and multiplier for pls_check_hash(), a second hash */
+/* for confirming a match on pls_hash()                              */
+
+#define PLS_CHECK_INIT UINT64_C( 0x243f6a8885a308d3 )
+#define PLS_CHECK_MULT UINT64_C( 0x9e3779b97f4a7c15 )
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
 
 Pls_tok * pls_next_tok( Sfile s );
 void pls_free_tok( Pls_tok ** ppT );
+int pls_reserve( void );
 size_t pls_tok_size( const Pls_tok * pT );
 char * pls_copy_text( const Pls_tok * pT, char * p, size_t n );
 void pls_write_text( const Pls_tok * pT, FILE * pF );
+void pls_emit_text( const Pls_tok * pT, Pls_stream_func func, void * p );
 int pls_preserve( void );
 int pls_nopreserve( void );
+int pls_preserving( void );
+int pls_char_columns( int on );
+int pls_counting_chars( void );
+int pls_stream( Pls_stream_func func, void * p, size_t threshold );
+int pls_num_value( const Pls_tok * pT, Pls_decimal * pD );
+int pls_recover( Pls_diaglist * pL );
+const char * pls_diag_text( Pls_diag_code code );
 const char * pls_keyword_name( Pls_token_type t );
 const int pls_is_keyword( Pls_token_type t );
 
+void pls_tokvec_init( Pls_tokvec * pV );
+int pls_tokvec_append( Pls_tokvec * pV, const Pls_tok * pT );
+int pls_tokvec_load( Pls_tokvec * pV, Sfile s );
+const char * pls_tokvec_text( const Pls_tokvec * pV, size_t i );
+const char * pls_tokvec_msg( const Pls_tokvec * pV, size_t i );
+void pls_tokvec_free( Pls_tokvec * pV );
+
+uint64_t pls_hash( const void * p, size_t n, uint64_t h );
+uint64_t pls_check_hash( const void * p, size_t n, uint64_t h );
+int pls_write_plt( const Pls_tokvec * pV, uint64_t src_hash,
+	uint64_t src_len, const char * filename );
+int pls_read_plt( Pls_tokvec * pV, uint64_t * pSrc_hash,
+	uint64_t * pSrc_len, const char * filename );
+
+void pls_lookahead_init( Pls_lookahead * pL );
+Pls_tok * pls_peek_tok( Pls_lookahead * pL, Sfile s, size_t k );
+Pls_tok * pls_take_tok( Pls_lookahead * pL, Sfile s );
+void pls_lookahead_free( Pls_lookahead * pL );
+
+int pls_cache_config( const char * dir, unsigned long max_bytes );
+Sfile pls_cache_open( FILE * pF );
+
 #ifdef __cplusplus
 	};
 #endif
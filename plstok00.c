@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
@@ -38,11 +39,9 @@ typedef struct chunk
 	char buf[ CHUNK_SIZE ];
 } Chunk;
 
-/* free lists for Chunks and Pls_toks which have been */
-/* allocated but which are not currently in use:      */
-
-static Chunk * freechunk = NULL;
-static Pls_tok * freetok = NULL;
+/* Tokens and Chunks come from the slab allocator (see memmgmt.c),
+   which recycles them cheaply, and without locking in the usual case.
+*/
 
 /* local functions: */
 
@@ -50,7 +49,7 @@ static Chunk * pls_alloc_chunk( void );
 static Chunk * extend_chunks( Chunk * pChunk, const char * str );
 static void free_chunk( Chunk * pChunk );
 static void free_chunk_list( Chunk ** ppChunk );
-static void free_all( void * dummy );
+static void init_tok( Pls_tok * pT );
 
 /****************************************************************
  pls_alloc_token -- allocate and initialize a token.  Note that
@@ -61,41 +60,71 @@ Pls_tok * pls_alloc_tok( void )
 {
 	Pls_tok * pT;
 
-	/* allocate from the free list if possible, */
-	/* or from the free store if necessary      */
+	pT = allocSlab( sizeof( Pls_tok ) );
+	if( pT != NULL )
+		init_tok( pT );
 
-	if( NULL == freetok )
-	{
-		static int signed_up = FALSE;
+	return pT;
+}
 
-		if( !signed_up )
-		{
-			registerMemoryPool( free_all, NULL );
-			signed_up = TRUE;
-		}
-		pT = allocMemory( sizeof( Pls_tok ) );
-	}
+/****************************************************************
+ pls_reserve -- have slabs on hand for tokens and Chunks.  Most
+ tokens need no Chunks, so the first long token may come long
+ after a program has warmed up; a program which goes on to call
+ markSteadyState() should call this first, lest that token go to
+ the heap.  Return ERROR_FOUND if unable to allocate, otherwise
+ OKAY.
+ ***************************************************************/
+int pls_reserve( void )
+{
+	if( reserveSlab( sizeof( Pls_tok ) ) != OKAY
+		|| reserveSlab( sizeof( Chunk ) ) != OKAY )
+		return ERROR_FOUND;
 	else
-	{
-		pT = freetok;
-		freetok = (Pls_tok *) pT->pChunk;
-	}
+		return OKAY;
+}
 
-	if( pT != NULL )
-	{
-		/* initialize */
+/****************************************************************
+ pls_reset_tok -- discard a token's text, message, and attributes,
+ leaving it as if newly allocated, so that the lexer can reuse it.
+ ***************************************************************/
+void pls_reset_tok( Pls_tok * pT )
+{
+	ASSERT( pT != NULL );
+	if( NULL == pT )
+		return;
 
-		pT->type   = T_none;
-		pT->line   = 0;
-		pT->col    = 0;
-		pT->buflen = 0;
-		pT->buf[ 0 ] = '\0';
-		pT->pChunk = NULL;
-		pT->pLast  = NULL;
-		pT->msg    = NULL;
-	}
+	if( pT->pChunk != NULL )
+		free_chunk_list( (Chunk **) &pT->pChunk );
+	if( pT->msg != NULL )
+		freeMemory( pT->msg );
 
-	return pT;
+	init_tok( pT );
+}
+
+/****************************************************************
+ init_tok -- initialize the members of a token.
+ ***************************************************************/
+static void init_tok( Pls_tok * pT )
+{
+	pT->type   = T_none;
+	pT->line   = 0;
+	pT->col    = 0;
+	pT->buflen = 0;
+	pT->buf[ 0 ] = '\0';
+	pT->pChunk = NULL;
+	pT->pLast  = NULL;
+	pT->msg    = NULL;
+	pT->flags  = 0;
+	pT->extra_lines = 0;
+	pT->hash   = PLS_HASH_INIT;
+	pT->num.digits   = 0;
+	pT->num.scale    = 0;
+	pT->num.expo     = 0;
+	pT->num.count    = 0;
+	pT->num.neg_expo = FALSE;
+	pT->num.inexact  = FALSE;
+	pT->diag   = PLS_E_NONE;
 }
 
 /****************************************************************
@@ -169,7 +198,7 @@ char * pls_copy_text( const Pls_tok * pT, char * p, size_t n )
 			len = pChunk->len;
 		else
 			len = n;
-		strncpy( p, pChunk->buf, n );
+		strncpy( p, pChunk->buf, len );
 		p += len;
 		n -= len;
 
@@ -225,6 +254,7 @@ int pls_append_msg( Pls_tok * pT, const char * str )
 int pls_append_text( Pls_tok * pT, const char * str )
 {
 	int rc = OKAY;
+	size_t string_length;
 
 	ASSERT( pT != NULL );
 	ASSERT( str != NULL );
@@ -234,16 +264,19 @@ int pls_append_text( Pls_tok * pT, const char * str )
 	else if( '\0' == str[ 0 ] )
 		return OKAY;
 
+	/* Note the attributes of the new text on the way in */
+
+	string_length = strlen( str );
+	pls_scan_text( pT, str, string_length );
+
 	/* If there's any space in the initial buffer, use it */
 
 	if( pT->buflen < PLS_MAX_WORD )
 	{
-		size_t string_length;
 		size_t room;
 
 		ASSERT( NULL == pT->pChunk );
 
-		string_length = strlen( str );
 		room = PLS_MAX_WORD - pT->buflen;
 
 		if( room >= string_length )
@@ -312,6 +345,97 @@ int pls_append_text( Pls_tok * pT, const char * str )
 	return rc;
  }
 
+/****************************************************************
+ pls_scan_text -- update a token's flags, line count, and hash
+ to account for text about to be appended.  Usually this happens
+ inside pls_append_text(), but the lexer calls it directly for
+ text it stores directly.
+
+ To tell whether the text continues after a newline, we remember
+ in an internal flag whether the text so far ends with one.
+ ***************************************************************/
+void pls_scan_text( Pls_tok * pT, const char * str, size_t len )
+{
+	unsigned flags;
+	unsigned extra_lines;
+	uint64_t hash;
+	int after_newline = FALSE;
+	const unsigned char * p;
+
+	ASSERT( pT != NULL );
+	ASSERT( str != NULL || 0 == len );
+
+	if( NULL == pT || NULL == str )
+		return;
+
+	flags       = pT->flags;
+	extra_lines = pT->extra_lines;
+	hash        = pT->hash;
+
+	if( flags & PLS_TF_PENDING_NL )
+		after_newline = TRUE;
+
+	for( p = (const unsigned char *) str; len > 0; --len, ++p )
+	{
+		hash ^= *p;
+		hash *= PLS_HASH_PRIME;
+
+		/* Any character after a newline is on a later line */
+
+		if( after_newline )
+		{
+			flags |= PLS_TF_MULTILINE;
+			++extra_lines;
+		}
+
+		if( '\n' == *p )
+		{
+			flags |= PLS_TF_NEWLINE;
+			after_newline = TRUE;
+		}
+		else
+		{
+			after_newline = FALSE;
+
+			if( islower( *p ) )
+				flags |= PLS_TF_LOWER;
+			else if( isupper( *p ) )
+				flags |= PLS_TF_UPPER;
+		}
+	}
+
+	if( after_newline )
+		flags |= PLS_TF_PENDING_NL;
+	else
+		flags &= ~PLS_TF_PENDING_NL;
+
+	pT->flags       = flags;
+	pT->extra_lines = extra_lines;
+	pT->hash        = hash;
+}
+
+/****************************************************************
+ pls_drain_text -- deliver a token's text to a stream sink, as one
+ segment for the initial buffer and one for each Chunk, and then
+ empty the token.  The flags, line count, and hash remain, since
+ they describe the whole text, not just what is left in memory.
+ ***************************************************************/
+void pls_drain_text( Pls_tok * pT, Pls_stream_func func, void * p )
+{
+	ASSERT( pT != NULL );
+	ASSERT( func != NULL );
+	if( NULL == pT || NULL == func )
+		return;
+
+	pls_emit_text( pT, func, p );
+
+	if( pT->pChunk != NULL )
+		free_chunk_list( (Chunk **) &pT->pChunk );
+	pT->pLast    = NULL;
+	pT->buflen   = 0;
+	pT->buf[ 0 ] = '\0';
+}
+
 /****************************************************************
  extend_chunks -- append a string to a Chunk, adding more
  Chunks as needed.  Return a pointer to the last Chunk, or
@@ -427,6 +551,30 @@ void pls_write_text( const Pls_tok * pT, FILE * pF )
 	}
 }
 
+/****************************************************************
+ pls_emit_text -- deliver the textual contents of a token to a
+ stream sink, as one PLS_STREAM_SEGMENT for the initial buffer and
+ one for each Chunk, leaving the token intact.  This lets client
+ code copy the text to any kind of output without knowing about
+ Chunks.
+ ***************************************************************/
+void pls_emit_text( const Pls_tok * pT, Pls_stream_func func, void * p )
+{
+	const Chunk * pChunk;
+
+	ASSERT( pT != NULL );
+	ASSERT( func != NULL );
+	if( NULL == pT || NULL == func )
+		return;
+
+	if( pT->buflen > 0 )
+		func( p, PLS_STREAM_SEGMENT, pT, pT->buf, pT->buflen );
+
+	for( pChunk = (const Chunk *) pT->pChunk; pChunk != NULL;
+		 pChunk = pChunk->pNext )
+		func( p, PLS_STREAM_SEGMENT, pT, pChunk->buf, pChunk->len );
+}
+
 /****************************************************************
  pls_alloc_chunk -- allocate and initialize a Chunk.
  ***************************************************************/
@@ -434,17 +582,7 @@ static Chunk * pls_alloc_chunk( void )
 {
 	Chunk * pChunk;
 
-	/* allocate from the free list if possible, */
-	/* or from the free store if necessary      */
-
-	if( NULL == freechunk )
-		pChunk = allocMemory( sizeof( Chunk ) );
-	else
-	{
-		pChunk = freechunk;
-		freechunk = freechunk->pNext;
-	}
-
+	pChunk = allocSlab( sizeof( Chunk ) );
 	if( pChunk != NULL )
 	{
 		/* initialize */
@@ -464,12 +602,7 @@ static void free_chunk( Chunk * pChunk )
 	ASSERT( pChunk != NULL );
 
 	if( NULL != pChunk )
-	{
-		/* stick on the free list for possible reuse */
-
-		pChunk->pNext = freechunk;
-		freechunk = pChunk;
-	}
+		freeSlab( pChunk );
 }
 
 /****************************************************************
@@ -497,53 +630,7 @@ static void free_chunk_list( Chunk ** ppChunk )
 }
 
 /****************************************************************
- free_all -- a memory scavenger.  Free all the tokens and Chunks
- on the free lists.  We don't use the dummy parameter -- it's
- only there so we can install it with registerMemoryPool().
- ***************************************************************/
-static void free_all( void * dummy )
-{
-	Pls_tok * pT;
-	Pls_tok * pTemp;
-	Chunk * pChunk;
-	Chunk * pTempChunk;
-
-	ASSERT( NULL == dummy );
-
-	pT = freetok;
-	freetok = NULL;
-
-	while( pT != NULL )
-	{
-		/* Free the token.  Note that we don't free the Chunk list; */
-		/* It isn't really a Chunk list any more, since we've       */
-		/* hijacked pChunk to use as a pointer to the next token.   */
-
-		pTemp = (Pls_tok *) pT->pChunk;
-		freeMemory( pT );
-		pT = pTemp;
-	}
-
-	pChunk = freechunk;
-	freechunk = NULL;
-
-	while( pChunk != NULL )
-	{
-		pTempChunk = pChunk->pNext;
-		freeMemory( pChunk );
-		pChunk = pTempChunk;
-	}
-
-	return;
-}
-
-/****************************************************************
- pls_free_tok -- deallocate a token and all of its Chunks.  We
- deallocate merely by sticking things on a free list so that we
- can reuse them cheaply later.
-
- For a pointer with which to stitch the list together, we hijack
- the pChunk pointer and use it as a Pls_tok *.
+ pls_free_tok -- deallocate a token and all of its Chunks.
  ***************************************************************/
 void pls_free_tok( Pls_tok ** ppT )
 {
@@ -557,13 +644,8 @@ void pls_free_tok( Pls_tok ** ppT )
 
 	if( pT->pChunk != NULL )
 		free_chunk_list( (Chunk **) &pT->pChunk );
-	pT->pLast = NULL;				/* not strictly necessary */
 	if( pT->msg != NULL )
-	{
 		freeMemory( pT->msg );
-		pT->msg = NULL;				/* not strictly necessary */
-	}
 
-	pT->pChunk = (void *) freetok;
-	freetok = pT;
+	freeSlab( pT );
 }
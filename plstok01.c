@@ -21,14 +21,104 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include "util.h"
 #include "sfile.h"
 #include "plstok.h"
 #include "plspriv.h"
 
 #define LOCAL_BUFLEN 63
+#define MIN_STREAM   4096	/* smallest threshold for streaming */
+
+/* We push the following back onto an Sfile, ahead of the body of a */
+/* wrapped unit, to tell the next call to pls_next_tok() about it.  */
+/* It can't be confused with a real character or with EOF.          */
+
+#define WRAPPED_MARK (EOF - 1)
+#define MAX_BLANKS   6		/* trailing blanks on a line we peek at */
+
+#define UTF8_MAX     4		/* longest UTF-8 sequence */
+
+/* Character classes.  We classify each byte by looking it up in a  */
+/* table rather than by calling isalpha() and friends, so that the  */
+/* lexer is fast and doesn't depend on the locale.  A byte with the */
+/* high bit set may start a multibyte UTF-8 character, which we     */
+/* decode only when we come to it.                                   */
+
+#define CC_SPACE  0x01
+#define CC_ALPHA  0x02
+#define CC_DIGIT  0x04
+#define CC_WORD   0x08		/* may continue an identifier */
+#define CC_PUNCT  0x10
+#define CC_HIGH   0x20		/* not ASCII */
+
+#define SP CC_SPACE
+#define AL ( CC_ALPHA | CC_WORD )
+#define DG ( CC_DIGIT | CC_WORD )
+#define US ( CC_PUNCT | CC_WORD )
+#define PU CC_PUNCT
+#define HI CC_HIGH
+
+static const unsigned char char_class[ UCHAR_MAX + 1 ] =
+{
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  SP, SP, SP, SP, SP, 0,  0,	/* 00 */
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,	/* 10 */
+	SP, PU, PU, US, US, PU, PU, PU, PU, PU, PU, PU, PU, PU, PU, PU,	/* 20 */
+	DG, DG, DG, DG, DG, DG, DG, DG, DG, DG, PU, PU, PU, PU, PU, PU,	/* 30 */
+	PU, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,	/* 40 */
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, PU, PU, PU, PU, US,	/* 50 */
+	PU, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,	/* 60 */
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, PU, PU, PU, PU, 0,	/* 70 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* 80 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* 90 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* a0 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* b0 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* c0 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* d0 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,	/* e0 */
+	HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI	/* f0 */
+};
+
+#undef SP
+#undef AL
+#undef DG
+#undef US
+#undef PU
+#undef HI
+
+/* Look up a character, which may also be EOF or WRAPPED_MARK */
+
+#define CLASS_OF( c ) \
+	( ( (c) >= 0 && (c) <= UCHAR_MAX ) ? char_class[ (c) ] : 0 )
 
 static int preserving = TRUE;
+static int char_columns = FALSE;
+
+static Pls_stream_func stream_func = NULL;
+static void * stream_p = NULL;
+static size_t stream_threshold = 0;
+static int stream_held = FALSE;
+
+static Pls_diaglist * pDiags = NULL;	/* non-NULL if recovering */
+
+/* Messages for error tokens, indexed by Pls_diag_code */
+
+static const char * const diag_text[ PLS_E_COUNT ] =
+{
+	"",
+	"Unexpected character",
+	"Identifier is too long",
+	"Unterminated string or character literal",
+	"'!' not followed by '='",
+	"'~' not followed by '='",
+	"'^' not followed by '='",
+	"'|' not followed by '|'",
+	"Unrecognized punctuation character",
+	"Unterminated C-style token",
+	"Unterminated quoted identifier",
+	"Quoted identifier is too long",
+	"Invalid numeric literal"
+};
 
 static int get_word( Pls_tok * pT, Sfile s, int c );
 static int get_squote( Pls_tok * pT, Sfile s );
@@ -38,6 +128,16 @@ static int get_c_comment( Pls_tok * pT, Sfile s );
 static int get_dquote( Pls_tok * pT, Sfile s );
 static int get_hyphen_comment( Pls_tok * pT, Sfile s );
 static int get_number( Pls_tok * pT, Sfile s );
+static void wrapped_marker( const char * word, Sfile s );
+static int get_wrapped( Pls_tok * pT, Sfile s );
+static int end_of_unit( Sfile s );
+static size_t stream_check( Pls_tok * pT, size_t held, Pls_token_type type );
+static void stream_end( Pls_tok * pT );
+static int lex_error( Pls_tok * pT, Pls_diag_code code );
+static void record_diag( Pls_diag_code code, size_t start, size_t end );
+static void skip_word( Sfile s );
+static int utf8_char( Sfile s, int c, char * seq, int * pLetter );
+static int national_letter( unsigned long code );
 
 /******************************************************************
  pls_preserve -- set a switch denoting that we shall preserve
@@ -65,6 +165,121 @@ int pls_nopreserve( void )
 	return prior_value;
 }
 
+/******************************************************************
+ pls_preserving -- Return the current value of the switch, without
+ changing it.
+ *****************************************************************/
+int pls_preserving( void )
+{
+	return preserving;
+}
+
+/******************************************************************
+ pls_char_columns -- set a switch denoting whether we shall count
+ columns in characters (if on is TRUE) or in bytes (if FALSE).  In
+ character mode, the continuation bytes of a UTF-8 character don't
+ advance the column.  Return: prior value of the switch.
+ *****************************************************************/
+int pls_char_columns( int on )
+{
+	int prior_value;
+
+	prior_value  = char_columns;
+	char_columns = on ? TRUE : FALSE;
+	return prior_value;
+}
+
+/******************************************************************
+ pls_counting_chars -- Return the current value of the column
+ switch, without changing it.
+ *****************************************************************/
+int pls_counting_chars( void )
+{
+	return char_columns;
+}
+
+/******************************************************************
+ pls_stream -- install a sink to receive the text of any string
+ literal or C-style comment longer than threshold bytes, instead of
+ storing it in the token.  Such a token has the PLS_TF_STREAMED flag
+ and no text of its own.  A NULL func turns streaming off.
+ *****************************************************************/
+int pls_stream( Pls_stream_func func, void * p, size_t threshold )
+{
+	if( threshold < MIN_STREAM )
+		threshold = MIN_STREAM;
+
+	stream_func      = func;
+	stream_p         = p;
+	stream_threshold = threshold;
+	return OKAY;
+}
+
+/******************************************************************
+ pls_stream_hold -- suspend streaming (if hold is TRUE) or resume
+ it (if FALSE), without disturbing the sink.  Return: prior value
+ of the switch.
+ *****************************************************************/
+int pls_stream_hold( int hold )
+{
+	int prior_value;
+
+	prior_value = stream_held;
+	stream_held = hold;
+	return prior_value;
+}
+
+/******************************************************************
+ pls_recover -- switch to (or, given NULL, out of) recovery mode.
+ In recovery mode, instead of returning an error token with a
+ message, the lexer records a diagnostic in the specified list,
+ skips over the offending text, and carries on with the next token.
+ *****************************************************************/
+int pls_recover( Pls_diaglist * pL )
+{
+	pDiags = pL;
+	return OKAY;
+}
+
+/******************************************************************
+ pls_recovering -- return TRUE if we are in recovery mode.
+ *****************************************************************/
+int pls_recovering( void )
+{
+	return pDiags != NULL ? TRUE : FALSE;
+}
+
+/******************************************************************
+ pls_diag_text -- return the message for a diagnostic code.
+ *****************************************************************/
+const char * pls_diag_text( Pls_diag_code code )
+{
+	if( (unsigned) code >= PLS_E_COUNT )
+		return "Unknown error";
+	else
+		return diag_text[ code ];
+}
+
+/******************************************************************
+ pls_diag_lookup -- return the diagnostic code for an error
+ message, or PLS_E_NONE if it isn't one of ours.
+ *****************************************************************/
+Pls_diag_code pls_diag_lookup( const char * msg )
+{
+	int i;
+
+	if( NULL == msg )
+		return PLS_E_NONE;
+
+	for( i = PLS_E_NONE + 1; i < PLS_E_COUNT; ++i )
+	{
+		if( 0 == strcmp( msg, diag_text[ i ] ) )
+			return (Pls_diag_code) i;
+	}
+
+	return PLS_E_NONE;
+}
+
 /******************************************************************
  pls_next_tok -- Allocate a token and return a pointer to it.  It
  is the client code's responsibility to free it by calling
@@ -80,26 +295,44 @@ Pls_tok * pls_next_tok( Sfile s )
 	Pls_tok * pT = NULL;
 	int c;
 	Sposition pos;
+	Pls_cache * pC;
+	size_t start;		/* offset of the token */
+	int again;
+
+	/* An Sfile opened by pls_cache_open() may replay its tokens */
+	/* from the cache instead of lexing them afresh.             */
+
+	pC = s_client( s );
+	if( pls_cache_replaying( pC ) )
+		return pls_cache_next( pC );
 
 	pT = pls_alloc_tok();
 	if( NULL == pT )
 		return NULL;
 
+	(void) s_char_columns( s, char_columns );
+
 	/* In the following loop, the funky while clause is       */
-	/* designed to skip over comments if preserving is FALSE. */
+	/* designed to skip over comments if preserving is FALSE, */
+	/* and over errors if we are recovering from them.        */
 
 	do
 	{
+		again = FALSE;
 		c = s_getc( s );
 
-		if( FALSE == preserving )
+		if( FALSE == preserving && c != WRAPPED_MARK )
 		{
 			/* Discard all white space. */
 
-			while( isspace( (unsigned char) c ) )
+			while( CLASS_OF( c ) & CC_SPACE )
 				c = s_getc( s );
 		}
 
+		start = s_offset( s );
+		if( c != EOF )
+			--start;
+
 		pos = s_position( s );
 		pT->line = pos.line;
 		pT->col  = pos.col;
@@ -109,23 +342,45 @@ Pls_tok * pls_next_tok( Sfile s )
 			pT->type = T_eof;
 			rc = OKAY;
 		}
-		else if( isspace( (unsigned char) c ) )
+		else if( WRAPPED_MARK == c )
+			rc = get_wrapped( pT, s );
+		else if( CLASS_OF( c ) & CC_SPACE )
 			rc = get_whitespace( pT, s, c );
-		else if( isalpha( (unsigned char) c ) )
+		else if( CLASS_OF( c ) & ( CC_ALPHA | CC_HIGH ) )
 			rc = get_word( pT, s, c );
-		else if( ispunct( (unsigned char) c ) )
+		else if( CLASS_OF( c ) & CC_PUNCT )
 			rc = get_punct( pT, s, c );
-		else if( isdigit( (unsigned char) c ) )
+		else if( CLASS_OF( c ) & CC_DIGIT )
 		{
 			(void) s_ungetc( s, c );
 			rc = get_number( pT, s );
 		}
 		else
-			rc = pls_append_msg( pT, "Unexpected character" );
-	} while( FALSE == preserving && T_remark == pT->type );
+			rc = lex_error( pT, PLS_E_UNEXPECTED_CHAR );
+
+		/* A recovering lexer notes the error, skips the offending */
+		/* text, and tries again -- unless the text has already    */
+		/* gone to a stream sink, in which case the client code    */
+		/* must see the token.                                     */
+
+		if( OKAY == rc && T_error == pT->type && pDiags != NULL )
+		{
+			if( PLS_E_BAD_NUMBER == pT->diag )
+				skip_word( s );
+			record_diag( pT->diag, start, s_offset( s ) );
+
+			if( ! ( pT->flags & PLS_TF_STREAMED ) )
+			{
+				pls_reset_tok( pT );
+				again = TRUE;
+			}
+		}
+	} while( again || ( FALSE == preserving && T_remark == pT->type ) );
 
 	if( rc != OKAY )
 		pls_free_tok( &pT );
+	else if( pC != NULL )
+		pls_cache_record( pC, pT );
 
 	return pT;
 }
@@ -133,46 +388,78 @@ Pls_tok * pls_next_tok( Sfile s )
 /*****************************************************************
  get_word -- collect characters into a word.  It may turn out to
  be either a reserved word or an identifier.
+
+ Letters, digits, and the usual ASCII punctuation go through a
+ table lookup.  Only a byte with the high bit set sends us to the
+ UTF-8 decoder, which accepts a national letter as part of the word.
+ We limit the length of a word in bytes, not in characters.
  ****************************************************************/
 static int get_word( Pls_tok * pT, Sfile s, int c )
 {
-	int count = 1;             /* How many characters in buffer */
-	int total_count = 0;       /* Total characters collected */
+	int count = 0;             /* How many bytes in buffer */
+	int total_count = 0;       /* Total bytes collected */
 	int finished = FALSE;
+	int len;                   /* bytes in the current character */
+	int letter;
+	char seq[ UTF8_MAX ];
 	char buf[ LOCAL_BUFLEN + 1 ];
 
 	ASSERT( pT != NULL );
 
-	buf[ 0 ] = c;
+	/* We get here on a letter, or on the first byte of some  */
+	/* non-ASCII character, which had better be a letter too. */
+
+	if( CLASS_OF( c ) & CC_HIGH )
+	{
+		len = utf8_char( s, c, seq, &letter );
+		if( 0 == len || FALSE == letter )
+			return lex_error( pT, PLS_E_UNEXPECTED_CHAR );
+	}
+	else
+	{
+		seq[ 0 ] = c;
+		len = 1;
+	}
 
 	while( FALSE == finished )
 	{
-		/* Collect all the eligible characters  */
+		if( count + len > LOCAL_BUFLEN )
+		{
+			/* flush the buffer and start over */
+
+			total_count += count;
+			buf[ count ] = '\0';
+			if( pls_append_text( pT, buf ) != OKAY )
+				return ERROR_FOUND;
+			count = 0;
+		}
+
+		memcpy( buf + count, seq, len );
+		count += len;
+
+		/* Collect all the eligible characters */
 
 		c = s_getc( s );
 
-		if( isalnum( (unsigned char) c ) ||
-			'_' == c || '$' == c || '#' == c )
+		if( CLASS_OF( c ) & CC_WORD )
 		{
-			if( count < LOCAL_BUFLEN )
-				buf[ count++ ] = c;
-			else
-			{
-				/* flush the buffer and start over */
-
-				total_count += count;
-				buf[ count ] = '\0';
-				if( pls_append_text( pT, buf ) != OKAY )
-					return ERROR_FOUND;
-				else
-				{
-					buf[ 0 ] = c;
-					count = 1;
-				}
-			}
+			seq[ 0 ] = c;
+			len = 1;
 		}
 		else
 		{
+			if( CLASS_OF( c ) & CC_HIGH )
+			{
+				len = utf8_char( s, c, seq, &letter );
+				if( len > 0 && letter )
+					continue;
+
+				/* Not a letter; put back all but the first byte */
+
+				while( len > 1 )
+					(void) s_ungetc( s, (unsigned char) seq[ --len ] );
+			}
+
 			/* Since we have read one character past the word, we */
 			/* put the last character back into the input stream  */
 
@@ -193,16 +480,174 @@ static int get_word( Pls_tok * pT, Sfile s, int c )
 
 	if( total_count > PLS_MAX_WORD - 2 ) /* subtract 2: not quoted */
 	{
-		pT->type = T_error;
-		return pls_append_msg( pT, "Identifier is too long" );
+		return lex_error( pT, PLS_E_WORD_TOO_LONG );
 	}
 	else
 	{
 		pT->type = pls_keyword( pT->buf );
+		if( T_identifier == pT->type && 7 == total_count )
+			wrapped_marker( pT->buf, s );
 		return OKAY;
 	}
 }
 
+/*****************************************************************
+ wrapped_marker -- see whether a word just read is the WRAPPED
+ keyword of a wrapped (obfuscated) unit, as in:
+
+	CREATE OR REPLACE PACKAGE BODY foo wrapped
+	a000000
+	...
+
+ Since "wrapped" may also be an ordinary identifier, we insist that
+ it end the line, and that the next line begin with "a0".  If so,
+ everything up to the terminating "/" line is an opaque blob, which
+ get_wrapped() will collect as a single token.  Either way, we push
+ back everything we read to find out, and in the first case we push
+ WRAPPED_MARK on top of it.
+ ****************************************************************/
+static void wrapped_marker( const char * word, Sfile s )
+{
+	static const char marker[] = "wrapped";
+	int peeked[ MAX_BLANKS + 3 ];
+	int n = 0;
+	int c;
+	int i;
+
+	for( i = 0; marker[ i ] != '\0'; ++i )
+	{
+		if( tolower( (unsigned char) word[ i ] ) != marker[ i ] )
+			return;
+	}
+
+	do
+	{
+		c = s_getc( s );
+		peeked[ n++ ] = c;
+	} while( n <= MAX_BLANKS && ( ' ' == c || '\t' == c || '\r' == c ) );
+
+	if( '\n' == c )
+	{
+		c = s_getc( s );
+		peeked[ n++ ] = c;
+		if( 'a' == c || 'A' == c )
+		{
+			c = s_getc( s );
+			peeked[ n++ ] = c;
+		}
+	}
+
+	/* Push back what we read, in reverse order */
+
+	for( i = n - 1; i >= 0; --i )
+		(void) s_ungetc( s, peeked[ i ] );
+
+	if( '0' == c && n >= 3 && '\n' == peeked[ n - 3 ] )
+		(void) s_ungetc( s, WRAPPED_MARK );
+}
+
+/*****************************************************************
+ get_wrapped -- collect the body of a wrapped unit, from the end of
+ the line containing the WRAPPED keyword, up to but not including
+ the newline before the "/" line which terminates the unit (or the
+ end of the file, if there isn't one).  The WRAPPED_MARK has already
+ been read.
+
+ We make no attempt to tokenize the body, which is a kind of base64
+ encoding.  We just scan for the end, collecting text in big pieces.
+ ****************************************************************/
+static int get_wrapped( Pls_tok * pT, Sfile s )
+{
+	int rc = OKAY;
+	int c;
+	size_t count = 0;
+	size_t held = 0;
+	char buf[ BUFSIZ + 1 ];
+	Sposition pos;
+
+	ASSERT( pT != NULL );
+
+	pT->type = T_wrapped;
+
+	/* The token begins with the first real character */
+
+	c = s_getc( s );
+	pos = s_position( s );
+	pT->line = pos.line;
+	pT->col  = pos.col;
+
+	while( c != EOF )
+	{
+		if( '\n' == c && end_of_unit( s ) )
+		{
+			(void) s_ungetc( s, c );
+			break;
+		}
+
+		if( count >= BUFSIZ )
+		{
+			/* buffer is full; flush it, start over */
+
+			buf[ count ] = '\0';
+			rc = pls_append_text( pT, buf );
+			if( rc != OKAY )
+				return rc;
+			held = stream_check( pT, held + count, T_wrapped );
+			count = 0;
+		}
+		buf[ count++ ] = (char) c;
+
+		c = s_getc( s );
+	}
+
+	if( EOF == c )
+		(void) s_ungetc( s, EOF );
+
+	if( count > 0 )
+	{
+		buf[ count ] = '\0';
+		rc = pls_append_text( pT, buf );
+	}
+
+	stream_end( pT );
+	return rc;
+}
+
+/*****************************************************************
+ end_of_unit -- having just read a newline, see whether the next
+ line consists of a "/" alone (apart from trailing blanks), which
+ terminates a unit.  Leave the input as we found it.
+ ****************************************************************/
+static int end_of_unit( Sfile s )
+{
+	int peeked[ MAX_BLANKS + 2 ];
+	int n = 0;
+	int c;
+	int i;
+	int found = FALSE;
+
+	c = s_getc( s );
+	peeked[ n++ ] = c;
+
+	if( '/' == c )
+	{
+		do
+		{
+			c = s_getc( s );
+			peeked[ n++ ] = c;
+		} while( n <= MAX_BLANKS &&
+				 ( ' ' == c || '\t' == c || '\r' == c ) );
+
+		if( '\n' == c || EOF == c )
+			found = TRUE;
+	}
+
+	for( i = n - 1; i >= 0; --i )
+		(void) s_ungetc( s, peeked[ i ] );
+
+	return found;
+}
+
 /*****************************************************************
  get_squote -- collect characters within single quotes, regarding
  a consecutive pair of single quotes as text rather than delimiters.
@@ -216,6 +661,7 @@ static int get_squote( Pls_tok * pT, Sfile s )
 	int c;
 	int count = 1;             /* How many characters in buffer */
 	int total_count = 0;       /* Total characters collected */
+	size_t held = 0;           /* Characters held in the token */
 	int after_quote = FALSE;
 	int finished = FALSE;
 	char buf[ LOCAL_BUFLEN + 1 ];
@@ -239,7 +685,10 @@ static int get_squote( Pls_tok * pT, Sfile s )
 		if( '\'' == c )
 		{
 			if( TRUE == after_quote )
+			{
 				after_quote = FALSE;
+				pT->flags |= PLS_TF_DQUOTE;		/* a doubled quote */
+			}
 			else
 				after_quote = TRUE;
 		}
@@ -252,9 +701,7 @@ static int get_squote( Pls_tok * pT, Sfile s )
 				after_quote = FALSE;
 				if( EOF == c )
 				{
-					pT->type = T_error;
-					rc = pls_append_msg( pT, "Unterminated string "
-						"or character literal" );
+					rc = lex_error( pT, PLS_E_UNTERMINATED_STRING );
 					finished = TRUE;
 				}
 			}
@@ -282,6 +729,7 @@ static int get_squote( Pls_tok * pT, Sfile s )
 					rc = ERROR_FOUND;
 					finished = TRUE;
 				}
+				held = stream_check( pT, held + count, T_string_lit );
 				buf[ 0 ] = c;
 				count = 1;
 			}
@@ -309,6 +757,7 @@ static int get_squote( Pls_tok * pT, Sfile s )
 			pT->type = T_string_lit;
 	}
 
+	stream_end( pT );
 	return rc;
 }
 
@@ -320,6 +769,7 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 {
 	int rc = OKAY;
 	int nextc;
+	int direct = TRUE;	/* FALSE if the text goes through pls_append_text() */
 
 	ASSERT( pT != NULL );
 
@@ -351,9 +801,11 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 			break;
 		case '\'' :
 			rc = get_squote( pT, s );
+			direct = FALSE;
 			break;
 		case '"' :
 			rc = get_dquote( pT, s );
+			direct = FALSE;
 			break;
 		case '*' :
 			nextc = s_getc( s );
@@ -378,7 +830,10 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 		case '-' :
 			nextc = s_getc( s );
 			if( '-' == nextc )
+			{
 				rc = get_hyphen_comment( pT, s );
+				direct = FALSE;
+			}
 			else
 			{
 				(void) s_ungetc( s, nextc );
@@ -422,8 +877,7 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 			else
 			{
 				(void) s_ungetc( s, nextc );
-				rc = pls_append_msg( pT, "'!' not followed by '='" );
-				pT->type = T_error;
+				rc = lex_error( pT, PLS_E_LONE_BANG );
 			}
 			break;
 		case '~' :
@@ -437,8 +891,7 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 			else
 			{
 				(void) s_ungetc( s, nextc );
-				rc = pls_append_msg( pT, "'~' not followed by '='" );
-				pT->type = T_error;
+				rc = lex_error( pT, PLS_E_LONE_TILDE );
 			}
 			break;
 		case '^' :
@@ -452,8 +905,7 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 			else
 			{
 				(void) s_ungetc( s, nextc );
-				rc = pls_append_msg( pT, "'^' not followed by '='" );
-				pT->type = T_error;
+				rc = lex_error( pT, PLS_E_LONE_HAT );
 			}
 			break;
 		case '>' :
@@ -535,14 +987,16 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 			else
 			{
 				(void) s_ungetc( s, nextc );
-				rc = pls_append_msg( pT, "'|' not followed by '|'" );
-				pT->type = T_error;
+				rc = lex_error( pT, PLS_E_LONE_BAR );
 			}
 			break;
 		case '/' :
 			nextc = s_getc( s );
 			if( '*' == nextc )
+			{
 				rc = get_c_comment( pT, s );
+				direct = FALSE;
+			}
 			else
 			{
 				(void) s_ungetc( s, nextc );
@@ -552,12 +1006,14 @@ static int get_punct( Pls_tok * pT, Sfile s, int c )
 			}
 			break;
 		default :
-			rc = pls_append_msg( pT, "Unrecognized punctuation character" );
-			pT->type = T_error;
+			rc = lex_error( pT, PLS_E_BAD_PUNCT );
 			break;
 	}
 
 	pT->buflen = strlen( pT->buf );
+	if( direct )
+		pls_scan_text( pT, pT->buf, pT->buflen );
+
 	return rc;
 }
 
@@ -579,7 +1035,7 @@ static int get_whitespace( Pls_tok * pT, Sfile s, int c )
 	{
 		c = s_getc( s );
 
-		if( isspace( (unsigned char) c ) )
+		if( CLASS_OF( c ) & CC_SPACE )
 		{
 			if( count >= LOCAL_BUFLEN )
 			{
@@ -609,6 +1065,7 @@ static int get_whitespace( Pls_tok * pT, Sfile s, int c )
 		rc = pls_append_text( pT, buf );
 	}
 
+	stream_end( pT );
 	return rc;
 }
 
@@ -624,6 +1081,7 @@ static int get_c_comment( Pls_tok * pT, Sfile s )
 	int after_asterisk = FALSE;		/* a boolean */
 	int finished = FALSE;
 	size_t count = 2;	/* we already have the first 2 characters */
+	size_t held = 0;	/* characters held in the token */
 	char buf[ LOCAL_BUFLEN + 1 ] = "/*";
 
 	ASSERT( pT != NULL );
@@ -637,9 +1095,8 @@ static int get_c_comment( Pls_tok * pT, Sfile s )
 		if( EOF == c )
 		{
 			(void) s_ungetc( s, EOF );
-			pT->type = T_error;
 			finished = TRUE;
-			rc = pls_append_msg( pT, "Unterminated C-style token" );
+			rc = lex_error( pT, PLS_E_UNTERMINATED_COMMENT );
 		}
 		else
 		{
@@ -655,6 +1112,7 @@ static int get_c_comment( Pls_tok * pT, Sfile s )
 					rc = pls_append_text( pT, buf );
 					if( rc != OKAY )
 						finished = TRUE;
+					held = stream_check( pT, held + count, T_remark );
 					count = 0;
 				}
 				buf[ count ] = c;
@@ -687,6 +1145,7 @@ static int get_c_comment( Pls_tok * pT, Sfile s )
 		rc = pls_append_text( pT, buf );
 	}
 
+	stream_end( pT );
 	return rc;
 }
 
@@ -715,10 +1174,8 @@ static int get_dquote( Pls_tok * pT, Sfile s )
 		if( EOF == c )
 		{
 			(void) s_ungetc( s, EOF );
-			pT->type = T_error;
 			finished = TRUE;
-			rc = pls_append_msg( pT,
-				"Unterminated quoted identifier" );
+			rc = lex_error( pT, PLS_E_UNTERMINATED_QUOTED_ID );
 		}
 		else
 		{
@@ -755,8 +1212,7 @@ static int get_dquote( Pls_tok * pT, Sfile s )
 
 	if( pls_tok_size( pT ) > 32 )	/* (including quote marks) */
 	{
-		pT->type = T_error;
-		pls_append_msg( pT, "Quoted identifier is too long" );
+		(void) lex_error( pT, PLS_E_QUOTED_ID_TOO_LONG );
 	}
 
 	return rc;
@@ -773,11 +1229,13 @@ static int get_hyphen_comment( Pls_tok * pT, Sfile s )
 	int c;
 	int finished = FALSE;
 	size_t count = 2;	/* we already have the first 2 characters */
+	size_t held = 0;	/* characters held in the token */
 	char buf[ LOCAL_BUFLEN + 1 ] = "--";
 
 	ASSERT( pT != NULL );
 
-	pT->type = T_remark;
+	pT->type   = T_remark;
+	pT->flags |= PLS_TF_HYPHEN;
 
 	do
 	{
@@ -802,6 +1260,7 @@ static int get_hyphen_comment( Pls_tok * pT, Sfile s )
 					rc = pls_append_text( pT, buf );
 					if( rc != OKAY )
 						finished = TRUE;
+					held = stream_check( pT, held + count, T_remark );
 					count = 0;
 				}
 				buf[ count ] = c;
@@ -829,6 +1288,7 @@ static int get_hyphen_comment( Pls_tok * pT, Sfile s )
 		rc = pls_append_text( pT, buf );
 	}
 
+	stream_end( pT );
 	return rc;
 }
 
@@ -929,6 +1389,9 @@ static const State machine[ NR_OF_STATES ] [ NR_OF_EVENTS ] =
 	}
 };
 
+static Event classify( int c );
+static void num_feed( Pls_num * pN, State state, int c );
+
 /******************************************************************
  get_number -- a small finite state machine to collect characters
  for a number, consisting of:
@@ -948,7 +1411,6 @@ static int get_number( Pls_tok * pT, Sfile s )
 	int rc = OKAY;
 	int c;
 	State state = S_INITIAL;
-	Event event;
 	size_t count = 0;
 	char buf[ LOCAL_BUFLEN + 1 ];
 
@@ -956,23 +1418,9 @@ static int get_number( Pls_tok * pT, Sfile s )
 	{
 		c = s_getc( s );
 
-		/* categorize the new character as an event */
-
-		if( isdigit( (unsigned char) c ) )
-			event = E_DIGIT;
-		else if( '.' == c )
-			event = E_DOT;
-		else if( 'E' == c || 'e' == c )
-			event = E_E;
-		else if( '-' == c || '+' == c )
-			event = E_SIGN;
-		else
-			event = E_OTHER;
-
-
 		/* decide on the next state by a table lookup */
 
-		state = machine[ state ][ event ];
+		state = machine[ state ][ classify( c ) ];
 
 		if( S_FINISHED == state || S_ERROR == state )
 		{
@@ -997,6 +1445,10 @@ static int get_number( Pls_tok * pT, Sfile s )
 			}
 			buf[ count ] = c;
 			++count;
+
+			/* Collect the parts of the value as we go */
+
+			num_feed( &pT->num, state, c );
 		}
 	}
 
@@ -1012,8 +1464,7 @@ static int get_number( Pls_tok * pT, Sfile s )
 	{
 		if( OKAY == rc )
 		{
-			pT->type = T_error;
-			rc = pls_append_msg( pT, "Invalid numeric literal" );
+			rc = lex_error( pT, PLS_E_BAD_NUMBER );
 		}
 	}
 	else
@@ -1021,3 +1472,325 @@ static int get_number( Pls_tok * pT, Sfile s )
 
 	return rc;
 }
+
+/******************************************************************
+ classify -- categorize a character as an event for the numeric
+ state machine.
+ *****************************************************************/
+static Event classify( int c )
+{
+	if( isdigit( (unsigned char) c ) )
+		return E_DIGIT;
+	else if( '.' == c )
+		return E_DOT;
+	else if( 'E' == c || 'e' == c )
+		return E_E;
+	else if( '-' == c || '+' == c )
+		return E_SIGN;
+	else
+		return E_OTHER;
+}
+
+/******************************************************************
+ num_feed -- account for one more character of a numeric literal,
+ given the state to which it has moved the state machine.
+
+ We keep the first PLS_NUM_DIGITS significant digits of the
+ mantissa as an integer, together with a power of ten by which to
+ scale it: minus one for each digit after the decimal point, plus
+ one for each digit before the decimal point that didn't fit.  We
+ keep the exponent separately, with its sign.  If we have to drop a
+ non-zero digit, or if the scale or exponent gets absurdly big, we
+ note that the value is inexact.
+ *****************************************************************/
+static void num_feed( Pls_num * pN, State state, int c )
+{
+	int d;
+
+	if( ! isdigit( (unsigned char) c ) )
+	{
+		if( S_SIGN == state && '-' == c )
+			pN->neg_expo = TRUE;
+		return;
+	}
+
+	d = c - '0';
+
+	if( S_EXPO == state )
+	{
+		if( pN->expo < ( LONG_MAX / 2 - 9 ) / 10 )
+			pN->expo = pN->expo * 10 + d;
+		else
+			pN->inexact = TRUE;
+		return;
+	}
+
+	if( 0 == d && 0 == pN->count )
+		;							/* leading zero */
+	else if( pN->count < PLS_NUM_DIGITS )
+	{
+		pN->digits = pN->digits * 10 + (unsigned) d;
+		++pN->count;
+	}
+	else
+	{
+		if( d != 0 )
+			pN->inexact = TRUE;		/* digit doesn't fit */
+		if( S_LEFT_DIGIT == state )
+		{
+			if( pN->scale < LONG_MAX / 2 )
+				++pN->scale;
+			else
+				pN->inexact = TRUE;
+		}
+		return;
+	}
+
+	if( S_RIGHT_DIGIT == state )
+	{
+		if( pN->scale > -( LONG_MAX / 2 ) )
+			--pN->scale;
+		else
+			pN->inexact = TRUE;
+	}
+}
+
+/******************************************************************
+ pls_num_scan -- collect the parts of the value of a numeric
+ literal from its text, for a token that didn't come straight from
+ the lexer (one replayed from the token cache, for example).
+ *****************************************************************/
+void pls_num_scan( Pls_tok * pT, const char * text )
+{
+	State state = S_INITIAL;
+
+	ASSERT( pT != NULL );
+	ASSERT( text != NULL );
+	if( NULL == pT || NULL == text )
+		return;
+
+	for( ; *text != '\0'; ++text )
+	{
+		state = machine[ state ][ classify( *text ) ];
+		if( S_FINISHED == state || S_ERROR == state )
+			break;
+		num_feed( &pT->num, state, *text );
+	}
+}
+
+/******************************************************************
+ pls_num_value -- compute the exact value of a numeric literal, as
+ an integer coefficient (with no trailing zeros) and a power of ten.
+ If the literal had more significant digits than the coefficient can
+ hold, or an enormous exponent, the value is approximate, and we
+ say so in the exact member.  Return ERROR_FOUND if the token is not
+ a numeric literal.
+ *****************************************************************/
+int pls_num_value( const Pls_tok * pT, Pls_decimal * pD )
+{
+	uint64_t coef;
+	long exponent;
+
+	ASSERT( pT != NULL );
+	ASSERT( pD != NULL );
+	if( NULL == pT || NULL == pD || pT->type != T_num_lit )
+		return ERROR_FOUND;
+
+	/* Both terms are less than LONG_MAX / 2 in */
+	/* magnitude, so the sum can't overflow.     */
+
+	coef = pT->num.digits;
+	exponent = pT->num.scale +
+		( pT->num.neg_expo ? -pT->num.expo : pT->num.expo );
+
+	if( 0 == coef )
+		exponent = 0;
+	else
+	{
+		while( 0 == coef % 10 )
+		{
+			coef /= 10;
+			++exponent;
+		}
+	}
+
+	pD->coef     = coef;
+	pD->exponent = exponent;
+	pD->exact    = pT->num.inexact ? FALSE : TRUE;
+	return OKAY;
+}
+
+/******************************************************************
+ stream_check -- if streaming is enabled and a token is holding
+ more text than the threshold, pass the text to the sink, starting
+ the stream first if this is the first time for this token.
+ Return: how much text the token is holding now.
+ *****************************************************************/
+static size_t stream_check( Pls_tok * pT, size_t held, Pls_token_type type )
+{
+	if( NULL == stream_func || stream_held || held < stream_threshold )
+		return held;
+
+	if( ! ( pT->flags & PLS_TF_STREAMED ) )
+	{
+		pT->type = type;
+		pT->flags |= PLS_TF_STREAMED;
+		stream_func( stream_p, PLS_STREAM_BEGIN, pT, "", 0 );
+	}
+
+	pls_drain_text( pT, stream_func, stream_p );
+	return 0;
+}
+
+/******************************************************************
+ stream_end -- if a token is being streamed, pass the rest of its
+ text to the sink and end the stream.
+ *****************************************************************/
+static void stream_end( Pls_tok * pT )
+{
+	if( ! ( pT->flags & PLS_TF_STREAMED ) || NULL == stream_func )
+		return;
+
+	pls_drain_text( pT, stream_func, stream_p );
+	stream_func( stream_p, PLS_STREAM_END, pT, "", 0 );
+}
+
+/******************************************************************
+ lex_error -- turn a token into an error token.  Unless we are
+ recovering, attach the corresponding message.
+ *****************************************************************/
+static int lex_error( Pls_tok * pT, Pls_diag_code code )
+{
+	pT->type = T_error;
+	pT->diag = code;
+
+	if( pDiags != NULL )
+		return OKAY;
+	else
+		return pls_append_msg( pT, diag_text[ code ] );
+}
+
+/******************************************************************
+ record_diag -- add a diagnostic to the list, clamping the offset
+ and length to fit.  If the list is full, just count it.
+ *****************************************************************/
+static void record_diag( Pls_diag_code code, size_t start, size_t end )
+{
+	Pls_diag * pD;
+
+	if( pDiags->count >= pDiags->capacity )
+	{
+		++pDiags->lost;
+		return;
+	}
+
+	pD = pDiags->diags + pDiags->count;
+	pD->code   = (uint16_t) code;
+	pD->offset = start > UINT32_MAX ? UINT32_MAX : (uint32_t) start;
+	end -= start;
+	pD->length = end > UINT32_MAX ? UINT32_MAX : (uint32_t) end;
+	++pDiags->count;
+}
+
+/******************************************************************
+ skip_word -- skip over the rest of a malformed word, such as the
+ "x9" in "1ex9", so that we resume lexing at a sensible place.
+ *****************************************************************/
+static void skip_word( Sfile s )
+{
+	int c;
+
+	do
+		c = s_getc( s );
+	while( ( CLASS_OF( c ) & ( CC_WORD | CC_HIGH ) ) || '.' == c );
+
+	(void) s_ungetc( s, c );
+}
+
+/******************************************************************
+ utf8_char -- given the first byte of a non-ASCII character, fetch
+ the rest of it, storing all its bytes in seq.  Return the number
+ of bytes, or zero if the sequence is malformed, in which case we
+ put back whatever we fetched after the first byte.  Through
+ pLetter, report whether the character may appear in an identifier.
+ *****************************************************************/
+static int utf8_char( Sfile s, int c, char * seq, int * pLetter )
+{
+	static const unsigned long min_code[ UTF8_MAX + 1 ] =
+		{ 0, 0, 0x80, 0x800, 0x10000 };
+	unsigned long code;
+	int len;
+	int i;
+	int d;
+
+	*pLetter = FALSE;
+
+	if( 0xc0 == ( c & 0xe0 ) )
+	{
+		len = 2;
+		code = c & 0x1f;
+	}
+	else if( 0xe0 == ( c & 0xf0 ) )
+	{
+		len = 3;
+		code = c & 0x0f;
+	}
+	else if( 0xf0 == ( c & 0xf8 ) )
+	{
+		len = 4;
+		code = c & 0x07;
+	}
+	else
+		return 0;		/* stray continuation byte, or worse */
+
+	seq[ 0 ] = c;
+	for( i = 1; i < len; ++i )
+	{
+		d = s_getc( s );
+		if( 0x80 != ( d & 0xc0 ) || EOF == d )
+		{
+			(void) s_ungetc( s, d );
+			break;
+		}
+		seq[ i ] = d;
+		code = ( code << 6 ) | ( d & 0x3f );
+	}
+
+	/* Reject truncated and overlong sequences, surrogates, */
+	/* and anything beyond the range of Unicode.            */
+
+	if( i < len || code < min_code[ len ] || code > 0x10ffffUL
+		|| ( code >= 0xd800UL && code <= 0xdfffUL ) )
+	{
+		while( i > 1 )
+			(void) s_ungetc( s, (unsigned char) seq[ --i ] );
+		return 0;
+	}
+
+	*pLetter = national_letter( code );
+	return len;
+}
+
+/******************************************************************
+ national_letter -- return TRUE if a non-ASCII character may appear
+ in an identifier.  We don't carry the Unicode tables around, so we
+ accept anything except the blocks of spaces, punctuation, and
+ symbols that someone might plausibly paste into source code.
+ *****************************************************************/
+static int national_letter( unsigned long code )
+{
+	if( code < 0xc0UL )
+		return FALSE;	/* C1 controls, Latin-1 punctuation */
+	else if( 0xd7UL == code || 0xf7UL == code )
+		return FALSE;	/* multiplication and division signs */
+	else if( code >= 0x2000UL && code <= 0x2bffUL )
+		return FALSE;	/* punctuation, arrows, math, box drawing */
+	else if( code >= 0x3000UL && code <= 0x303fUL )
+		return FALSE;	/* CJK spaces and punctuation */
+	else if( 0xfeffUL == code )
+		return FALSE;	/* byte order mark */
+	else if( code >= 0xff00UL && code <= 0xff0fUL )
+		return FALSE;	/* fullwidth punctuation */
+	else
+		return TRUE;
+}
@@ -0,0 +1,282 @@
+/* plstok03.c -- routines for building and reading vectors of compact
+   token records.  A Pls_tok is convenient to work with one at a time,
+   but it is far too bulky to keep millions of them in memory.  A
+   Pls_tokvec stores each token in a 16-byte Pls_ctok, and stores the
+   text of all the tokens together in a single side store.
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "plspriv.h"
+
+#define INITIAL_TOKS 256
+#define INITIAL_TEXT 4096
+
+static int reserve_toks( Pls_tokvec * pV, size_t n );
+static int reserve_text( Pls_tokvec * pV, size_t n );
+static uint32_t pack_pos( int line, int col );
+
+/****************************************************************
+ pls_tokvec_init -- make a Pls_tokvec empty.  We assume that it
+ initially contains garbage; nothing is allocated until the first
+ token is appended.
+ ***************************************************************/
+void pls_tokvec_init( Pls_tokvec * pV )
+{
+	ASSERT( pV != NULL );
+	if( NULL == pV )
+		return;
+
+	pV->toks     = NULL;
+	pV->count    = 0;
+	pV->capacity = 0;
+	pV->text     = NULL;
+	pV->text_len = 0;
+	pV->text_cap = 0;
+	pV->preserved = TRUE;
+}
+
+/****************************************************************
+ pls_tokvec_append -- append a compact copy of a token to a
+ Pls_tokvec, including its text and its error message, if any.
+ ***************************************************************/
+int pls_tokvec_append( Pls_tokvec * pV, const Pls_tok * pT )
+{
+	Pls_ctok * pC;
+	size_t size;
+	size_t msglen = 0;
+	size_t need;
+
+	ASSERT( pV != NULL );
+	ASSERT( pT != NULL );
+	if( NULL == pV || NULL == pT )
+		return ERROR_FOUND;
+
+	size = pls_tok_size( pT );
+	need = size + 1;
+	if( pT->msg != NULL )
+	{
+		msglen = strlen( pT->msg );
+		need += msglen + 1;
+	}
+
+	/* The offsets and lengths are only 32 bits wide */
+
+	if( pV->text_len + need > (size_t) UINT32_MAX )
+		return ERROR_FOUND;
+
+	if( reserve_toks( pV, 1 ) != OKAY || reserve_text( pV, need ) != OKAY )
+		return ERROR_FOUND;
+
+	pC = pV->toks + pV->count;
+	pC->type   = (uint16_t) pT->type;
+	pC->flags  = (uint16_t) ( pT->flags & PLS_TF_ALL );
+	pC->offset = (uint32_t) pV->text_len;
+	pC->length = (uint32_t) size;
+	pC->pos    = pack_pos( pT->line, pT->col );
+
+	(void) pls_copy_text( pT, pV->text + pV->text_len, size + 1 );
+	pV->text_len += size + 1;
+
+	if( pT->msg != NULL )
+	{
+		pC->flags |= PLS_CF_MSG;
+		memcpy( pV->text + pV->text_len, pT->msg, msglen + 1 );
+		pV->text_len += msglen + 1;
+	}
+
+	++pV->count;
+	return OKAY;
+}
+
+/****************************************************************
+ pls_tokvec_load -- tokenize an entire Sfile into a Pls_tokvec,
+ appending to whatever the vector already contains.  The last
+ token appended is always the T_eof token.
+ ***************************************************************/
+int pls_tokvec_load( Pls_tokvec * pV, Sfile s )
+{
+	int rc = OKAY;
+	Pls_token_type type;
+	Pls_tok * pT;
+	int held;
+
+	ASSERT( pV != NULL );
+	if( NULL == pV )
+		return ERROR_FOUND;
+
+	pV->preserved = pls_preserving();
+
+	/* The vector needs the whole text of every token, */
+	/* so don't let any of it go to a stream sink.     */
+
+	held = pls_stream_hold( TRUE );
+
+	do
+	{
+		pT = pls_next_tok( s );
+		if( NULL == pT )
+		{
+			rc = ERROR_FOUND;
+			break;
+		}
+
+		type = pT->type;
+		rc = pls_tokvec_append( pV, pT );
+		pls_free_tok( &pT );
+
+	} while( OKAY == rc && type != T_eof );
+
+	(void) pls_stream_hold( held );
+	return rc;
+}
+
+/****************************************************************
+ pls_tokvec_text -- return a pointer to the nul-terminated text of
+ a specified token.
+ ***************************************************************/
+const char * pls_tokvec_text( const Pls_tokvec * pV, size_t i )
+{
+	ASSERT( pV != NULL );
+	ASSERT( i < pV->count );
+	if( NULL == pV || i >= pV->count )
+		return "";
+
+	return pV->text + pV->toks[ i ].offset;
+}
+
+/****************************************************************
+ pls_tokvec_msg -- return a pointer to the error message of a
+ specified token, or NULL if it doesn't have one.
+ ***************************************************************/
+const char * pls_tokvec_msg( const Pls_tokvec * pV, size_t i )
+{
+	const Pls_ctok * pC;
+
+	ASSERT( pV != NULL );
+	ASSERT( i < pV->count );
+	if( NULL == pV || i >= pV->count )
+		return NULL;
+
+	pC = pV->toks + i;
+	if( pC->flags & PLS_CF_MSG )
+		return pV->text + pC->offset + pC->length + 1;
+	else
+		return NULL;
+}
+
+/****************************************************************
+ pls_tokvec_free -- release the memory owned by a Pls_tokvec,
+ leaving it empty.
+ ***************************************************************/
+void pls_tokvec_free( Pls_tokvec * pV )
+{
+	ASSERT( pV != NULL );
+	if( NULL == pV )
+		return;
+
+	if( pV->toks != NULL )
+		freeMemory( pV->toks );
+	if( pV->text != NULL )
+		freeMemory( pV->text );
+
+	pls_tokvec_init( pV );
+}
+
+/****************************************************************
+ reserve_toks -- make sure there is room for n more records,
+ doubling the allocation as needed.
+ ***************************************************************/
+static int reserve_toks( Pls_tokvec * pV, size_t n )
+{
+	size_t new_cap;
+	Pls_ctok * pNew;
+
+	if( pV->count + n <= pV->capacity )
+		return OKAY;
+
+	new_cap = pV->capacity ? pV->capacity : INITIAL_TOKS;
+	while( new_cap < pV->count + n )
+		new_cap *= 2;
+
+	if( NULL == pV->toks )
+		pNew = allocMemory( new_cap * sizeof( Pls_ctok ) );
+	else
+		pNew = resizeMemory( pV->toks, new_cap * sizeof( Pls_ctok ) );
+
+	if( NULL == pNew )
+		return ERROR_FOUND;
+
+	pV->toks = pNew;
+	pV->capacity = new_cap;
+	return OKAY;
+}
+
+/****************************************************************
+ reserve_text -- make sure there are n more bytes available in
+ the side store, doubling the allocation as needed.
+ ***************************************************************/
+static int reserve_text( Pls_tokvec * pV, size_t n )
+{
+	size_t new_cap;
+	char * pNew;
+
+	if( pV->text_len + n <= pV->text_cap )
+		return OKAY;
+
+	new_cap = pV->text_cap ? pV->text_cap : INITIAL_TEXT;
+	while( new_cap < pV->text_len + n )
+		new_cap *= 2;
+
+	if( NULL == pV->text )
+		pNew = allocMemory( new_cap );
+	else
+		pNew = resizeMemory( pV->text, new_cap );
+
+	if( NULL == pNew )
+		return ERROR_FOUND;
+
+	pV->text = pNew;
+	pV->text_cap = new_cap;
+	return OKAY;
+}
+
+/****************************************************************
+ pack_pos -- combine a line and column into a single 32-bit
+ value, clamping each one to the largest value that will fit.
+ ***************************************************************/
+static uint32_t pack_pos( int line, int col )
+{
+	unsigned long l;
+	unsigned long c;
+
+	l = line < 0 ? 0 : (unsigned long) line;
+	c = col  < 0 ? 0 : (unsigned long) col;
+
+	if( l > PLS_CTOK_MAX_LINE )
+		l = PLS_CTOK_MAX_LINE;
+	if( c > PLS_CTOK_MAX_COL )
+		c = PLS_CTOK_MAX_COL;
+
+	return (uint32_t) ( ( l << PLS_CTOK_COL_BITS ) | c );
+}
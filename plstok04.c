@@ -0,0 +1,426 @@
+/* plstok04.c -- routines for saving a Pls_tokvec to a binary file and
+   loading it back, so that a tokenized file need not be tokenized
+   again as long as the source text hasn't changed.
+
+   A token file (conventionally with the suffix ".plt") consists of:
+
+   1. A 32-byte header (see below);
+
+   2. An array of 16-byte token records, in the same layout as a
+      Pls_ctok;
+
+   3. The side store holding the text of the tokens.
+
+   All integers are stored in little-endian order.  On a little-endian
+   machine the token records are therefore an exact image of an array of
+   Pls_ctoks, so that the file could be mapped into memory and used in
+   place.  For portability we read it with fread(), but on such a
+   machine we read the records directly into the vector without any
+   translation.
+
+   The header is checked against the size of the file, which we get
+   from the POSIX function fstat(), before we allocate anything.
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+
+/* Layout of the header:
+
+    0  4 bytes  magic number "PLTK"
+    4  4 bytes  format version
+    8  8 bytes  hash of the source text, as computed by pls_hash()
+   16  4 bytes  number of token records
+   20  4 bytes  length of the side store
+   24  4 bytes  flags (PLT_PRESERVED)
+   28  4 bytes  reserved; must be zero
+   32  8 bytes  length of the source text
+*/
+
+#define PLT_MAGIC      "PLTK"
+#define PLT_VERSION    5
+#define PLT_HEADER     40
+#define PLT_RECORD     16
+#define PLT_PRESERVED  0x0001	/* white space and comments were kept */
+
+static int native_layout( void );
+static void put16( unsigned char * p, uint16_t n );
+static void put32( unsigned char * p, uint32_t n );
+static void put64( unsigned char * p, uint64_t n );
+static uint16_t get16( const unsigned char * p );
+static uint32_t get32( const unsigned char * p );
+static uint64_t get64( const unsigned char * p );
+static int write_records( const Pls_tokvec * pV, FILE * pF );
+static int read_records( Pls_tokvec * pV, FILE * pF );
+static int valid_records( const Pls_tokvec * pV );
+
+/****************************************************************
+ pls_hash -- continue a 64-bit FNV-1a hash over n bytes.  Start
+ with PLS_HASH_INIT, or with the result of a previous call in order
+ to hash several pieces as if they were one.
+ ***************************************************************/
+uint64_t pls_hash( const void * p, size_t n, uint64_t h )
+{
+	const unsigned char * s;
+
+	ASSERT( p != NULL || 0 == n );
+
+	for( s = (const unsigned char *) p; n > 0; --n, ++s )
+	{
+		h ^= *s;
+		h *= PLS_HASH_PRIME;
+	}
+
+	return h;
+}
+
+/****************************************************************
+ pls_check_hash -- continue a second 64-bit hash over n bytes, for
+ confirming a match on pls_hash().  Since the two hashes mix the
+ bytes in different ways, texts which collide in one are no more
+ likely than any others to collide in both.  Start with
+ PLS_CHECK_INIT, or with the result of a previous call.
+ ***************************************************************/
+uint64_t pls_check_hash( const void * p, size_t n, uint64_t h )
+{
+	const unsigned char * s;
+
+	ASSERT( p != NULL || 0 == n );
+
+	for( s = (const unsigned char *) p; n > 0; --n, ++s )
+	{
+		h = ( h + *s + 1 ) * PLS_CHECK_MULT;
+		h ^= h >> 29;
+	}
+
+	return h;
+}
+
+/****************************************************************
+ pls_write_plt -- write a Pls_tokvec to a token file, together with
+ a hash and the length of the source text from which it was built.
+ ***************************************************************/
+int pls_write_plt( const Pls_tokvec * pV, uint64_t src_hash,
+	uint64_t src_len, const char * filename )
+{
+	int rc = OKAY;
+	FILE * pF;
+	unsigned char header[ PLT_HEADER ];
+
+	ASSERT( pV != NULL );
+	ASSERT( filename != NULL );
+	if( NULL == pV || NULL == filename )
+		return ERROR_FOUND;
+
+	if( pV->count > UINT32_MAX || pV->text_len > UINT32_MAX )
+		return ERROR_FOUND;
+
+	pF = fopen( filename, "wb" );
+	if( NULL == pF )
+		return ERROR_FOUND;
+
+	memcpy( header, PLT_MAGIC, 4 );
+	put32( header + 4, PLT_VERSION );
+	put64( header + 8, src_hash );
+	put32( header + 16, (uint32_t) pV->count );
+	put32( header + 20, (uint32_t) pV->text_len );
+	put32( header + 24, pV->preserved ? PLT_PRESERVED : 0 );
+	put32( header + 28, 0 );
+	put64( header + 32, src_len );
+
+	if( fwrite( header, PLT_HEADER, 1, pF ) != 1 )
+		rc = ERROR_FOUND;
+	else if( write_records( pV, pF ) != OKAY )
+		rc = ERROR_FOUND;
+	else if( pV->text_len > 0 &&
+			 fwrite( pV->text, pV->text_len, 1, pF ) != 1 )
+		rc = ERROR_FOUND;
+
+	if( fclose( pF ) != 0 )
+		rc = ERROR_FOUND;
+
+	return rc;
+}
+
+/****************************************************************
+ pls_read_plt -- load a token file into a Pls_tokvec, which we
+ assume to be empty (or to contain garbage).  Store the hash and the
+ length of the source text through pSrc_hash and pSrc_len (either of
+ which may be NULL), so that the client code can decide whether the
+ tokens are still current.
+
+ We validate the file before returning it, so that a truncated or
+ corrupted file will be rejected rather than crash the client code.
+ If we return ERROR_FOUND, the vector is left empty.
+ ***************************************************************/
+int pls_read_plt( Pls_tokvec * pV, uint64_t * pSrc_hash,
+	uint64_t * pSrc_len, const char * filename )
+{
+	int rc = OKAY;
+	FILE * pF;
+	struct stat st;
+	unsigned char header[ PLT_HEADER ];
+	uint32_t count;
+	uint32_t text_len;
+	uint64_t size;
+
+	ASSERT( pV != NULL );
+	ASSERT( filename != NULL );
+	if( NULL == pV || NULL == filename )
+		return ERROR_FOUND;
+
+	pls_tokvec_init( pV );
+
+	pF = fopen( filename, "rb" );
+	if( NULL == pF )
+		return ERROR_FOUND;
+
+	if( fread( header, PLT_HEADER, 1, pF ) != 1 ||
+		memcmp( header, PLT_MAGIC, 4 ) != 0    ||
+		get32( header + 4 ) != PLT_VERSION     ||
+		get32( header + 28 ) != 0 )
+	{
+		fclose( pF );
+		return ERROR_FOUND;
+	}
+
+	count    = get32( header + 16 );
+	text_len = get32( header + 20 );
+
+	/* Before believing the counts enough to allocate memory for */
+	/* them, make sure they account for the size of the file.    */
+
+	size = (uint64_t) PLT_HEADER + (uint64_t) count * PLT_RECORD + text_len;
+	if( fstat( fileno( pF ), &st ) != 0 ||
+		(uint64_t) st.st_size != size  ||
+		size >= SIZE_MAX )
+	{
+		fclose( pF );
+		return ERROR_FOUND;
+	}
+
+	/* Allocate exactly enough room, with an extra byte */
+	/* of text so that we never allocate zero bytes.    */
+
+	pV->toks = allocMemory( count ? (size_t) count * sizeof( Pls_ctok ) : 1 );
+	pV->text = allocMemory( (size_t) text_len + 1 );
+	if( NULL == pV->toks || NULL == pV->text )
+		rc = ERROR_FOUND;
+	else
+	{
+		pV->capacity  = count;
+		pV->count     = count;
+		pV->text_cap  = (size_t) text_len + 1;
+		pV->text_len  = text_len;
+		pV->preserved = ( get32( header + 24 ) & PLT_PRESERVED ) ?
+						TRUE : FALSE;
+
+		if( read_records( pV, pF ) != OKAY )
+			rc = ERROR_FOUND;
+		else if( text_len > 0 &&
+				 fread( pV->text, text_len, 1, pF ) != 1 )
+			rc = ERROR_FOUND;
+		else if( getc( pF ) != EOF )
+			rc = ERROR_FOUND;		/* trailing garbage */
+		else if( valid_records( pV ) != OKAY )
+			rc = ERROR_FOUND;
+	}
+
+	fclose( pF );
+
+	if( OKAY == rc )
+	{
+		if( pSrc_hash != NULL )
+			*pSrc_hash = get64( header + 8 );
+		if( pSrc_len != NULL )
+			*pSrc_len = get64( header + 32 );
+	}
+	else
+		pls_tokvec_free( pV );
+
+	return rc;
+}
+
+/****************************************************************
+ native_layout -- return TRUE if a Pls_ctok in memory has exactly
+ the same layout as a token record in a file.
+ ***************************************************************/
+static int native_layout( void )
+{
+	Pls_ctok probe;
+	unsigned char expected[ PLT_RECORD ];
+
+	if( sizeof( Pls_ctok ) != PLT_RECORD )
+		return FALSE;
+
+	probe.type   = 0x0102;
+	probe.flags  = 0x0304;
+	probe.offset = UINT32_C( 0x05060708 );
+	probe.length = UINT32_C( 0x090a0b0c );
+	probe.pos    = UINT32_C( 0x0d0e0f10 );
+
+	put16( expected,      probe.type );
+	put16( expected + 2,  probe.flags );
+	put32( expected + 4,  probe.offset );
+	put32( expected + 8,  probe.length );
+	put32( expected + 12, probe.pos );
+
+	return 0 == memcmp( &probe, expected, PLT_RECORD ) ? TRUE : FALSE;
+}
+
+/****************************************************************
+ write_records -- write the token records, translating them one
+ at a time only if the native layout is different.
+ ***************************************************************/
+static int write_records( const Pls_tokvec * pV, FILE * pF )
+{
+	size_t i;
+	unsigned char rec[ PLT_RECORD ];
+
+	if( 0 == pV->count )
+		return OKAY;
+
+	if( native_layout() )
+	{
+		if( fwrite( pV->toks, PLT_RECORD, pV->count, pF ) != pV->count )
+			return ERROR_FOUND;
+		return OKAY;
+	}
+
+	for( i = 0; i < pV->count; ++i )
+	{
+		const Pls_ctok * pC = pV->toks + i;
+
+		put16( rec,      pC->type );
+		put16( rec + 2,  pC->flags );
+		put32( rec + 4,  pC->offset );
+		put32( rec + 8,  pC->length );
+		put32( rec + 12, pC->pos );
+		if( fwrite( rec, PLT_RECORD, 1, pF ) != 1 )
+			return ERROR_FOUND;
+	}
+	return OKAY;
+}
+
+/****************************************************************
+ read_records -- read the token records into an array already
+ allocated, translating them only if the native layout is
+ different.
+ ***************************************************************/
+static int read_records( Pls_tokvec * pV, FILE * pF )
+{
+	size_t i;
+	unsigned char rec[ PLT_RECORD ];
+
+	if( 0 == pV->count )
+		return OKAY;
+
+	if( native_layout() )
+	{
+		if( fread( pV->toks, PLT_RECORD, pV->count, pF ) != pV->count )
+			return ERROR_FOUND;
+		return OKAY;
+	}
+
+	for( i = 0; i < pV->count; ++i )
+	{
+		Pls_ctok * pC = pV->toks + i;
+
+		if( fread( rec, PLT_RECORD, 1, pF ) != 1 )
+			return ERROR_FOUND;
+		pC->type   = get16( rec );
+		pC->flags  = get16( rec + 2 );
+		pC->offset = get32( rec + 4 );
+		pC->length = get32( rec + 8 );
+		pC->pos    = get32( rec + 12 );
+	}
+	return OKAY;
+}
+
+/****************************************************************
+ valid_records -- make sure that every token has a valid type, and
+ that every token's text, and every message, lies within the side
+ store and is nul-terminated.
+ ***************************************************************/
+static int valid_records( const Pls_tokvec * pV )
+{
+	size_t i;
+
+	for( i = 0; i < pV->count; ++i )
+	{
+		const Pls_ctok * pC = pV->toks + i;
+		size_t end;
+
+		if( pC->type > T_xor )
+			return ERROR_FOUND;
+
+		end = (size_t) pC->offset + pC->length;
+		if( end >= pV->text_len || pV->text[ end ] != '\0' )
+			return ERROR_FOUND;
+
+		if( pC->flags & PLS_CF_MSG )
+		{
+			if( NULL == memchr( pV->text + end + 1, '\0',
+								pV->text_len - end - 1 ) )
+				return ERROR_FOUND;
+		}
+	}
+	return OKAY;
+}
+
+/* Routines to store and fetch little-endian integers: */
+
+static void put16( unsigned char * p, uint16_t n )
+{
+	p[ 0 ] = (unsigned char) ( n & 0xff );
+	p[ 1 ] = (unsigned char) ( n >> 8 );
+}
+
+static void put32( unsigned char * p, uint32_t n )
+{
+	put16( p, (uint16_t) ( n & 0xffff ) );
+	put16( p + 2, (uint16_t) ( n >> 16 ) );
+}
+
+static void put64( unsigned char * p, uint64_t n )
+{
+	put32( p, (uint32_t) ( n & UINT32_MAX ) );
+	put32( p + 4, (uint32_t) ( n >> 32 ) );
+}
+
+static uint16_t get16( const unsigned char * p )
+{
+	return (uint16_t) ( p[ 0 ] | ( p[ 1 ] << 8 ) );
+}
+
+static uint32_t get32( const unsigned char * p )
+{
+	return (uint32_t) get16( p ) | ( (uint32_t) get16( p + 2 ) << 16 );
+}
+
+static uint64_t get64( const unsigned char * p )
+{
+	return (uint64_t) get32( p ) | ( (uint64_t) get32( p + 4 ) << 32 );
+}
@@ -0,0 +1,561 @@
+/* plstok05.c -- routines for a shared cache of binary token files.
+
+   The cache is a directory of token files (see plstok04.c), each named
+   for a hash of the source text from which it was built.  When the same
+   text is tokenized again -- by the same program or by a different one
+   -- the tokens are replayed from the cache instead of being recomputed.
+   Lest two texts with the same hash share an entry, each file records
+   the length of its text and a second, independent hash.
+
+   The cache is disabled unless the client code or the environment
+   names a directory for it.  Files are written under a temporary name
+   and then renamed, so that concurrent processes never see a partial
+   file.  When the total size of the cache exceeds a limit, we delete
+   the least recently used files.
+
+   Like plstok04.c, this module uses some POSIX functions, here for
+   managing the directory.
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+#include "plspriv.h"
+
+#define DEFAULT_MAX (64UL * 1024UL * 1024UL)	/* bytes */
+#define CACHE_SUFFIX ".plt"
+#define KEY_LEN 16		/* hex digits in a file name */
+
+/* Mixed into the hash, so that a change to the tokenizer or to the */
+/* preserve setting yields a different file name.  Bump the version */
+/* whenever the tokenizer's output changes.                         */
+
+#define CACHE_SALT "plstok cache 4"
+
+struct pls_cache
+{
+	char * buf;			/* the source text */
+	size_t len;
+	Pls_tokvec vec;		/* tokens replayed or recorded */
+	size_t next;		/* index of the next token to replay */
+	int replaying;		/* TRUE if replaying, FALSE if recording */
+	int recording;		/* FALSE once recording is abandoned */
+	int preserved;		/* preserve setting at the time of opening */
+	int char_cols;		/* column setting at the time of opening */
+	uint64_t key;
+	uint64_t check;		/* pls_check_hash() of the source text */
+	char name[ KEY_LEN + 1 ];
+};
+
+/* A file found in the cache directory, for eviction */
+
+typedef struct
+{
+	char * path;
+	unsigned long size;
+	time_t mtime;
+} Entry;
+
+static int configured = FALSE;
+static char cache_dir[ FILENAME_MAX ] = "";	/* empty if disabled */
+static unsigned long cache_max = DEFAULT_MAX;
+
+static void configure_from_env( void );
+static unsigned long parse_size( const char * s );
+static char * cache_path( const char * name, const char * suffix );
+static int load_entry( Pls_cache * pC );
+static void save_entry( Pls_cache * pC );
+static void evict( void );
+static int compare_entries( const void * p1, const void * p2 );
+static void free_cache( void * p );
+
+/****************************************************************
+ pls_cache_config -- name the directory for the token cache, and
+ the maximum number of bytes it may occupy.  A NULL directory
+ disables the cache.  A zero maximum means the default.  This call
+ overrides the environment variables PLSTOK_CACHE and
+ PLSTOK_CACHE_MAX.
+ ***************************************************************/
+int pls_cache_config( const char * dir, unsigned long max_bytes )
+{
+	configured = TRUE;
+	cache_dir[ 0 ] = '\0';
+
+	if( dir != NULL )
+	{
+		/* Leave room for the file name within the directory */
+
+		if( strlen( dir ) + KEY_LEN + 32 >= sizeof( cache_dir ) )
+			return ERROR_FOUND;
+		strcpy( cache_dir, dir );
+	}
+
+	cache_max = max_bytes ? max_bytes : DEFAULT_MAX;
+	return OKAY;
+}
+
+/****************************************************************
+ pls_cache_open -- open an Sfile for tokenizing an already opened
+ file, using the token cache if it is enabled.  Otherwise this is
+ equivalent to s_assign().
+
+ With the cache enabled, we read the entire file into memory and
+ look up its hash.  On a hit, pls_next_tok() replays the cached
+ tokens; on a miss, it records the tokens as it goes, and saves
+ them when it reaches the end of the file.
+
+ The preserve and column settings are part of the key, so the
+ client code should call pls_nopreserve() and pls_char_columns(),
+ if at all, before opening.
+ ***************************************************************/
+Sfile pls_cache_open( FILE * pF )
+{
+	Sfile s;
+	Pls_cache * pC;
+	uint64_t key;
+
+	ASSERT( pF != NULL );
+	if( NULL == pF )
+	{
+		s.p = NULL;
+		return s;
+	}
+
+	if( !configured )
+		configure_from_env();
+
+	/* A recovering lexer returns different tokens, */
+	/* so in that case we don't use the cache.      */
+
+	if( '\0' == cache_dir[ 0 ] || pls_recovering() )
+		return s_assign( pF );
+
+	pC = allocMemory( sizeof( Pls_cache ) );
+	if( NULL == pC )
+	{
+		s.p = NULL;
+		return s;
+	}
+
+	pC->buf = s_read_all( pF, &pC->len );
+	if( NULL == pC->buf )
+	{
+		freeMemory( pC );
+		s.p = NULL;
+		return s;
+	}
+
+	pls_tokvec_init( &pC->vec );
+	pC->next      = 0;
+	pC->preserved = pls_preserving();
+	pC->char_cols = pls_counting_chars();
+
+	key = pls_hash( pC->buf, pC->len, PLS_HASH_INIT );
+	key = pls_hash( CACHE_SALT, sizeof( CACHE_SALT ), key );
+	key = pls_hash( pC->preserved ? "P" : "N", 1, key );
+	key = pls_hash( pC->char_cols ? "C" : "B", 1, key );
+	pC->key = key;
+	pC->check = pls_check_hash( pC->buf, pC->len, PLS_CHECK_INIT );
+	sprintf( pC->name, "%08lx%08lx",
+		(unsigned long) ( key >> 32 ),
+		(unsigned long) ( key & 0xffffffffUL ) );
+
+	if( OKAY == load_entry( pC ) )
+	{
+		pC->replaying = TRUE;
+		pC->recording = FALSE;
+	}
+	else
+	{
+		pC->replaying = FALSE;
+		pC->recording = TRUE;
+	}
+
+	s = s_memory( pC->buf, pC->len );
+	if( NULL == s.p )
+		free_cache( pC );
+	else
+		s_set_client( s, pC, free_cache );
+
+	return s;
+}
+
+/****************************************************************
+ pls_cache_replaying -- return TRUE if the tokens should come from
+ the cache rather than from the lexer.
+ ***************************************************************/
+int pls_cache_replaying( const Pls_cache * pC )
+{
+	return NULL == pC ? FALSE : pC->replaying;
+}
+
+/****************************************************************
+ pls_cache_next -- return the next token replayed from the cache,
+ skipping white space and comments if the client code has stopped
+ preserving them.  Once we reach the end, keep returning T_eof, just
+ as the lexer does.  Return NULL if unable to allocate memory.
+ ***************************************************************/
+Pls_tok * pls_cache_next( Pls_cache * pC )
+{
+	const Pls_ctok * pCT;
+	Pls_tok * pT;
+
+	ASSERT( pC != NULL );
+	ASSERT( pC->vec.count > 0 );
+	if( NULL == pC || 0 == pC->vec.count )
+		return NULL;
+
+	for( ;; )
+	{
+		pCT = pC->vec.toks + pC->next;
+		if( pC->next + 1 < pC->vec.count )
+			++pC->next;
+
+		if( pls_preserving() )
+			break;
+		else if( pCT->type != T_whitespace && pCT->type != T_remark )
+			break;
+	}
+
+	pT = pls_alloc_tok();
+	if( NULL == pT )
+		return NULL;
+
+	pT->type = (Pls_token_type) pCT->type;
+	pT->line = PLS_CTOK_LINE( pCT );
+	pT->col  = PLS_CTOK_COL( pCT );
+
+	/* Appending the text recomputes most of the flags, but not */
+	/* all of them, so restore them as the lexer left them.     */
+
+	if( pls_append_text( pT, pC->vec.text + pCT->offset ) != OKAY )
+		pls_free_tok( &pT );
+	else
+	{
+		pT->flags = pCT->flags & PLS_TF_ALL;
+
+		if( T_num_lit == pT->type )
+			pls_num_scan( pT, pC->vec.text + pCT->offset );
+
+		if( pCT->flags & PLS_CF_MSG )
+		{
+			if( pls_append_msg( pT, pC->vec.text + pCT->offset +
+					pCT->length + 1 ) != OKAY )
+				pls_free_tok( &pT );
+			else
+				pT->diag = pls_diag_lookup( pT->msg );
+		}
+	}
+
+	return pT;
+}
+
+/****************************************************************
+ pls_cache_record -- append a token fresh from the lexer to the
+ recording, and save the recording when we reach the end of the
+ file.  If anything goes wrong, we quietly stop recording; the
+ cache is only an optimization.
+ ***************************************************************/
+void pls_cache_record( Pls_cache * pC, const Pls_tok * pT )
+{
+	ASSERT( pT != NULL );
+	if( NULL == pC || NULL == pT || !pC->recording )
+		return;
+
+	/* Give up if the recording wouldn't be faithful: if the  */
+	/* preserve or column setting has changed, if we have     */
+	/* started to recover from errors, if the token's text    */
+	/* went to a stream sink, or if the line or column is too */
+	/* big to fit in a compact token.                         */
+
+	if( pls_preserving() != pC->preserved
+		|| pls_counting_chars() != pC->char_cols
+		|| pls_recovering()
+		|| ( pT->flags & PLS_TF_STREAMED )
+		|| pT->line < 0 || (unsigned long) pT->line > PLS_CTOK_MAX_LINE
+		|| pT->col  < 0 || (unsigned long) pT->col  > PLS_CTOK_MAX_COL
+		|| pls_tokvec_append( &pC->vec, pT ) != OKAY )
+	{
+		pC->recording = FALSE;
+		pls_tokvec_free( &pC->vec );
+		return;
+	}
+
+	if( T_eof == pT->type )
+	{
+		save_entry( pC );
+		pC->recording = FALSE;
+		pls_tokvec_free( &pC->vec );
+	}
+}
+
+/****************************************************************
+ configure_from_env -- look up the cache directory and maximum
+ size in the environment.
+ ***************************************************************/
+static void configure_from_env( void )
+{
+	const char * dir;
+	const char * max;
+
+	dir = getenv( "PLSTOK_CACHE" );
+	max = getenv( "PLSTOK_CACHE_MAX" );
+
+	(void) pls_cache_config( dir, NULL == max ? 0 : parse_size( max ) );
+}
+
+/****************************************************************
+ parse_size -- convert a string to a number of bytes, accepting an
+ optional suffix K, M, or G.
+ ***************************************************************/
+static unsigned long parse_size( const char * s )
+{
+	unsigned long n;
+	char * end;
+
+	n = strtoul( s, &end, 10 );
+	switch( *end )
+	{
+		case 'k' :
+		case 'K' :
+			n *= 1024UL;
+			break;
+		case 'm' :
+		case 'M' :
+			n *= 1024UL * 1024UL;
+			break;
+		case 'g' :
+		case 'G' :
+			n *= 1024UL * 1024UL * 1024UL;
+			break;
+		default :
+			break;
+	}
+	return n;
+}
+
+/****************************************************************
+ cache_path -- build the path of a file in the cache directory,
+ in dynamically allocated memory.  Return NULL if unable to
+ allocate memory.
+ ***************************************************************/
+static char * cache_path( const char * name, const char * suffix )
+{
+	char * path;
+
+	path = allocMemory( strlen( cache_dir ) + strlen( name )
+		+ strlen( suffix ) + 2 );
+	if( path != NULL )
+		sprintf( path, "%s/%s%s", cache_dir, name, suffix );
+
+	return path;
+}
+
+/****************************************************************
+ load_entry -- try to load the cached tokens for the source text.
+ The file name matches its hash; make sure that its length and its
+ check hash match too, before we trust the tokens.  On success,
+ touch the file so that eviction treats it as recently used.
+ ***************************************************************/
+static int load_entry( Pls_cache * pC )
+{
+	int rc = OKAY;
+	char * path;
+	uint64_t src_hash;
+	uint64_t src_len;
+
+	path = cache_path( pC->name, CACHE_SUFFIX );
+	if( NULL == path )
+		return ERROR_FOUND;
+
+	if( pls_read_plt( &pC->vec, &src_hash, &src_len, path ) != OKAY )
+		rc = ERROR_FOUND;
+	else if( src_hash != pC->check
+			 || src_len != (uint64_t) pC->len
+			 || pC->vec.preserved != pC->preserved
+			 || 0 == pC->vec.count
+			 || pC->vec.toks[ pC->vec.count - 1 ].type != T_eof )
+	{
+		pls_tokvec_free( &pC->vec );
+		rc = ERROR_FOUND;
+	}
+	else
+		(void) utime( path, NULL );
+
+	freeMemory( path );
+	return rc;
+}
+
+/****************************************************************
+ save_entry -- write the recorded tokens to a temporary file in
+ the cache directory, and rename it into place.  Then trim the
+ cache if it has grown too big.
+ ***************************************************************/
+static void save_entry( Pls_cache * pC )
+{
+	char * path;
+	char * tmp_path;
+	char suffix[ 40 ];
+
+	(void) mkdir( cache_dir, 0777 );
+
+	sprintf( suffix, ".tmp%ld", (long) getpid() );
+	path     = cache_path( pC->name, CACHE_SUFFIX );
+	tmp_path = cache_path( pC->name, suffix );
+
+	if( path != NULL && tmp_path != NULL )
+	{
+		if( pls_write_plt( &pC->vec, pC->check, (uint64_t) pC->len,
+				tmp_path ) != OKAY
+			|| rename( tmp_path, path ) != 0 )
+			(void) remove( tmp_path );
+		else
+			evict();
+	}
+
+	if( path != NULL )
+		freeMemory( path );
+	if( tmp_path != NULL )
+		freeMemory( tmp_path );
+}
+
+/****************************************************************
+ evict -- if the token files in the cache occupy more than the
+ maximum size, delete the least recently used ones until they
+ don't.
+ ***************************************************************/
+static void evict( void )
+{
+	DIR * pD;
+	struct dirent * pE;
+	struct stat st;
+	Entry * entries = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+	unsigned long total = 0;
+	size_t i;
+	size_t suffix_len = strlen( CACHE_SUFFIX );
+
+	pD = opendir( cache_dir );
+	if( NULL == pD )
+		return;
+
+	while( ( pE = readdir( pD ) ) != NULL )
+	{
+		size_t namelen = strlen( pE->d_name );
+		char * path;
+
+		if( namelen != KEY_LEN + suffix_len
+			|| strcmp( pE->d_name + KEY_LEN, CACHE_SUFFIX ) != 0 )
+			continue;
+
+		path = cache_path( pE->d_name, "" );
+		if( NULL == path )
+			break;
+
+		if( stat( path, &st ) != 0 )
+		{
+			freeMemory( path );
+			continue;
+		}
+
+		if( count == capacity )
+		{
+			Entry * pNew;
+			size_t new_cap = capacity ? capacity * 2 : 64;
+
+			if( NULL == entries )
+				pNew = allocMemory( new_cap * sizeof( Entry ) );
+			else
+				pNew = resizeMemory( entries, new_cap * sizeof( Entry ) );
+
+			if( NULL == pNew )
+			{
+				freeMemory( path );
+				break;
+			}
+			entries = pNew;
+			capacity = new_cap;
+		}
+
+		entries[ count ].path  = path;
+		entries[ count ].size  = (unsigned long) st.st_size;
+		entries[ count ].mtime = st.st_mtime;
+		total += entries[ count ].size;
+		++count;
+	}
+	closedir( pD );
+
+	if( total > cache_max )
+	{
+		qsort( entries, count, sizeof( Entry ), compare_entries );
+
+		for( i = 0; i < count && total > cache_max; ++i )
+		{
+			if( 0 == remove( entries[ i ].path ) )
+				total -= entries[ i ].size;
+		}
+	}
+
+	for( i = 0; i < count; ++i )
+		freeMemory( entries[ i ].path );
+	if( entries != NULL )
+		freeMemory( entries );
+}
+
+/****************************************************************
+ compare_entries -- qsort callback: oldest first.
+ ***************************************************************/
+static int compare_entries( const void * p1, const void * p2 )
+{
+	const Entry * pE1 = p1;
+	const Entry * pE2 = p2;
+
+	if( pE1->mtime < pE2->mtime )
+		return -1;
+	else if( pE1->mtime > pE2->mtime )
+		return 1;
+	else
+		return 0;
+}
+
+/****************************************************************
+ free_cache -- destructor called by s_close().
+ ***************************************************************/
+static void free_cache( void * p )
+{
+	Pls_cache * pC = p;
+
+	if( NULL == pC )
+		return;
+
+	pls_tokvec_free( &pC->vec );
+	if( pC->buf != NULL )
+		freeMemory( pC->buf );
+	freeMemory( pC );
+}
@@ -0,0 +1,118 @@
+/* plstok06.c -- routines for looking more than one token ahead.  A
+   Pls_lookahead holds a ring of tokens already lexed but not yet
+   consumed, so that client code can examine the next several tokens
+   without allocating anything or pushing tokens back.
+
+    Copyright (C) 1999  Scott McKellar  mck9@swbell.net
+
+    This program is open software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "sfile.h"
+#include "plstok.h"
+
+/****************************************************************
+ pls_lookahead_init -- make a Pls_lookahead empty.  We assume that
+ it initially contains garbage.
+ ***************************************************************/
+void pls_lookahead_init( Pls_lookahead * pL )
+{
+	ASSERT( pL != NULL );
+	if( NULL == pL )
+		return;
+
+	pL->head  = 0;
+	pL->count = 0;
+}
+
+/****************************************************************
+ pls_peek_tok -- return a pointer to the token k places ahead in
+ an Sfile (the next token being 0 places ahead), lexing as many
+ tokens as needed to get there.  The token still belongs to the
+ Pls_lookahead; the client code must not free it or keep the
+ pointer after the token has been taken by pls_take_tok().
+
+ Return NULL if k is not less than PLS_PEEK_MAX, or if we can't
+ allocate a token.
+ ***************************************************************/
+Pls_tok * pls_peek_tok( Pls_lookahead * pL, Sfile s, size_t k )
+{
+	ASSERT( pL != NULL );
+	if( NULL == pL || k >= PLS_PEEK_MAX )
+		return NULL;
+
+	while( pL->count <= k )
+	{
+		Pls_tok * pT;
+
+		pT = pls_next_tok( s );
+		if( NULL == pT )
+			return NULL;
+
+		pL->ring[ ( pL->head + pL->count ) % PLS_PEEK_MAX ] = pT;
+		++pL->count;
+	}
+
+	return pL->ring[ ( pL->head + k ) % PLS_PEEK_MAX ];
+}
+
+/****************************************************************
+ pls_take_tok -- consume the next token: the oldest one held in
+ the Pls_lookahead, if there is one, or else a newly lexed one.
+ Like pls_next_tok(), we return NULL only if we can't allocate a
+ token.  The token now belongs to the client code, which must
+ free it by calling pls_free_tok().
+ ***************************************************************/
+Pls_tok * pls_take_tok( Pls_lookahead * pL, Sfile s )
+{
+	Pls_tok * pT;
+
+	ASSERT( pL != NULL );
+	if( NULL == pL )
+		return NULL;
+
+	if( 0 == pL->count )
+		return pls_next_tok( s );
+
+	pT = pL->ring[ pL->head ];
+	pL->head = ( pL->head + 1 ) % PLS_PEEK_MAX;
+	--pL->count;
+
+	return pT;
+}
+
+/****************************************************************
+ pls_lookahead_free -- destroy any tokens still held in a
+ Pls_lookahead, leaving it empty.
+ ***************************************************************/
+void pls_lookahead_free( Pls_lookahead * pL )
+{
+	ASSERT( pL != NULL );
+	if( NULL == pL )
+		return;
+
+	while( pL->count > 0 )
+	{
+		pls_free_tok( &pL->ring[ pL->head ] );
+		pL->head = ( pL->head + 1 ) % PLS_PEEK_MAX;
+		--pL->count;
+	}
+
+	pL->head = 0;
+}
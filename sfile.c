@@ -21,10 +21,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "util.h"
 #include "sfile.h"
 
 #define STACK_SIZE 10
+#define READ_BLOCK 65536
 
 /* The public interface Sfile contains only an opaque pointer.  Within
    this source file we use that pointer to point to the following:
@@ -34,13 +36,24 @@ typedef struct
 	FILE * pF;
 	void * generic_ptr;
 	SF_func func;
+	const char * mem;	/* in-memory source text, if any */
+	size_t mem_len;
+	size_t mem_pos;
+	void * client;		/* data attached by s_set_client() */
+	SF_destructor client_free;
 	int line;
 	int col;
 	int prev_line;
 	int prev_col;
+	size_t offset;		/* characters fetched, net of those ungotten */
 	int closable;
+	int char_cols;		/* TRUE: count columns in UTF-8 characters */
 	unsigned ungotten;
 	int stack[ STACK_SIZE ];	/* int, not char; can store EOF */
+	Sposition stack_pos[ STACK_SIZE ];	/* line and col after each */
+	Sposition hist[ STACK_SIZE ];	/* line and col before recent fetches */
+	unsigned hist_top;
+	unsigned hist_depth;
 } SF;
 
 /****************************************************************
@@ -65,12 +78,21 @@ Sfile s_open( const char * filename )
 				pS->pF = pF;
 				pS->generic_ptr = NULL;
 				pS->func = NULL;
+				pS->mem = NULL;
+				pS->mem_len = 0;
+				pS->mem_pos = 0;
+				pS->client = NULL;
+				pS->client_free = NULL;
 				pS->line = 1;
 				pS->col  = 1;
 				pS->prev_line = 0;
 				pS->prev_col  = 0;
 				pS->closable = TRUE;
+				pS->char_cols = FALSE;
 				pS->ungotten = 0;
+				pS->offset = 0;
+				pS->hist_top = 0;
+				pS->hist_depth = 0;
 			}
 		}
 	}
@@ -98,12 +120,21 @@ Sfile s_assign( FILE * pF )
 			pS->pF = pF;
 			pS->generic_ptr = NULL;
 			pS->func = NULL;
+			pS->mem = NULL;
+			pS->mem_len = 0;
+			pS->mem_pos = 0;
+			pS->client = NULL;
+			pS->client_free = NULL;
 			pS->line = 1;
 			pS->col  = 1;
 			pS->prev_line = 0;
 			pS->prev_col  = 0;
 			pS->closable = FALSE;
+			pS->char_cols = FALSE;
 			pS->ungotten = 0;
+			pS->offset = 0;
+			pS->hist_top = 0;
+			pS->hist_depth = 0;
 		}
 	}
 	s.p = pS;
@@ -134,17 +165,182 @@ Sfile s_callback( SF_func func, void * p )
 		pS->pF = NULL;
 		pS->generic_ptr = p;
 		pS->func = func;
+		pS->mem = NULL;
+		pS->mem_len = 0;
+		pS->mem_pos = 0;
+		pS->client = NULL;
+		pS->client_free = NULL;
 		pS->line = 1;
 		pS->col  = 1;
 		pS->prev_line = 0;
 		pS->prev_col  = 0;
 		pS->closable = FALSE;
+		pS->char_cols = FALSE;
 		pS->ungotten = 0;
+		pS->offset = 0;
+		pS->hist_top = 0;
+		pS->hist_depth = 0;
 	}
 	s.p = pS;
 	return s;
 }
 
+/****************************************************************
+ s_memory: open an Sfile to read text already in memory.  We don't
+ copy the text; the client code must keep it intact until the Sfile
+ is closed.
+ ***************************************************************/
+Sfile s_memory( const char * buf, size_t len )
+{
+	Sfile s;
+	SF * pS;
+
+	ASSERT( buf != NULL );
+	if( NULL == buf )
+	{
+		s.p = NULL;
+		return s;
+	}
+
+	pS = allocMemory( sizeof( SF ) );
+	if( pS != NULL )
+	{
+		pS->pF = NULL;
+		pS->generic_ptr = NULL;
+		pS->func = NULL;
+		pS->mem = buf;
+		pS->mem_len = len;
+		pS->mem_pos = 0;
+		pS->client = NULL;
+		pS->client_free = NULL;
+		pS->line = 1;
+		pS->col  = 1;
+		pS->prev_line = 0;
+		pS->prev_col  = 0;
+		pS->closable = FALSE;
+		pS->char_cols = FALSE;
+		pS->ungotten = 0;
+		pS->offset = 0;
+		pS->hist_top = 0;
+		pS->hist_depth = 0;
+	}
+	s.p = pS;
+	return s;
+}
+
+/****************************************************************
+ s_read_all: read the rest of a file into a dynamically allocated
+ buffer, for use with s_memory().  We add a terminal nul for the
+ convenience of the client code, but don't count it in the length.
+ Return NULL if unable to allocate enough memory or if a read error
+ occurs.  It is the client code's responsibility to free the buffer
+ by calling freeMemory().
+ ***************************************************************/
+char * s_read_all( FILE * pF, size_t * pLen )
+{
+	char * buf;
+	size_t len = 0;
+	size_t cap = READ_BLOCK;
+	size_t n;
+
+	ASSERT( pF != NULL );
+	ASSERT( pLen != NULL );
+	if( NULL == pF || NULL == pLen )
+		return NULL;
+
+	buf = allocMemory( cap + 1 );
+	if( NULL == buf )
+		return NULL;
+
+	for( ;; )
+	{
+		n = fread( buf + len, 1, cap - len, pF );
+		len += n;
+		if( len < cap )
+			break;
+
+		/* buffer is full; double it and keep reading */
+
+		{
+			char * pNew;
+
+			pNew = resizeMemory( buf, cap * 2 + 1 );
+			if( NULL == pNew )
+			{
+				freeMemory( buf );
+				return NULL;
+			}
+			buf = pNew;
+			cap *= 2;
+		}
+	}
+
+	if( ferror( pF ) )
+	{
+		freeMemory( buf );
+		return NULL;
+	}
+
+	buf[ len ] = '\0';
+	*pLen = len;
+	return buf;
+}
+
+/****************************************************************
+ s_char_columns: count columns in UTF-8 characters (if on is TRUE)
+ or in bytes (if FALSE).  Byte offsets are unaffected.  Return the
+ prior setting.
+ ***************************************************************/
+int s_char_columns( Sfile s, int on )
+{
+	SF * pS;
+	int prior_value;
+
+	pS = s.p;
+	ASSERT( pS != NULL );
+	if( NULL == pS )
+		return FALSE;
+
+	prior_value  = pS->char_cols;
+	pS->char_cols = on ? TRUE : FALSE;
+	return prior_value;
+}
+
+/****************************************************************
+ s_set_client: attach a pointer to arbitrary data belonging to the
+ client code.  If the destructor is not NULL, s_close() will call
+ it, passing the pointer, so that the data lives exactly as long as
+ the Sfile.  Replacing the data does not destroy the old data.
+ ***************************************************************/
+void s_set_client( Sfile s, void * p, SF_destructor destructor )
+{
+	SF * pS;
+
+	pS = s.p;
+	ASSERT( pS != NULL );
+	if( NULL == pS )
+		return;
+
+	pS->client = p;
+	pS->client_free = destructor;
+}
+
+/****************************************************************
+ s_client: return the pointer attached by s_set_client(), or NULL
+ if there isn't one.
+ ***************************************************************/
+void * s_client( Sfile s )
+{
+	SF * pS;
+
+	pS = s.p;
+	ASSERT( pS != NULL );
+	if( NULL == pS )
+		return NULL;
+
+	return pS->client;
+}
+
 /****************************************************************
  s_close: if we've been reading a file which we opened ourselves,
  close it.  Then release all other associated resources.
@@ -163,6 +359,9 @@ void s_close( Sfile * pS )
 		if( pSF->pF != NULL && TRUE == pSF->closable )
 			fclose( pSF->pF );
 
+		if( pSF->client != NULL && pSF->client_free != NULL )
+			pSF->client_free( pSF->client );
+
 		freeMemory( pSF );
 	}
 }
@@ -184,33 +383,53 @@ int s_getc( Sfile s )
 	pS->prev_line = pS->line;
 	pS->prev_col  = pS->col;
 
+	/* Remember where we are, in case the character is ungotten */
+
+	pS->hist[ pS->hist_top ].line = pS->line;
+	pS->hist[ pS->hist_top ].col  = pS->col;
+	pS->hist_top = ( pS->hist_top + 1 ) % STACK_SIZE;
+	if( pS->hist_depth < STACK_SIZE )
+		++pS->hist_depth;
+
 	if( pS->ungotten )
 	{
-		/* return a previously ungotten character */
+		/* return a previously ungotten character, and */
+		/* go back to where we were after fetching it  */
 
 		--pS->ungotten;
 		c = pS->stack[ pS->ungotten ];
+		pS->line = pS->stack_pos[ pS->ungotten ].line;
+		pS->col  = pS->stack_pos[ pS->ungotten ].col;
 	}
 	else
 	{
-		if( pS->func != NULL )
+		if( pS->mem != NULL )
+		{
+			if( pS->mem_pos < pS->mem_len )
+				c = (unsigned char) pS->mem[ pS->mem_pos++ ];
+			else
+				c = EOF;
+		}
+		else if( pS->func != NULL )
 			c = pS->func( pS->generic_ptr );
 		else
 			c = fgetc( pS->pF );
 
-		/* We don't increment the line number if we're re-fetching */
-		/* something previously ungotten.  That's because we don't */
-		/* decrement the line number when we unget something.      */
-
 		if( '\n' == c )
 		{
 			++pS->line;
 			pS->col = 0;
 		}
+
+		/* The continuation bytes of a UTF-8 character don't */
+		/* advance the column if we are counting characters  */
+
+		if( EOF != c && ! ( pS->char_cols && 0x80 == ( c & 0xc0 ) ) )
+			++pS->col;
 	}
 
 	if( EOF != c )
-		++pS->col;
+		++pS->offset;
 
 	return c;
 }
@@ -221,10 +440,11 @@ int s_getc( Sfile s )
  ungetc() except that it lets you unget EOF (or any arbitrary
  int value, if you insist on abusing it).
 
- Note: if you unget past the beginning of the current line, the
- column number becomes negative.  There's no very good way to keep
- track of the line and column in this case, so things may get a
- little weird.  We try at least to be plausible and consistent.
+ We remember the line and column from before each recent fetch,
+ so that when a character is ungotten -- even a newline -- we can
+ go back to where we were before fetching it.  A value that can't
+ have been fetched (neither a character nor EOF) leaves the
+ position alone.
  ***************************************************************/
 int s_ungetc( Sfile s, int c )
 {
@@ -239,8 +459,26 @@ int s_ungetc( Sfile s, int c )
 		return ERROR_FOUND;
 
 	pS->stack[ pS->ungotten ] = c;
+	pS->stack_pos[ pS->ungotten ].line = pS->line;
+	pS->stack_pos[ pS->ungotten ].col  = pS->col;
 	++pS->ungotten;
-	--pS->col;
+
+	if( c != EOF && pS->offset > 0 )
+		--pS->offset;
+
+	if( EOF == c || ( c >= 0 && c <= UCHAR_MAX ) )
+	{
+		if( pS->hist_depth > 0 )
+		{
+			pS->hist_top = ( pS->hist_top + STACK_SIZE - 1 ) % STACK_SIZE;
+			--pS->hist_depth;
+			pS->line = pS->hist[ pS->hist_top ].line;
+			pS->col  = pS->hist[ pS->hist_top ].col;
+		}
+		else
+			--pS->col;		/* shouldn't happen; be plausible */
+	}
+
 	pS->prev_line = pS->line;
 	pS->prev_col  = pS->col - 1;
 	return OKAY;
@@ -266,4 +504,20 @@ Sposition s_position( Sfile s )
 		pos.col  = pS->prev_col;
 	}
 	return pos;
-}
\ No newline at end of file
+}
+
+/********************************************************************
+ s_offset -- return the number of characters fetched so far, not
+ counting any that have been ungotten.  This is the byte offset of
+ the next character to be fetched.
+ *******************************************************************/
+size_t s_offset( Sfile s )
+{
+	SF * pS;
+
+	pS = s.p;
+	if( NULL == pS )
+		return 0;
+	else
+		return pS->offset;
+}
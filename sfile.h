@@ -30,6 +30,14 @@
 	typedef int (* SF_func)( void * p );
 #endif
 
+/* typedef for a function ptr to destroy data attached to an Sfile */
+
+#ifdef __cplusplus
+	typedef void (* "C" SF_destructor)( void * p );
+#else
+	typedef void (* SF_destructor)( void * p );
+#endif
+
 typedef struct
 {
 	void * p;	/* opaque pointer to internal structure */
@@ -50,9 +58,15 @@ typedef struct
 Sfile s_open( const char * filename );
 Sfile s_assign( FILE * pF );
 Sfile s_callback( SF_func func, void * p );
+Sfile s_memory( const char * buf, size_t len );
+char * s_read_all( FILE * pF, size_t * pLen );
 int s_getc( Sfile S );
 int s_ungetc( Sfile s, int c );
 Sposition s_position( Sfile s );
+size_t s_offset( Sfile s );
+int s_char_columns( Sfile s, int on );
+void s_set_client( Sfile s, void * p, SF_destructor destructor );
+void * s_client( Sfile s );
 void s_close( Sfile * pS );
 
 #ifdef __cplusplus
@@ -0,0 +1,23 @@
+declare
+  cursor c_emp( p_dept number ) is
+    select e.empno, e.ename, d.dname
+      from emp e, dept d
+     where e.deptno = d.deptno
+       and d.deptno = p_dept
+     order by e.ename;
+  v_total number := 0;
+begin
+  for r in c_emp( 10 ) loop
+    update emp set sal = sal * 1.1 where empno = r.empno;
+    v_total := v_total + sql%rowcount;
+  end loop;
+  delete from emp_audit where changed < sysdate - 30;
+  insert into emp_audit ( empno, changed, note )
+  select empno, sysdate, 'raise' from emp where deptno = 10;
+  select count(*) into v_total from emp_audit where note <> 'raise';
+  commit;
+exception
+  when no_data_found then
+    rollback;
+end;
+/
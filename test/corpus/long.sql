@@ -0,0 +1,9 @@
+create or replace procedure log_message( p_text in varchar2 ) is
+  -- this comment runs on well past the length of any chunk this comment runs on well past the length of any chunk this comment runs on well past the length of any chunk this comment runs on well past the length of any chunk this comment runs on well past the length of any chunk this comment runs on well past the length of any chunk
+  /* a block comment, also longer than a chunk or two a block comment, also longer than a chunk or two a block comment, also longer than a chunk or two a block comment, also longer than a chunk or two a block comment, also longer than a chunk or two */
+  c_banner constant varchar2(400) := 'a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer';
+begin
+  dbms_output.put_line( c_banner );
+  dbms_output.put_line( p_text || 'a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer a string literal too long for the token buffer' );
+end log_message;
+/
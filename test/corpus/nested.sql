@@ -0,0 +1,41 @@
+create or replace function classify( p_a in number, p_b in number )
+return varchar2 is
+  v_result varchar2(30);
+begin
+  if p_a > 0 then
+    if p_b > 0 then
+      for i in 1 .. p_a loop
+        while p_b > i loop
+          begin
+            if mod( i, 2 ) = 0 then
+              case p_b
+                when 1 then
+                  v_result := 'one';
+                when 2 then
+                  if i > 10 then
+                    loop
+                      exit when i > 20;
+                      v_result := 'big';
+                    end loop;
+                  end if;
+                else
+                  v_result := 'other';
+              end case;
+            end if;
+          exception
+            when zero_divide then
+              v_result := 'zero';
+            when others then
+              raise;
+          end;
+        end loop;
+      end loop;
+    elsif p_b < 0 then
+      v_result := 'negative';
+    end if;
+  else
+    v_result := null;
+  end if;
+  return v_result;
+end classify;
+/
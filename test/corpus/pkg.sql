@@ -0,0 +1,34 @@
+create or replace package body foo_pkg is
+  -- a comment
+  /* block
+     comment */
+  procedure bar( p_id in number, p_name varchar2 ) is
+    v_count number := 0;
+    v_txt varchar2(100) := 'it''s
+multi';
+    x number := 1.5e-3 + .25 + 42;
+  begin
+    select a, b, count(*) into v_a, v_b, v_count from tab1 t, tab2 u where t.id = u.id and t.x = (select max(y) from tab3) group by a, b order by a;
+    if v_count = null then
+      insert into tab1 (a, b, c) values (1, 'x', sysdate);
+    elsif v_count > 1 then
+      update tab1 set a = 1, b = 2 where c = 3;
+    else
+      null;
+    end if;
+    for r in (select * from tab1) loop
+      fetch c1 into v_a, v_b;
+      exit when c1%notfound;
+    end loop;
+  exception
+    when others then
+      raise;
+  end bar;
+end foo_pkg;
+/
+create or replace procedure Baz is
+begin
+  DBMS_OUTPUT.put_line('hello' || "Quoted Id");
+  while 1 != 2 loop null; end loop;
+end;
+/
@@ -0,0 +1,58 @@
+#!/bin/sh
+# lines.sh -- regression tests for plsb --lines.
+#
+# usage: sh test/lines.sh [plsb]
+#
+# Each case beautifies some lines of a small input and compares the
+# result with the expected output.  Exit status is the number of cases
+# that failed.
+
+PLSB=${1:-./plsb}
+TMP=${TMPDIR:-/tmp}/plsb-lines.$$
+failed=0
+
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' 0
+
+# check name spec -- run plsb --lines spec on $TMP/in.sql, and compare
+# the output with $TMP/expect
+
+check()
+{
+	if "$PLSB" --lines "$2" "$TMP/in.sql" >"$TMP/out" 2>/dev/null &&
+		cmp -s "$TMP/out" "$TMP/expect"
+	then
+		echo "ok      $1"
+	else
+		echo "FAILED  $1"
+		diff "$TMP/expect" "$TMP/out"
+		failed=`expr $failed + 1`
+	fi
+}
+
+# A selected line whose statement runs on past the last range: the
+# whole statement is beautified, and nothing after it is lost.
+
+printf 'begin\nx :=   1 +\n2; y := 3;\nz := 4;\nend;\n' >"$TMP/in.sql"
+printf 'begin\n    x := 1 + 2;\n    y := 3;\nz := 4;\nend;\n' >"$TMP/expect"
+check "statement past the last range" 2
+
+# Lines outside the ranges go through byte for byte
+
+printf 'begin\n  x:=1;\n\n\n  y:=2;\nend;\n' >"$TMP/in.sql"
+printf 'begin\n  x:=1;\n\n\n    y := 2;\nend;\n' >"$TMP/expect"
+check "unselected lines unchanged" 5
+
+# Selecting every line is the same as beautifying the whole input
+
+printf 'begin\nif a then\nb;\nend if;\n\nend;\n' >"$TMP/in.sql"
+"$PLSB" "$TMP/in.sql" >"$TMP/expect" 2>/dev/null
+check "all lines selected" 1-6
+
+# The end of a wrapped unit is copied along with it
+
+printf 'x wrapped\na0\nzz\n/\nbegin null; end;\n/\n' >"$TMP/in.sql"
+cp "$TMP/in.sql" "$TMP/expect"
+check "wrapped unit" 7
+
+exit $failed
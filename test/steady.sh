@@ -0,0 +1,40 @@
+#!/bin/sh
+# steady.sh -- check that each tool, once warmed up, runs without going
+# back to the heap.
+#
+# usage: sh test/steady.sh [dir]
+#
+# Runs plsb, plscap, plscount, plsenull, and plsqlf, found in dir (by
+# default the current directory), over each file in test/corpus, with
+# PLS_STEADY_STATE set so that each reports its heap allocations after
+# the warm-up point.  Any count but zero is a failure.  Exit status is
+# the number of failures.
+
+DIR=${1:-.}
+CORPUS=`dirname "$0"`/corpus
+TMP=${TMPDIR:-/tmp}/plsb-steady.$$
+failed=0
+
+trap 'rm -f "$TMP"' 0
+
+for tool in plsb plscap plscount plsenull plsqlf
+do
+	for f in "$CORPUS"/*.sql
+	do
+		# plsenull and plsqlf exit with 1 when they find something,
+		# so we go by the report rather than the exit status
+
+		PLS_STEADY_STATE=1 "$DIR/$tool" "$f" >/dev/null 2>"$TMP"
+		count=`sed -n 's/^Heap allocations after warm-up: //p' "$TMP"`
+
+		if [ "$count" = 0 ]
+		then
+			echo "ok      $tool $f"
+		else
+			echo "FAILED  $tool $f: ${count:-no report}"
+			failed=`expr $failed + 1`
+		fi
+	done
+done
+
+exit $failed
@@ -0,0 +1,77 @@
+/* watermark.c -- check that the watermark in memmgmt.c calls the
+   scavengers, and that freeing memory past the watermark doesn't hang.
+
+   usage: PLS_WATERMARK=bytes test/watermark
+
+   Build it with memmgmt.c and myassert.c, with or without PLS_THREADS
+   (make check-watermark builds it with).  Exit status is the number
+   of checks that failed.  If the program hangs, an alarm kills it.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "util.h"
+
+#define OBJECTS 3000
+
+static int scavenged = 0;
+
+static void scavenge( void * p );
+static int check( const char * name, int ok );
+
+int main( void )
+{
+	static void * objects[ OBJECTS ];
+	const char * env;
+	size_t prior;
+	int failed = 0;
+	int i;
+
+	alarm( 30 );
+	fastExit( TRUE );
+	registerMemoryPool( scavenge, NULL );
+
+	/* Allocate past the watermark from PLS_WATERMARK */
+
+	for( i = 0; i < OBJECTS; ++i )
+		objects[ i ] = allocSlab( 16 );
+
+	env = getenv( "PLS_WATERMARK" );
+	failed += check( "PLS_WATERMARK read", env != NULL
+		&& setMemoryWatermark( 1 ) == (size_t) strtoul( env, NULL, 10 ) );
+	failed += check( "scavengers called", scavenged > 0 );
+
+	/* Now every free leaves us above a watermark of one byte.  The */
+	/* empty slabs go back to the free store from inside the slab   */
+	/* allocator, which mustn't call the scavengers.                */
+
+	for( i = 0; i < OBJECTS; ++i )
+		freeSlab( objects[ i ] );
+	failed += check( "freed past the watermark", TRUE );
+
+	prior = setMemoryWatermark( 0 );
+	failed += check( "watermark set", 1 == prior );
+
+	unRegisterMemoryPool( scavenge, NULL );
+	return failed;
+}
+
+/**************************************************************
+ scavenge -- a scavenger with nothing to free; it just counts
+ the calls.
+**************************************************************/
+static void scavenge( void * p )
+{
+	(void) p;
+	++scavenged;
+}
+
+/**************************************************************
+ check -- report a check; return 1 if it failed, else 0.
+**************************************************************/
+static int check( const char * name, int ok )
+{
+	printf( "%s%s\n", ok ? "ok      " : "FAILED  ", name );
+	return ok ? 0 : 1;
+}
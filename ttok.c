@@ -28,6 +28,10 @@
 
 static void show_token( const Pls_tok * pT );
 static int parse( Sfile s, FILE * pOut );
+static int dump_binary( const char * outname, FILE * pIn );
+static int diagnose( FILE * pIn );
+
+#define MAX_DIAGS 1000
 
 int main( int argc, char * argv[] )
 {
@@ -35,6 +39,41 @@ int main( int argc, char * argv[] )
 	FILE * pIn;
 	FILE * pOut = NULL;
 	Sfile s;
+	const char * dump_name = NULL;
+	int diagnosing = FALSE;
+
+	/* --chars reports columns in UTF-8 characters, not bytes; */
+	/* it may precede any of the other options                  */
+
+	if( argc > 1 && 0 == strcmp( argv[ 1 ], "--chars" ) )
+	{
+		(void) pls_char_columns( TRUE );
+		--argc;
+		++argv;
+	}
+
+	/* --dump-binary writes a token file instead of displaying tokens */
+
+	if( argc > 1 && 0 == strcmp( argv[ 1 ], "--dump-binary" ) )
+	{
+		if( argc < 3 )
+		{
+			fprintf( stderr, "Usage: ttok --dump-binary outfile [infile]\n" );
+			return EXIT_FAILURE;
+		}
+		dump_name = argv[ 2 ];
+		argc -= 2;
+		argv += 2;
+	}
+
+	/* --diagnose lists every lexical error instead of displaying tokens */
+
+	else if( argc > 1 && 0 == strcmp( argv[ 1 ], "--diagnose" ) )
+	{
+		diagnosing = TRUE;
+		--argc;
+		++argv;
+	}
 
 	if( argc < 2 )
 		pIn = stdin;
@@ -49,6 +88,21 @@ int main( int argc, char * argv[] )
 		}
 	}
 
+	if( dump_name != NULL )
+	{
+		rc = dump_binary( dump_name, pIn );
+		if( pIn != stdin )
+			fclose( pIn );
+		return OKAY == rc ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	else if( diagnosing )
+	{
+		rc = diagnose( pIn );
+		if( pIn != stdin )
+			fclose( pIn );
+		return OKAY == rc ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	s = s_assign( pIn );
 	if( NULL == s.p )
 	{
@@ -117,6 +171,76 @@ static int parse( Sfile s, FILE * pOut )
 	return rc;
 }
 
+/********************************************************************
+ dump_binary -- tokenize the entire input and save the tokens in a
+ binary token file.  Then read the file back, to make sure that it
+ can be read.
+ *******************************************************************/
+static int dump_binary( const char * outname, FILE * pIn )
+{
+	int rc = OKAY;
+	char * pBuf;
+	size_t len;
+	uint64_t hash;
+	uint64_t check_hash;
+	uint64_t check_len;
+	Sfile s;
+	Pls_tokvec vec;
+	Pls_tokvec check;
+
+	pBuf = s_read_all( pIn, &len );
+	if( NULL == pBuf )
+	{
+		fprintf( stderr, "Unable to read input\n" );
+		return ERROR_FOUND;
+	}
+
+	hash = pls_hash( pBuf, len, PLS_HASH_INIT );
+
+	s = s_memory( pBuf, len );
+	if( NULL == s.p )
+	{
+		fprintf( stderr, "Unable to assign an Sfile\n" );
+		freeMemory( pBuf );
+		return ERROR_FOUND;
+	}
+
+	pls_tokvec_init( &vec );
+	pls_tokvec_init( &check );
+	if( pls_tokvec_load( &vec, s ) != OKAY )
+	{
+		fprintf( stderr, "Memory exhausted!\n" );
+		rc = ERROR_FOUND;
+	}
+	else if( pls_write_plt( &vec, hash, len, outname ) != OKAY )
+	{
+		fprintf( stderr, "Unable to write %s\n", outname );
+		rc = ERROR_FOUND;
+	}
+	else if( pls_read_plt( &check, &check_hash, &check_len,
+				outname ) != OKAY ||
+			 check.count != vec.count || check_hash != hash ||
+			 check_len != len )
+	{
+		fprintf( stderr, "Unable to read back %s\n", outname );
+		rc = ERROR_FOUND;
+	}
+	else
+	{
+		printf( "%s: %lu tokens, %lu bytes of text, source hash %08lx%08lx\n",
+			outname, (unsigned long) vec.count,
+			(unsigned long) vec.text_len,
+			(unsigned long) ( hash >> 32 ),
+			(unsigned long) ( hash & 0xffffffffUL ) );
+	}
+
+	pls_tokvec_free( &check );
+	pls_tokvec_free( &vec );
+	s_close( &s );
+	freeMemory( pBuf );
+	return rc;
+}
+
 /********************************************************************
  show_token -- display the type and, if appropriate, the textual
  contents of a token.
@@ -160,6 +284,10 @@ static void show_token( const Pls_tok * pT )
 			printf( "(Length = %lu)\n",
 				(unsigned long) pls_tok_size( pT ) );
 			break;
+		case T_wrapped :
+			printf( "wrapped body (Length = %lu)\n",
+				(unsigned long) pls_tok_size( pT ) );
+			break;
 		case T_whitespace :
 			printf( "whitespace: '" );
 			pls_write_text( pT, stdout );
@@ -261,4 +389,65 @@ static void show_token( const Pls_tok * pT )
 				printf( "invalid token\n" );
 			break;
 	}
-}
\ No newline at end of file
+}
+
+/********************************************************************
+ diagnose -- tokenize the entire input in recovery mode, and then
+ list the lexical errors found, if any.
+ *******************************************************************/
+static int diagnose( FILE * pIn )
+{
+	int rc = OKAY;
+	int finished = FALSE;
+	size_t i;
+	Sfile s;
+	Pls_tok * pT;
+	Pls_diaglist list;
+	static Pls_diag diags[ MAX_DIAGS ];
+
+	list.diags    = diags;
+	list.capacity = MAX_DIAGS;
+	list.count    = 0;
+	list.lost     = 0;
+	(void) pls_recover( &list );
+
+	s = s_assign( pIn );
+	if( NULL == s.p )
+	{
+		fprintf( stderr, "Unable to assign an Sfile\n" );
+		return ERROR_FOUND;
+	}
+
+	while( FALSE == finished )
+	{
+		pT = pls_next_tok( s );
+		if( NULL == pT )
+		{
+			fprintf( stderr, "Memory exhausted!\n" );
+			rc = ERROR_FOUND;
+			finished = TRUE;
+		}
+		else
+		{
+			if( T_eof == pT->type )
+				finished = TRUE;
+			pls_free_tok( &pT );
+		}
+	}
+
+	s_close( &s );
+	(void) pls_recover( NULL );
+
+	for( i = 0; i < list.count; ++i )
+		printf( "offset %lu, length %lu: %s\n",
+			(unsigned long) diags[ i ].offset,
+			(unsigned long) diags[ i ].length,
+			pls_diag_text( (Pls_diag_code) diags[ i ].code ) );
+
+	printf( "%lu errors", (unsigned long) list.count + list.lost );
+	if( list.lost > 0 )
+		printf( " (%lu not listed)", list.lost );
+	printf( "\n" );
+
+	return rc;
+}
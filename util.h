@@ -25,6 +25,54 @@
 #define OKAY        (0)
 #define ERROR_FOUND (1)
 
+/* Support for multithreading is optional.  Compile with PLS_THREADS
+   #defined (and link with the POSIX threads library) to make the memory
+   management, including the slab allocator, safe for use by multiple
+   threads.  Otherwise the following macros compile to nothing.
+*/
+
+#ifdef PLS_THREADS
+
+#include <pthread.h>
+
+#if defined( __STDC_VERSION__ ) && __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef pthread_mutex_t Mutex;
+#define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define lockMutex(m)      pthread_mutex_lock( m )
+#define unlockMutex(m)    pthread_mutex_unlock( m )
+
+#else
+
+#define THREAD_LOCAL
+typedef int Mutex;
+#define MUTEX_INITIALIZER 0
+#define lockMutex(m)      ((void) (m))
+#define unlockMutex(m)    ((void) (m))
+
+#endif
+
+/* Priority of a memory pool registered by registerMemoryPool() */
+
+#define POOL_PRIORITY_DEFAULT (0)
+
+/* Statistics for one size class of the slab allocator */
+
+typedef struct
+{
+	size_t size;				/* largest object in the class */
+	unsigned long allocs;		/* objects taken from slabs, ever */
+	unsigned long inUse;		/* objects currently taken */
+	unsigned long peakInUse;	/* most objects taken at once */
+	unsigned long slabs;		/* slabs currently held */
+	unsigned long peakSlabs;	/* most slabs held at once */
+	unsigned long released;		/* slabs given back to the free store */
+} SlabStats;
+
 #ifdef __cplusplus
 	extern "C" {
 #endif
@@ -36,12 +84,55 @@ void freeMemory( void * pMem );
 void * resizeMemory( void * pOld, size_t size );
 void registerMemoryPool( void (* pFunction) (void *), void * p );
 void unRegisterMemoryPool( void (* pFunction) (void *), const void * p );
+void registerMemoryPoolPriority( void (* pFunction) (void *), void * p,
+	int priority );
 void purgeMemoryPools( void );
+size_t setMemoryWatermark( size_t bytes );
+size_t outstandingMemory( void );
+void * allocSlab( size_t size );
+void freeSlab( void * p );
+void releaseSlabs( void );
+int reserveSlab( size_t size );
+int getSlabStats( unsigned i, SlabStats * pStats );
+
+void * allocMemoryAt( size_t size, const char * file, int line );
+void * allocNulMemoryAt( size_t nitems, size_t size, const char * file,
+	int line );
+void * resizeMemoryAt( void * pOld, size_t size, const char * file,
+	int line );
+char * strDupAt( const char * s, const char * file, int line );
+void * allocSlabAt( size_t size, const char * file, int line );
+void profileMemory( const char * filename );
+void dumpMemoryProfile( FILE * pF );
+void markSteadyState( void );
+unsigned long steadyAllocations( void );
+int strictSteadyState( int on );
+int fastExit( int on );
 
 #ifdef __cplusplus
 	};
 #endif
 
+/* Record the call site of each allocation request, for the profile
+   (see profileMemory() in memmgmt.c).  Compile with PLS_NO_CALLSITES
+   #defined to call the plain functions instead.
+*/
+
+#ifndef PLS_NO_CALLSITES
+
+#define allocMemory( size ) \
+	allocMemoryAt( size, __FILE__, __LINE__ )
+#define allocNulMemory( nitems, size ) \
+	allocNulMemoryAt( nitems, size, __FILE__, __LINE__ )
+#define resizeMemory( pOld, size ) \
+	resizeMemoryAt( pOld, size, __FILE__, __LINE__ )
+#define strDup( s ) \
+	strDupAt( s, __FILE__, __LINE__ )
+#define allocSlab( size ) \
+	allocSlabAt( size, __FILE__, __LINE__ )
+
+#endif
+
 /* The following variant of assert() is mostly cribbed from: Writing Solid
    Code, by Steve Maguire, p. 17; Microsoft Press, 1993, Redmond, WA.
 */